@@ -0,0 +1,50 @@
+#include "benchmark_utils.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/grid.hpp"
+#include "scene_objects/kd_tree.hpp"
+#include <cstdio>
+#include <optional>
+#include <vector>
+
+// Compares bvh_t, grid_t and kd_tree_t on a scene with evenly distributed
+// objects and on a scene with objects of very different sizes.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+template <typename Accelerator, typename Build>
+void run(char const *name, Build &&build, std::vector<ray_t> const &primary,
+         std::vector<ray_t> const &bounce) {
+  std::optional<Accelerator> accelerator;
+  auto const build_secs = seconds_for([&] { accelerator.emplace(build()); });
+  std::printf("%-8s build: %8.3f ms  primary: %12.0f rays/s  bounce: %12.0f "
+              "rays/s\n",
+              name, build_secs * 1000, rays_per_second(*accelerator, primary),
+              rays_per_second(*accelerator, bounce));
+}
+
+void compare(char const *scene, std::vector<any_object> const &world,
+             std::vector<ray_t> const &primary, random_t &rand) {
+  auto bounce = bounce_rays(bvh_t<any_object>{world}, primary, rand);
+  std::printf("%s: %zu objects\n", scene, world.size());
+  run<bvh_t<any_object>>(
+      "bvh", [&] { return bvh_t<any_object>{world, sah_split{}}; }, primary,
+      bounce);
+  run<grid_t<any_object>>(
+      "grid", [&] { return grid_t<any_object>{world}; }, primary, bounce);
+  run<kd_tree_t<any_object>>(
+      "kd-tree", [&] { return kd_tree_t<any_object>{world}; }, primary,
+      bounce);
+}
+
+int main() {
+  random_t rand{42};
+  auto primary_rays = [](point3 look_from) {
+    return camera_rays(look_from, {0, 0, 0}, degrees(40), 400, 225);
+  };
+  compare("particle field", particle_field_scene(rand, 100000, 10, 0.1),
+          primary_rays({0, 0, 30}), rand);
+  compare("random spheres", random_spheres_scene(rand, 50),
+          primary_rays({13, 2, 3}), rand);
+}
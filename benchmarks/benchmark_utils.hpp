@@ -0,0 +1,134 @@
+#pragma once
+
+#include "angle.hpp"
+#include "color.hpp"
+#include "direction.hpp"
+#include "generator/random_double_generator.hpp"
+#include "interval.hpp"
+#include "materials/lambertian.hpp"
+#include "point.hpp"
+#include "ray.hpp"
+#include "scene_objects/any_scene_object.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/shapes/shape_object.hpp"
+#include "scene_objects/shapes/sphere.hpp"
+#include "vector.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+namespace mrl::bench {
+using random_t = random_double_generator;
+using any_object = any_scene_object<random_t>;
+
+constexpr static interval_t hit_interval{
+    0.001, std::numeric_limits<double>::infinity()};
+
+// Scene of random_spheres example with small spheres spread over
+// [-grid_size, grid_size) x [-grid_size, grid_size) on the ground.
+inline std::vector<any_object> random_spheres_scene(random_t &rand,
+                                                    int grid_size) {
+  std::vector<any_object> world;
+  lambertian_t ground{color_t{0.5, 0.5, 0.5}};
+  world.push_back(shape_object{sphere{1000.0, point3{0, -1000, 0}}, ground});
+  world.push_back(shape_object{sphere{1.0, point3{0, 1, 0}}, ground});
+  world.push_back(shape_object{sphere{1.0, point3{-4, 1, 0}}, ground});
+  world.push_back(shape_object{sphere{1.0, point3{4, 1, 0}}, ground});
+  for (int a = -grid_size; a < grid_size; ++a) {
+    for (int b = -grid_size; b < grid_size; ++b) {
+      auto center =
+          point3{a + 0.9 * rand(0.0, 1.0), 0.2, b + 0.9 * rand(0.0, 1.0)};
+      auto color = color_t{rand(0.0, 1.0), rand(0.0, 1.0), rand(0.0, 1.0)};
+      world.push_back(shape_object{sphere{0.2, center}, lambertian_t{color}});
+    }
+  }
+  return world;
+}
+
+// Dense field of num_spheres equal spheres uniformly distributed in
+// [-extent, extent]^3.
+inline std::vector<any_object> particle_field_scene(random_t &rand,
+                                                    int num_spheres,
+                                                    double extent,
+                                                    double radius) {
+  std::vector<any_object> world;
+  for (int i = 0; i < num_spheres; ++i) {
+    auto center = point3{rand(-extent, extent), rand(-extent, extent),
+                         rand(-extent, extent)};
+    auto color = color_t{rand(0.0, 1.0), rand(0.0, 1.0), rand(0.0, 1.0)};
+    world.push_back(shape_object{sphere{radius, center}, lambertian_t{color}});
+  }
+  return world;
+}
+
+// Postcondition:
+//   - returns width * height pinhole camera rays in row major order
+inline std::vector<ray_t> camera_rays(point3 look_from, point3 look_at,
+                                      angle_t vertical_fov, int width,
+                                      int height) {
+  auto const forward = normalize(look_at - look_from);
+  auto const right = normalize(cross(forward, vec3{0, 1, 0}));
+  auto const up = cross(right, forward);
+  auto const viewport_height = 2 * std::tan(radians(vertical_fov) / 2);
+  auto const viewport_width =
+      viewport_height * (static_cast<double>(width) / height);
+  std::vector<ray_t> rays;
+  rays.reserve(static_cast<std::size_t>(width * height));
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      auto const u = ((x + 0.5) / width - 0.5) * viewport_width;
+      auto const v = (0.5 - (y + 0.5) / height) * viewport_height;
+      rays.push_back(ray_t{look_from, forward + right * u + up * v});
+    }
+  }
+  return rays;
+}
+
+// Postcondition:
+//   - returns a randomly directed ray from hit point of every ray in rays
+//     that hits world
+template <SceneObject Object>
+std::vector<ray_t> bounce_rays(Object const &world,
+                               std::vector<ray_t> const &rays,
+                               random_t &rand) {
+  std::vector<ray_t> res;
+  for (auto const &r : rays) {
+    auto hit_rec = hit(world, r, hit_interval);
+    if (!hit_rec)
+      continue;
+    res.push_back(ray_t{
+        r.at(hit_rec->hit_distance),
+        vec3{rand(-1.0, 1.0), rand(-1.0, 1.0), rand(-1.0, 1.0)},
+    });
+  }
+  return res;
+}
+
+template <typename F> double seconds_for(F &&f) {
+  auto const start = std::chrono::steady_clock::now();
+  f();
+  auto const end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+// Postcondition:
+//   - returns number of closest hit queries per second over rays
+template <SceneObject Object>
+double rays_per_second(Object const &world, std::vector<ray_t> const &rays,
+                       int repeat = 3) {
+  std::size_t num_hits = 0;
+  auto const secs = seconds_for([&] {
+    for (int i = 0; i < repeat; ++i) {
+      for (auto const &r : rays) {
+        num_hits += hit(world, r, hit_interval).has_value();
+      }
+    }
+  });
+  // Keeps the traversal from being optimized away.
+  if (num_hits == std::numeric_limits<std::size_t>::max())
+    std::puts("");
+  return static_cast<double>(rays.size()) * repeat / secs;
+}
+} // namespace mrl::bench
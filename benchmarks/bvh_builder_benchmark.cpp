@@ -0,0 +1,87 @@
+#include "benchmark_utils.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/lbvh.hpp"
+#include "scene_objects/bvh/parallel_build.hpp"
+#include "scene_objects/bvh/sbvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "schedulers/thread_pool.hpp"
+#include <cstdio>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Compares build time against tree quality (rays per second) of top down
+// bvh builders, spatial split bvh builder and linear (Morton code) bvh
+// builders on the same scene, and how much treelet restructuring improves
+// trees of each of them.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+template <typename Build>
+void run(char const *name, Build &&build, std::vector<ray_t> const &primary,
+         std::vector<ray_t> const &bounce) {
+  std::optional<bvh_t<any_object>> bvh;
+  auto const build_secs = seconds_for([&] { bvh.emplace(build()); });
+  std::printf("%-14s build: %8.3f ms  primary: %12.0f rays/s  bounce: %12.0f "
+              "rays/s\n",
+              name, build_secs * 1000, rays_per_second(*bvh, primary),
+              rays_per_second(*bvh, bounce));
+}
+
+int main() {
+  thread_pool pool{std::thread::hardware_concurrency()};
+  auto sch = pool.get_scheduler();
+  random_t rand{42};
+  auto world = random_spheres_scene(rand, 200);
+  auto primary = camera_rays({13, 2, 3}, {0, 0, 0}, degrees(20), 400, 225);
+  auto bounce = bounce_rays(bvh_t<any_object>{world}, primary, rand);
+  std::printf("objects: %zu\n", world.size());
+
+  auto wait = [](auto &&sender) {
+    return std::get<0>(*stdexec::sync_wait(std::move(sender)));
+  };
+  auto median = [&] { return bvh_t<any_object>{world}; };
+  auto sah = [&] { return bvh_t<any_object>{world, sah_split{}}; };
+  auto parallel_sah = [&] { return wait(build_bvh(sch, world, sah_split{})); };
+  auto sbvh = [&] { return build_sbvh(world); };
+  auto lbvh = [&] { return build_lbvh(world); };
+  auto parallel_lbvh = [&] { return wait(build_lbvh(sch, world)); };
+  auto ploc = [&] { return build_lbvh(world, {.ploc = true}); };
+  auto parallel_ploc = [&] {
+    return wait(build_lbvh(sch, world, {.ploc = true}));
+  };
+
+  run("median", median, primary, bounce);
+  run("sah", sah, primary, bounce);
+  run("sah/parallel", parallel_sah, primary, bounce);
+  run("sbvh", sbvh, primary, bounce);
+  run("lbvh", lbvh, primary, bounce);
+  run("lbvh/parallel", parallel_lbvh, primary, bounce);
+  run("ploc", ploc, primary, bounce);
+  run("ploc/parallel", parallel_ploc, primary, bounce);
+
+  // Build time includes restructuring on pool.
+  auto with_treelets = [&](auto build) {
+    return [&, build] {
+      auto bvh = build();
+      wait(bvh.restructure_treelets(sch));
+      return bvh;
+    };
+  };
+  run("median+treelet", with_treelets(median), primary, bounce);
+  run("sah+treelet", with_treelets(sah), primary, bounce);
+  run("lbvh+treelet", with_treelets(lbvh), primary, bounce);
+  run("ploc+treelet", with_treelets(ploc), primary, bounce);
+
+  auto report_treelets = [&](char const *name, auto build) {
+    auto bvh = build();
+    auto const report = wait(bvh.restructure_treelets(sch));
+    std::printf("%-14s sah cost: %10.3f -> %10.3f\n", name,
+                report.sah_cost_before, report.sah_cost_after);
+  };
+  report_treelets("median", median);
+  report_treelets("sah", sah);
+  report_treelets("lbvh", lbvh);
+  report_treelets("ploc", ploc);
+}
@@ -0,0 +1,61 @@
+#include "benchmark_utils.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/layout.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/laid_out_bvh.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+// Compares rays per second of same bvh with its nodes in depth first, van
+// Emde Boas and profiled frequency order. Frequency order is profiled with
+// every 16th camera ray, like a low sample count render would.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+template <SceneObject Object>
+void run(char const *name, Object const &world,
+         std::vector<ray_t> const &primary, std::vector<ray_t> const &bounce) {
+  std::printf("%-14s primary: %12.0f rays/s  bounce: %12.0f rays/s\n", name,
+              rays_per_second(world, primary),
+              rays_per_second(world, bounce));
+}
+
+void compare(char const *scene, std::vector<any_object> const &world,
+             std::vector<ray_t> const &primary, random_t &rand) {
+  constexpr static std::size_t profile_stride = 16;
+  bvh_t<any_object> bvh{world, sah_split{}};
+  auto bounce = bounce_rays(bvh, primary, rand);
+  std::printf("%s: %zu objects, %zu nodes\n", scene, world.size(),
+              bvh.nodes().size());
+
+  bvh_profiler_t profiler{bvh};
+  for (std::size_t i = 0; i < primary.size(); i += profile_stride) {
+    auto hit_rec = hit(profiler, primary[i], hit_interval);
+    if (!hit_rec)
+      continue;
+    hit(profiler,
+        ray_t{primary[i].at(hit_rec->hit_distance),
+              vec3{rand(-1.0, 1.0), rand(-1.0, 1.0), rand(-1.0, 1.0)}},
+        hit_interval);
+  }
+
+  run("bvh", bvh, primary, bounce);
+  run("depth first", laid_out_bvh_t{bvh, depth_first_layout{}}, primary,
+      bounce);
+  run("van Emde Boas", laid_out_bvh_t{bvh, van_emde_boas_layout{}}, primary,
+      bounce);
+  run("frequency", laid_out_bvh_t{bvh, profiler.layout()}, primary, bounce);
+}
+
+int main() {
+  random_t rand{42};
+  auto primary_rays = [](point3 look_from) {
+    return camera_rays(look_from, {0, 0, 0}, degrees(40), 400, 225);
+  };
+  compare("particle field", particle_field_scene(rand, 1000000, 10, 0.02),
+          primary_rays({0, 0, 30}), rand);
+  compare("random spheres", random_spheres_scene(rand, 100),
+          primary_rays({13, 2, 3}), rand);
+}
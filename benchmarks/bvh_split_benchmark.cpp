@@ -0,0 +1,38 @@
+#include "benchmark_utils.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include <cstdio>
+#include <optional>
+#include <vector>
+
+// Compares median and SAH split strategies of bvh_t on the same scene.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+template <typename Split>
+void run(char const *name, std::vector<any_object> world, Split split,
+         std::vector<ray_t> const &primary, std::vector<ray_t> const &bounce) {
+  std::optional<bvh_t<any_object>> bvh;
+  auto const build_secs =
+      seconds_for([&] { bvh.emplace(std::move(world), split); });
+  std::printf("%-10s build: %8.3f ms  primary: %12.0f rays/s  bounce: %12.0f "
+              "rays/s\n",
+              name, build_secs * 1000, rays_per_second(*bvh, primary),
+              rays_per_second(*bvh, bounce));
+}
+
+int main() {
+  random_t rand{42};
+  auto world = random_spheres_scene(rand, 50);
+  auto primary = camera_rays({13, 2, 3}, {0, 0, 0}, degrees(20), 400, 225);
+  auto bounce = bounce_rays(bvh_t<any_object>{world}, primary, rand);
+  std::printf("objects: %zu\n", world.size());
+
+  run("median", world, median_split{}, primary, bounce);
+  for (int bins : {4, 8, 16, 32}) {
+    char name[16];
+    std::snprintf(name, sizeof(name), "sah/%d", bins);
+    run(name, world, sah_split{.bin_count = bins}, primary, bounce);
+  }
+}
@@ -0,0 +1,80 @@
+#include "angle.hpp"
+#include "benchmark_utils.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/rotate_object.hpp"
+#include "scene_objects/shapes/quad.hpp"
+#include "scene_objects/shapes/shape_object.hpp"
+#include "scene_objects/translate_object.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// Compares bvh building hit objects of every candidate hit against building
+// hit object of closest hit only, on a scene of rotated and translated quads
+// and spheres behind any_object.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+// Hides intersect and hit_object_at of Object, so bvh builds hit object of
+// every candidate hit as it did before hits were deferred.
+template <SceneObject Object> struct eager_object {
+  using hit_object_type = hit_object_t<Object>;
+  Object object;
+};
+
+template <SceneObject Object>
+auto hit(eager_object<Object> const &o, ray_t const &r, interval_t const &i) {
+  return hit(o.object, r, i);
+}
+
+template <SceneObject Object>
+bound_t get_bounds(eager_object<Object> const &o) {
+  return get_bounds(o.object);
+}
+
+int main() {
+  random_t rand{42};
+  std::vector<any_object> deferred;
+  std::vector<eager_object<any_object>> eager;
+  lambertian_t material{color_t{0.5, 0.5, 0.5}};
+  for (int i = 0; i < 200000; ++i) {
+    auto const center =
+        point3{rand(-10.0, 10.0), rand(-10.0, 10.0), rand(-10.0, 10.0)};
+    auto const axis = ray_t{center, direction_t{vec3{0, 1, 0}}};
+    any_object object =
+        i % 2 == 0
+            ? any_object{rotate_object{
+                  translate_object{
+                      shape_object{quad{point3{0, 0, 0}, vec3{0.2, 0, 0},
+                                        vec3{0, 0.2, 0}},
+                                   material},
+                      center},
+                  axis, degrees(rand(0.0, 90.0))}}
+            : any_object{translate_object{
+                  shape_object{sphere{0.1, point3{0, 0, 0}}, material},
+                  center}};
+    deferred.push_back(object);
+    eager.push_back({object});
+  }
+  bvh_t<any_object> deferred_bvh{deferred, sah_split{}};
+  bvh_t<eager_object<any_object>> eager_bvh{eager, sah_split{}};
+  auto const primary =
+      camera_rays({0, 0, 30}, {0, 0, 0}, degrees(40), 640, 360);
+  auto const bounce = bounce_rays(deferred_bvh, primary, rand);
+  std::printf("%zu objects\n", deferred.size());
+  // Runs alternate, so that neither of them is favoured by running first.
+  double best[2][2] = {};
+  for (int run = 0; run < 3; ++run) {
+    best[0][0] = std::max(best[0][0], rays_per_second(eager_bvh, primary));
+    best[1][0] = std::max(best[1][0], rays_per_second(deferred_bvh, primary));
+    best[0][1] = std::max(best[0][1], rays_per_second(eager_bvh, bounce));
+    best[1][1] = std::max(best[1][1], rays_per_second(deferred_bvh, bounce));
+  }
+  std::printf("%-9s primary: %12.0f rays/s  bounce: %12.0f rays/s\n", "eager",
+              best[0][0], best[0][1]);
+  std::printf("%-9s primary: %12.0f rays/s  bounce: %12.0f rays/s\n",
+              "deferred", best[1][0], best[1][1]);
+}
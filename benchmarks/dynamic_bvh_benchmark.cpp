@@ -0,0 +1,65 @@
+#include "benchmark_utils.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/dynamic_bvh.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <optional>
+#include <vector>
+
+// Compares cost of an edit (removing an object and inserting another) on
+// dynamic_bvh_t against rebuilding bvh_t after it, and rays per second of
+// both on random spheres scene before edits.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+int main() {
+  constexpr static int num_edits = 1000;
+  random_t rand{42};
+  auto world = random_spheres_scene(rand, 100);
+  auto primary = camera_rays({13, 2, 3}, {0, 0, 0}, degrees(20), 400, 225);
+  std::printf("objects: %zu\n", world.size());
+
+  dynamic_bvh_t<any_object> dynamic;
+  std::vector<dynamic_bvh_t<any_object>::handle_t> handles;
+  auto const insert_secs = seconds_for([&] {
+    for (auto const &obj : world) {
+      handles.push_back(dynamic.insert(obj));
+    }
+  });
+  std::optional<bvh_t<any_object>> bvh;
+  auto const build_secs =
+      seconds_for([&] { bvh.emplace(world, sah_split{}); });
+  std::printf("dynamic insert all: %10.3f ms  height: %zu\n",
+              insert_secs * 1000, dynamic.height());
+  std::printf("bvh sah build:      %10.3f ms\n", build_secs * 1000);
+
+  auto bounce = bounce_rays(*bvh, primary, rand);
+  std::printf("dynamic  sah cost: %6.2f  primary: %12.0f rays/s  bounce: "
+              "%12.0f rays/s\n",
+              dynamic.sah_cost(), rays_per_second(dynamic, primary),
+              rays_per_second(dynamic, bounce));
+  std::printf("bvh sah  sah cost: %6.2f  primary: %12.0f rays/s  bounce: "
+              "%12.0f rays/s\n",
+              bvh->sah_cost(), rays_per_second(*bvh, primary),
+              rays_per_second(*bvh, bounce));
+
+  lambertian_t material{color_t{0.5, 0.5, 0.5}};
+  std::vector<any_object> edits;
+  for (int i = 0; i < num_edits; ++i) {
+    auto center = point3{rand(-100.0, 100.0), 0.2, rand(-100.0, 100.0)};
+    edits.push_back(shape_object{sphere{0.2, center}, material});
+  }
+  auto const edit_secs = seconds_for([&] {
+    for (auto const &obj : edits) {
+      auto const i = static_cast<std::size_t>(
+          rand(0.0, static_cast<double>(handles.size())));
+      dynamic.remove(handles[i]);
+      handles[i] = dynamic.insert(obj);
+    }
+  });
+  std::printf("dynamic edit:       %10.3f us/edit\n",
+              edit_secs * 1e6 / num_edits);
+  std::printf("bvh rebuild:        %10.3f us/edit\n", build_secs * 1e6);
+}
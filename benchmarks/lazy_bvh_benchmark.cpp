@@ -0,0 +1,56 @@
+#include "benchmark_utils.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/lazy_bvh.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+// Compares time to first frame of a bvh built up front with a lazy bvh whose
+// subtrees are built by first rays visiting them. Camera sees a small part
+// of a wide scene, like a preview of a huge scene would.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+template <SceneObject Object>
+void trace(Object const &world, std::vector<ray_t> const &rays) {
+  for (auto const &r : rays) {
+    hit(world, r, hit_interval);
+  }
+}
+
+void compare(char const *scene, std::vector<any_object> const &world,
+             std::vector<ray_t> const &rays) {
+  std::printf("%s: %zu objects, %zu rays\n", scene, world.size(), rays.size());
+
+  std::vector<bvh_t<any_object>> eager;
+  auto const eager_build =
+      seconds_for([&] { eager.emplace_back(world, sah_split{}); });
+  auto const eager_trace = seconds_for([&] { trace(eager.front(), rays); });
+  std::printf("%-10s build: %8.3f s  first frame: %8.3f s  total: %8.3f s\n",
+              "eager", eager_build, eager_trace, eager_build + eager_trace);
+
+  for (std::size_t top_depth = 6; top_depth <= 10; top_depth += 2) {
+    std::vector<lazy_bvh_t<any_object, sah_split>> lazy;
+    auto const lazy_build = seconds_for([&] {
+      lazy.emplace_back(world, sah_split{}, lazy_bvh_options{top_depth});
+    });
+    auto const lazy_trace = seconds_for([&] { trace(lazy.front(), rays); });
+    std::printf("lazy %-5zu build: %8.3f s  first frame: %8.3f s  total: "
+                "%8.3f s  built %zu / %zu subtrees\n",
+                top_depth, lazy_build, lazy_trace, lazy_build + lazy_trace,
+                lazy.front().num_built_subtrees(), lazy.front().num_subtrees());
+    std::printf("%-10s primary: %12.0f rays/s (eager %12.0f rays/s)\n", "",
+                rays_per_second(lazy.front(), rays),
+                rays_per_second(eager.front(), rays));
+  }
+}
+
+int main() {
+  random_t rand{42};
+  compare("random spheres", random_spheres_scene(rand, 500),
+          camera_rays({13, 2, 3}, {0, 0, 0}, degrees(40), 400, 225));
+  compare("particle field", particle_field_scene(rand, 1000000, 10, 0.02),
+          camera_rays({0, 0, 30}, {8, 8, 8}, degrees(10), 400, 225));
+}
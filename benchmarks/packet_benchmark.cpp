@@ -0,0 +1,86 @@
+#include "benchmark_utils.hpp"
+#include "ray_packet.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/concepts.hpp"
+#include <bit>
+#include <cstddef>
+#include <cstdio>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Compares rays per second of tracing camera rays one by one against tracing
+// them in packets of tiles of 2x2, 4x2 and 4x4 neighbouring pixels, as
+// img_renderer_t does in packet render modes.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+// Precondition:
+//   - rays are width * height camera rays in row major order
+template <std::size_t N>
+std::vector<std::pair<ray_packet_t<N>, packet_mask_t>>
+tile_packets(std::vector<ray_t> const &rays, int width, int height,
+             int tile_width) {
+  auto const tile_height = static_cast<int>(N) / tile_width;
+  std::vector<std::pair<ray_packet_t<N>, packet_mask_t>> res;
+  for (int row = 0; row < height; row += tile_height) {
+    for (int col = 0; col < width; col += tile_width) {
+      ray_packet_t<N> packet{};
+      packet_mask_t active = 0;
+      for (std::size_t lane = 0; lane < N; ++lane) {
+        auto const x = col + static_cast<int>(lane) % tile_width;
+        auto const y = row + static_cast<int>(lane) / tile_width;
+        if (x >= width || y >= height)
+          continue;
+        set_lane(packet, lane, rays[static_cast<std::size_t>(y * width + x)]);
+        active |= packet_mask_t{1} << lane;
+      }
+      res.emplace_back(packet, active);
+    }
+  }
+  return res;
+}
+
+template <std::size_t N, SceneObject Object>
+double packet_rays_per_second(Object const &world,
+                              std::vector<ray_t> const &rays, int width,
+                              int height, int tile_width, int repeat = 3) {
+  auto const packets = tile_packets<N>(rays, width, height, tile_width);
+  std::size_t num_hits = 0;
+  auto const secs = seconds_for([&] {
+    for (int i = 0; i < repeat; ++i) {
+      for (auto const &[packet, active] : packets) {
+        packet_hits_t<hit_object_t<Object>, N> hits;
+        hits.closest.fill(std::numeric_limits<double>::infinity());
+        num_hits += static_cast<std::size_t>(std::popcount(
+            hit_lanes(world, packet, hit_interval.min, hits, active)));
+      }
+    }
+  });
+  // Keeps the traversal from being optimized away.
+  if (num_hits == std::numeric_limits<std::size_t>::max())
+    std::puts("");
+  return static_cast<double>(rays.size()) * repeat / secs;
+}
+
+int main() {
+  constexpr static int width = 400;
+  constexpr static int height = 225;
+  random_t rand{42};
+  auto world = random_spheres_scene(rand, 100);
+  auto primary =
+      camera_rays({13, 2, 3}, {0, 0, 0}, degrees(20), width, height);
+  bvh_t<any_object> bvh{world, sah_split{}};
+  std::printf("objects: %zu\n", world.size());
+
+  std::printf("single     primary: %12.0f rays/s\n",
+              rays_per_second(bvh, primary));
+  std::printf("packet 4   primary: %12.0f rays/s\n",
+              packet_rays_per_second<4>(bvh, primary, width, height, 2));
+  std::printf("packet 8   primary: %12.0f rays/s\n",
+              packet_rays_per_second<8>(bvh, primary, width, height, 4));
+  std::printf("packet 16  primary: %12.0f rays/s\n",
+              packet_rays_per_second<16>(bvh, primary, width, height, 4));
+}
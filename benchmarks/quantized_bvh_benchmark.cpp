@@ -0,0 +1,39 @@
+#include "benchmark_utils.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/quantized_bvh.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Compares memory taken by nodes against rays per second of full precision
+// bvh_t and bvh with child bounds quantized to 16 and 8 bits.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+template <typename Bvh>
+void run(char const *name, Bvh const &bvh, std::vector<ray_t> const &primary,
+         std::vector<ray_t> const &bounce) {
+  auto const &nodes = bvh.nodes();
+  auto const node_bytes = nodes.size() * sizeof(nodes.front());
+  std::printf("%-8s nodes: %10zu bytes  primary: %12.0f rays/s  bounce: "
+              "%12.0f rays/s\n",
+              name, node_bytes, rays_per_second(bvh, primary),
+              rays_per_second(bvh, bounce));
+}
+
+int main() {
+  random_t rand{42};
+  auto world = random_spheres_scene(rand, 100);
+  auto primary = camera_rays({13, 2, 3}, {0, 0, 0}, degrees(20), 400, 225);
+  auto bounce = bounce_rays(bvh_t<any_object>{world}, primary, rand);
+  std::printf("objects: %zu\n", world.size());
+
+  run("full", bvh_t<any_object>{world, sah_split{}}, primary, bounce);
+  run("16 bits",
+      quantized_bvh_t<any_object, std::uint16_t>{world, sah_split{}}, primary,
+      bounce);
+  run("8 bits", quantized_bvh_t<any_object, std::uint8_t>{world, sah_split{}},
+      primary, bounce);
+}
@@ -0,0 +1,62 @@
+#include "benchmark_utils.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/ray_queue_bvh.hpp"
+#include "schedulers/thread_pool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <optional>
+#include <span>
+#include <stdexec/execution.hpp>
+#include <thread>
+#include <vector>
+
+// Compares tracing incoherent bounce rays one by one with tracing them as
+// streams queued on treelets, on a particle field whose bvh and objects take
+// far more memory than last level cache. Streams of batch_size rays are
+// traced in bulk on thread_pool as the ray_queue render mode traces tiles.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+constexpr static std::size_t batch_size = 1 << 18;
+
+template <SceneObject Object>
+double stream_rays_per_second(thread_pool &pool, Object const &world,
+                              std::vector<ray_t> const &rays) {
+  auto const num_batches = (rays.size() + batch_size - 1) / batch_size;
+  auto trace_batch = [&](std::size_t batch) {
+    auto const first = batch * batch_size;
+    auto const last = std::min(first + batch_size, rays.size());
+    std::vector<std::optional<hit_info_of<Object>>> hits(last - first);
+    hit_rays(world, std::span{rays}.subspan(first, last - first), hit_interval,
+             std::span{hits});
+  };
+  auto const seconds = seconds_for([&] {
+    stdexec::sync_wait(stdexec::schedule(pool.get_scheduler()) |
+                       stdexec::bulk(num_batches, trace_batch));
+  });
+  return static_cast<double>(rays.size()) / seconds;
+}
+
+int main() {
+  random_t rand{42};
+  thread_pool pool{std::thread::hardware_concurrency()};
+  auto world = particle_field_scene(rand, 4000000, 20, 0.02);
+  bvh_t<any_object> bvh{world, sah_split{}};
+  auto const primary =
+      camera_rays({0, 0, 60}, {0, 0, 0}, degrees(40), 1280, 720);
+  auto const bounce = bounce_rays(bvh, primary, rand);
+  std::printf("particle field: %zu objects, %zu nodes, %zu bounce rays\n",
+              world.size(), bvh.nodes().size(), bounce.size());
+  std::printf("%-22s %12.0f rays/s\n", "bvh one by one",
+              stream_rays_per_second(pool, bvh, bounce));
+  for (std::size_t kib = 64; kib <= 4096; kib *= 4) {
+    ray_queue_bvh_t queued{bvh, ray_queue_options{kib * 1024}};
+    std::printf("queued %5zu KiB %6u treelets %12.0f rays/s\n", kib,
+                queued.treelets().num_treelets,
+                stream_rays_per_second(pool, queued, bounce));
+  }
+}
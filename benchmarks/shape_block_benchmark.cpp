@@ -0,0 +1,84 @@
+#include "benchmark_utils.hpp"
+#include "materials/lambertian.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/scene_object_range.hpp"
+#include "scene_objects/shapes/quad.hpp"
+#include "scene_objects/shapes/shape_object.hpp"
+#include "scene_objects/shapes/shape_object_block.hpp"
+#include "scene_objects/shapes/sphere.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+// Compares hitting spheres and quads one at a time against hitting them in
+// blocks of 4 and 8, both through a bvh with leaves of one object or one
+// block and by brute force over a small scene. Build with -march=native (or
+// -mavx2) for block kernels to use 256 bit registers.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+using material = lambertian_t<solid_color_texture>;
+
+template <typename Shape, typename MakeShape>
+std::vector<shape_object<Shape, material>>
+random_scene(random_t &rand, int num_objects, double extent,
+             MakeShape make_shape) {
+  std::vector<shape_object<Shape, material>> world;
+  for (int i = 0; i < num_objects; ++i) {
+    auto const center = point3{rand(-extent, extent), rand(-extent, extent),
+                               rand(-extent, extent)};
+    auto const color = color_t{rand(0.0, 1.0), rand(0.0, 1.0), rand(0.0, 1.0)};
+    world.push_back({make_shape(center), color});
+  }
+  return world;
+}
+
+template <typename Object>
+void compare(char const *scene, std::vector<Object> const &world,
+             std::vector<ray_t> const &rays) {
+  auto const blocks_4 = make_shape_object_blocks<4>(world, sah_split{});
+  auto const blocks_8 = make_shape_object_blocks<8>(world, sah_split{});
+  std::printf("%s: %zu objects\n", scene, world.size());
+  std::printf("  bvh one by one     %12.0f rays/s\n",
+              rays_per_second(bvh_t{world, sah_split{}}, rays));
+  std::printf("  bvh blocks of 4    %12.0f rays/s\n",
+              rays_per_second(bvh_t{blocks_4, sah_split{}}, rays));
+  std::printf("  bvh blocks of 8    %12.0f rays/s\n",
+              rays_per_second(bvh_t{blocks_8, sah_split{}}, rays));
+}
+
+template <typename Object>
+void compare_brute_force(char const *scene, std::vector<Object> const &world,
+                         std::vector<ray_t> const &rays) {
+  std::printf("%s: %zu objects\n", scene, world.size());
+  std::printf("  range one by one   %12.0f rays/s\n",
+              rays_per_second(world, rays));
+  std::printf("  range blocks of 4  %12.0f rays/s\n",
+              rays_per_second(make_shape_object_blocks<4>(world), rays));
+  std::printf("  range blocks of 8  %12.0f rays/s\n",
+              rays_per_second(make_shape_object_blocks<8>(world), rays));
+}
+
+int main() {
+  random_t rand{42};
+  auto make_sphere = [](point3 center) { return sphere{0.05, center}; };
+  auto make_quad = [](point3 center) {
+    return quad{center, vec3{0.1, 0, 0}, vec3{0, 0.1, 0.05}};
+  };
+  auto const rays =
+      camera_rays({0, 0, 30}, {0, 0, 0}, degrees(40), 640, 360);
+  auto const spheres = random_scene<sphere>(rand, 200000, 10, make_sphere);
+  auto const quads = random_scene<quad>(rand, 200000, 10, make_quad);
+  compare("spheres", spheres, bounce_rays(bvh_t{spheres}, rays, rand));
+  compare("quads", quads, bounce_rays(bvh_t{quads}, rays, rand));
+  auto const small_rays =
+      camera_rays({0, 0, 30}, {0, 0, 0}, degrees(40), 160, 90);
+  compare_brute_force("small spheres",
+                      random_scene<sphere>(rand, 64, 10, make_sphere),
+                      small_rays);
+  compare_brute_force("small quads",
+                      random_scene<quad>(rand, 64, 10, make_quad),
+                      small_rays);
+}
@@ -0,0 +1,64 @@
+#include "angle.hpp"
+#include "benchmark_utils.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/rotate_object.hpp"
+#include "scene_objects/shapes/quad.hpp"
+#include "scene_objects/shapes/shape_object.hpp"
+#include "scene_objects/transform_object.hpp"
+#include "scene_objects/translate_object.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// Compares quads placed by chains of translate and rotate objects against
+// same chains collapsed into one transform_object by make_transform_object.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+// Hit object of a chain takes 144 bytes. Flattened objects are erased into
+// same type, so that only the objects differ.
+using chain_object = any_scene_object<random_t, 144>;
+
+int main() {
+  random_t rand{42};
+  std::vector<chain_object> chains;
+  std::vector<chain_object> flattened;
+  lambertian_t material{color_t{0.5, 0.5, 0.5}};
+  auto const up = ray_t{point3{0, 0, 0}, direction_t{vec3{0, 1, 0}}};
+  auto const forward = ray_t{point3{0, 0, 0}, direction_t{vec3{0, 0, 1}}};
+  for (int i = 0; i < 200000; ++i) {
+    auto const center =
+        point3{rand(-10.0, 10.0), rand(-10.0, 10.0), rand(-10.0, 10.0)};
+    auto chain = translate_object{
+        rotate_object{
+            rotate_object{
+                shape_object{quad{point3{-0.1, -0.1, 0}, vec3{0.2, 0, 0},
+                                  vec3{0, 0.2, 0}},
+                             material},
+                forward, degrees(rand(0.0, 90.0))},
+            up, degrees(rand(0.0, 90.0))},
+        center};
+    chains.push_back(chain);
+    flattened.push_back(make_transform_object(chain));
+  }
+  bvh_t<chain_object> chains_bvh{chains, sah_split{}};
+  bvh_t<chain_object> flattened_bvh{flattened, sah_split{}};
+  auto const primary =
+      camera_rays({0, 0, 30}, {0, 0, 0}, degrees(40), 640, 360);
+  auto const bounce = bounce_rays(flattened_bvh, primary, rand);
+  std::printf("%zu objects\n", chains.size());
+  // Runs alternate, so that neither of them is favoured by running first.
+  double best[2][2] = {};
+  for (int run = 0; run < 3; ++run) {
+    best[0][0] = std::max(best[0][0], rays_per_second(chains_bvh, primary));
+    best[1][0] = std::max(best[1][0], rays_per_second(flattened_bvh, primary));
+    best[0][1] = std::max(best[0][1], rays_per_second(chains_bvh, bounce));
+    best[1][1] = std::max(best[1][1], rays_per_second(flattened_bvh, bounce));
+  }
+  std::printf("%-10s primary: %12.0f rays/s  bounce: %12.0f rays/s\n",
+              "chains", best[0][0], best[0][1]);
+  std::printf("%-10s primary: %12.0f rays/s  bounce: %12.0f rays/s\n",
+              "flattened", best[1][0], best[1][1]);
+}
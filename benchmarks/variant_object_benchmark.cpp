@@ -0,0 +1,71 @@
+#include "benchmark_utils.hpp"
+#include "materials/lambertian.hpp"
+#include "materials/metal.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/shapes/quad.hpp"
+#include "scene_objects/shapes/shape_object.hpp"
+#include "scene_objects/shapes/sphere.hpp"
+#include "scene_objects/variant_scene_object.hpp"
+#include <cstdio>
+#include <vector>
+
+// Compares bvh of any_object against bvh of variant_scene_object over same
+// mixed scene of lambertian spheres, metal spheres and lambertian quads.
+
+using namespace mrl;
+using namespace mrl::bench;
+
+using lambertian_sphere =
+    shape_object<sphere, lambertian_t<solid_color_texture>>;
+using metal_sphere = shape_object<sphere, metal_t<solid_color_texture>>;
+using lambertian_quad = shape_object<quad, lambertian_t<solid_color_texture>>;
+using variant_object =
+    variant_scene_object<lambertian_sphere, metal_sphere, lambertian_quad>;
+
+// Pushes num_objects random objects to every world.
+template <typename... World>
+void mixed_scene(random_t &rand, int num_objects, double extent,
+                 World &...world) {
+  for (int i = 0; i < num_objects; ++i) {
+    auto const center = point3{rand(-extent, extent), rand(-extent, extent),
+                               rand(-extent, extent)};
+    auto const color = color_t{rand(0.0, 1.0), rand(0.0, 1.0), rand(0.0, 1.0)};
+    switch (i % 3) {
+    case 0:
+      (world.push_back(lambertian_sphere{sphere{0.1, center}, color}), ...);
+      break;
+    case 1:
+      (world.push_back(metal_sphere{sphere{0.1, center}, color}), ...);
+      break;
+    default:
+      (world.push_back(lambertian_quad{
+           quad{center, vec3{0.2, 0, 0}, vec3{0, 0.2, 0}}, color}),
+       ...);
+    }
+  }
+}
+
+template <typename Object>
+void run(char const *name, std::vector<Object> const &world,
+         std::vector<ray_t> const &primary, std::vector<ray_t> const &bounce) {
+  bvh_t<Object> bvh{world, sah_split{}};
+  std::printf("%-8s object: %3zu bytes  primary: %12.0f rays/s  bounce: "
+              "%12.0f rays/s\n",
+              name, sizeof(Object), rays_per_second(bvh, primary),
+              rays_per_second(bvh, bounce));
+}
+
+int main() {
+  random_t rand{42};
+  std::vector<any_object> any_world;
+  std::vector<variant_object> variant_world;
+  mixed_scene(rand, 300000, 10, any_world, variant_world);
+  auto const primary =
+      camera_rays({0, 0, 30}, {0, 0, 0}, degrees(40), 640, 360);
+  auto const bounce =
+      bounce_rays(bvh_t<any_object>{any_world}, primary, rand);
+  std::printf("mixed scene: %zu objects\n", any_world.size());
+  run("any", any_world, primary, bounce);
+  run("variant", variant_world, primary, bounce);
+}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "interval.hpp"
+#include "point.hpp"
+#include "prepared_ray.hpp"
 #include "ray.hpp"
 #include "vector.hpp"
 #include <algorithm>
+#include <array>
 #include <limits>
 #include <optional>
 #include <ostream>
@@ -21,39 +24,106 @@ inline std::ostream &operator<<(std::ostream &os, bound_t const &bound) {
   return os;
 }
 
+// bound_t stored as its min corner followed by its max corner. This lets slab
+// test pick near and far corner of every axis by sign of ray direction
+// instead of comparing distances.
+//
+// Class Invariant:
+//   - corners[0] is min corner, corners[1] is max corner
+struct minmax_bound_t {
+  std::array<point3, 2> corners;
+};
+
+constexpr minmax_bound_t to_minmax_bound(bound_t const &bound) {
+  return {{
+      point3{bound.x_range.min, bound.y_range.min, bound.z_range.min},
+      point3{bound.x_range.max, bound.y_range.max, bound.z_range.max},
+  }};
+}
+
+constexpr bound_t to_bound(minmax_bound_t const &bound) {
+  auto const &[min, max] = bound.corners;
+  return {
+      interval_t{min.x, max.x},
+      interval_t{min.y, max.y},
+      interval_t{min.z, max.z},
+  };
+}
+
 namespace __details {
 constexpr auto inf = std::numeric_limits<double>::infinity();
-constexpr std::optional<interval_t> time_range(double a, double b,
-                                               interval_t range) {
-  if (b == 0) {
-    if (a >= range.min && a <= range.max) {
-      return interval_t{0, inf};
-    }
-    return std::nullopt;
-  }
-  auto t1 = (range.min - a) / b;
-  auto t2 = (range.max - a) / b;
-  auto min = std::min(t1, t2);
-  auto max = std::max(t1, t2);
-  if (max < 0)
-    return std::nullopt;
-  return interval_t{std::max(min, 0.0), std::max(max, 0.0)};
+
+// Rounding error bound of 3 floating point operations.
+constexpr double gamma_3 = (3 * std::numeric_limits<double>::epsilon() / 2) /
+                           (1 - 3 * std::numeric_limits<double>::epsilon() / 2);
+
+// Returns acc if t is NaN
+constexpr double max_ignore_nan(double t, double acc) {
+  return t > acc ? t : acc;
+}
+
+// Returns acc if t is NaN
+constexpr double min_ignore_nan(double t, double acc) {
+  return t < acc ? t : acc;
 }
 }; // namespace __details
 
+// Branchless slab test.
+//
+// Postcondition:
+//   - returns the part of interval for which ray lies inside bounds
+//   - returned interval is empty (min > max) if ray misses bounds
+//   - zero components of ray direction are handled. If ray origin lies on a
+//     face parallel to ray, that face is considered inside the bounds
+//   - far distances are rounded up conservatively, so rays grazing bounds are
+//     never reported as miss because of floating point error
+constexpr interval_t clip_interval(prepared_ray_t const &ray,
+                                   minmax_bound_t const &bounds,
+                                   interval_t interval) {
+  using namespace __details;
+  auto const &c = bounds.corners;
+  auto const &o = ray.origin;
+  auto const &inv = ray.inv_direction;
+  auto const &sign = ray.sign;
+  constexpr double far_scale = 1 + 2 * gamma_3;
+  auto const tx_near = (c[sign[0]].x - o.x) * inv.x;
+  auto const tx_far = (c[1 - sign[0]].x - o.x) * inv.x * far_scale;
+  auto const ty_near = (c[sign[1]].y - o.y) * inv.y;
+  auto const ty_far = (c[1 - sign[1]].y - o.y) * inv.y * far_scale;
+  auto const tz_near = (c[sign[2]].z - o.z) * inv.z;
+  auto const tz_far = (c[1 - sign[2]].z - o.z) * inv.z * far_scale;
+  interval.min = max_ignore_nan(tx_near, interval.min);
+  interval.min = max_ignore_nan(ty_near, interval.min);
+  interval.min = max_ignore_nan(tz_near, interval.min);
+  interval.max = min_ignore_nan(tx_far, interval.max);
+  interval.max = min_ignore_nan(ty_far, interval.max);
+  interval.max = min_ignore_nan(tz_far, interval.max);
+  return interval;
+}
+
+constexpr bool hit_bounds(prepared_ray_t const &ray,
+                          minmax_bound_t const &bounds,
+                          interval_t const &interval) {
+  auto const clipped = clip_interval(ray, bounds, interval);
+  return clipped.min <= clipped.max;
+}
+
+// Postcondition:
+//   - returns least t in interval such that ray.at(t) lies inside bounds if
+//     any
+constexpr std::optional<double>
+hit_bounds_distance(ray_t const &ray, bound_t const &bounds,
+                    interval_t const &interval) {
+  auto const clipped =
+      clip_interval(prepare(ray), to_minmax_bound(bounds), interval);
+  if (clipped.min <= clipped.max)
+    return clipped.min;
+  return std::nullopt;
+}
+
 constexpr bool hit_bounds(ray_t const &ray, bound_t const &bounds) {
-  auto x_int = __details::time_range(ray.origin.x, ray.direction.val().x,
-                                     bounds.x_range);
-  auto y_int = __details::time_range(ray.origin.y, ray.direction.val().y,
-                                     bounds.y_range);
-  auto z_int = __details::time_range(ray.origin.z, ray.direction.val().z,
-                                     bounds.z_range);
-  if (x_int && y_int && z_int) {
-    auto t1 = std::max({x_int->min, y_int->min, z_int->min});
-    auto t2 = std::min({x_int->max, y_int->max, z_int->max});
-    return t1 <= t2;
-  }
-  return false;
+  return hit_bounds(prepare(ray), to_minmax_bound(bounds),
+                    interval_t{0, __details::inf});
 }
 
 constexpr bound_t union_bounds(bound_t const &a, bound_t const &b) {
@@ -72,6 +142,63 @@ constexpr bound_t union_bounds(bound_t const &a, bound_t const &b) {
   return {x_range, y_range, z_range};
 }
 
+constexpr minmax_bound_t union_bounds(minmax_bound_t const &a,
+                                      minmax_bound_t const &b) {
+  return to_minmax_bound(union_bounds(to_bound(a), to_bound(b)));
+}
+
+// Precondition:
+//   - axis is one of 0, 1, 2 (x, y, z)
+constexpr interval_t const &axis_range(bound_t const &bound, int axis) {
+  return axis == 0 ? bound.x_range
+                   : (axis == 1 ? bound.y_range : bound.z_range);
+}
+
+// Precondition:
+//   - axis is one of 0, 1, 2 (x, y, z)
+constexpr interval_t &axis_range(bound_t &bound, int axis) {
+  return axis == 0 ? bound.x_range
+                   : (axis == 1 ? bound.y_range : bound.z_range);
+}
+
+constexpr bool is_empty(bound_t const &bound) {
+  return bound.x_range.min > bound.x_range.max ||
+         bound.y_range.min > bound.y_range.max ||
+         bound.z_range.min > bound.z_range.max;
+}
+
+// Postcondition:
+//   - returned bound may be empty
+constexpr bound_t intersect_bounds(bound_t const &a, bound_t const &b) {
+  auto intersect = [](interval_t const &x, interval_t const &y) {
+    return interval_t{std::max(x.min, y.min), std::min(x.max, y.max)};
+  };
+  return {
+      intersect(a.x_range, b.x_range),
+      intersect(a.y_range, b.y_range),
+      intersect(a.z_range, b.z_range),
+  };
+}
+
+constexpr point3 centroid(bound_t const &bound) {
+  return {
+      (bound.x_range.min + bound.x_range.max) / 2,
+      (bound.y_range.min + bound.y_range.max) / 2,
+      (bound.z_range.min + bound.z_range.max) / 2,
+  };
+}
+
+// Postcondition:
+//   - returns 0 for an empty bound
+constexpr double surface_area(bound_t const &bound) {
+  auto const dx = size(bound.x_range);
+  auto const dy = size(bound.y_range);
+  auto const dz = size(bound.z_range);
+  if (dx < 0 || dy < 0 || dz < 0)
+    return 0;
+  return 2 * (dx * dy + dy * dz + dz * dx);
+}
+
 constexpr bound_t pad_bounds(bound_t bound) {
   constexpr static double delta = 0.0001;
   bound.x_range = (size(bound.x_range) >= delta) ? bound.x_range
@@ -15,16 +15,24 @@
 #include "pixel_sampler/concepts.hpp"
 #include "pixel_sampler/delta_sampler.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
 #include "scene_objects/concepts.hpp"
 #include "scene_objects/translate_object.hpp"
 #include "schedulers/concepts.hpp"
 #include "schedulers/type_traits.hpp"
 #include "vector.hpp"
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstddef>
 #include <functional>
 #include <limits>
+#include <optional>
+#include <span>
 #include <stdexec/execution.hpp>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace mrl {
 
@@ -49,22 +57,63 @@ constexpr vec3 viewport_topleft(vec3 right, vec3 down, point3 camera_pos,
   return camera_pos + camera_dir.val() * f - right / 2 - down / 2;
 }
 
+// Every mode renders the same scene with equivalent sampling, other modes
+// only trace rays differently. Modes draw random numbers in different
+// order, so their images agree only statistically, not pixel for pixel.
+enum class render_mode_t {
+  // Every ray is traced alone.
+  single_ray,
+  // Camera rays of tiles of 2x2, 4x2 or 4x4 neighbouring pixels are traced
+  // together as packets, sharing traversal of world. Secondary rays are
+  // traced alone.
+  packet_4,
+  packet_8,
+  packet_16,
+  // Rays of tiles of 32x32 pixels are traced as streams with hit_rays, bounce
+  // by bounce: camera rays of all samples of tile first, then all rays they
+  // scatter and so on. A world supporting hit_stream, like ray_queue_bvh_t,
+  // traces a whole stream through one part of it at a time.
+  ray_queue,
+};
+
+// Postcondition:
+//   - returns width and height of tile of pixels whose camera rays are traced
+//     together in mode
+constexpr std::pair<int, int> tile_size(render_mode_t mode) {
+  switch (mode) {
+  case render_mode_t::packet_4:
+    return {2, 2};
+  case render_mode_t::packet_8:
+    return {4, 2};
+  case render_mode_t::packet_16:
+    return {4, 4};
+  case render_mode_t::ray_queue:
+    return {32, 32};
+  default:
+    return {1, 1};
+  }
+}
+
+namespace __renderer_details {
+constexpr static double closeness_limit = 0.001;
+}
+
 template <DoubleGenerator Generator, SceneObject Object>
 constexpr color_t ray_color(ray_t const &ray, Object const &world, int depth,
+                            color_t const &background_color,
+                            generator_view<Generator> rand);
+
+// Color seen along ray hitting world as hit_rec tells. Rays scattered at hit
+// point are traced by ray_color.
+template <DoubleGenerator Generator, SceneObject Object>
+constexpr color_t hit_color(ray_t const &ray,
+                            hit_info_of<Object> const &hit_rec,
+                            Object const &world, int depth,
                             color_t const &background_color,
                             generator_view<Generator> rand) {
-  if (depth <= 0)
-    return {0, 0, 0};
-  constexpr static double closeness_limit = 0.001;
-  constexpr static auto hit_interval =
-      interval_t{closeness_limit, std::numeric_limits<double>::infinity()};
-  auto const hit_rec_opt = hit(world, ray, hit_interval);
-  if (!hit_rec_opt) {
-    return background_color;
-  }
-  auto const hit_distance = hit_rec_opt->hit_distance;
+  auto const hit_distance = hit_rec.hit_distance;
   auto const hit_point = ray.at(hit_distance);
-  HitObject<Generator> auto const hit_obj = std::move(hit_rec_opt->hit_object);
+  HitObject<Generator> auto const &hit_obj = hit_rec.hit_object;
   auto const scattering = scattering_for(hit_obj, ray, hit_distance, rand);
   auto const emitted = emission_at(hit_obj, hit_point, rand)
                            .value_or(emit_info_t{color_t{0, 0, 0}})
@@ -80,6 +129,22 @@ constexpr color_t ray_color(ray_t const &ray, Object const &world, int depth,
   return scattering_color + emitted;
 }
 
+template <DoubleGenerator Generator, SceneObject Object>
+constexpr color_t ray_color(ray_t const &ray, Object const &world, int depth,
+                            color_t const &background_color,
+                            generator_view<Generator> rand) {
+  if (depth <= 0)
+    return {0, 0, 0};
+  constexpr static auto hit_interval =
+      interval_t{__renderer_details::closeness_limit,
+                 std::numeric_limits<double>::infinity()};
+  auto const hit_rec_opt = hit(world, ray, hit_interval);
+  if (!hit_rec_opt) {
+    return background_color;
+  }
+  return hit_color(ray, *hit_rec_opt, world, depth, background_color, rand);
+}
+
 // Precondition:
 //   - std::ranges::distance(rng) >= 1
 //   - RayOriginGenerator generates center in defocus disk
@@ -144,17 +209,25 @@ constexpr auto build_rendering_context(Image &img, camera_t const &camera,
   };
 }
 
+// Postcondition:
+//   - returns a generator of camera ray origins in defocus disk
+template <DoubleGenerator random_t>
+constexpr auto make_ray_origin_generator(rendering_context_t const &ctx,
+                                         generator_view<random_t> rand) {
+  return [ctx, rand] {
+    auto p = unit_disk_generator{}(rand);
+    return ctx.camera_position + ctx.defocus_disk_u * p.x +
+           ctx.defocus_disk_v * p.y;
+  };
+}
+
 template <DoubleGenerator random_t, SceneObject Object,
           PixelSampler<random_t> Sampler>
 constexpr auto generate_pixel(int row, int col, Object const &world,
                               rendering_context_t ctx, Sampler sampler,
                               color_t const &background_color,
                               generator_view<random_t> rand) {
-  auto ray_origin_generator = [ctx, rand] {
-    auto p = unit_disk_generator{}(rand);
-    return ctx.camera_position + ctx.defocus_disk_u * p.x +
-           ctx.defocus_disk_v * p.y;
-  };
+  auto ray_origin_generator = make_ray_origin_generator(ctx, rand);
   auto pixel_center =
       ctx.pixel00_loc + col * ctx.pixel_delta_u + row * ctx.pixel_delta_v;
   auto sampling_points = sampler(
@@ -168,6 +241,176 @@ constexpr auto generate_pixel(int row, int col, Object const &world,
                            world, ctx.rendering_depth, background_color, rand);
 }
 
+// Renders tile of pixels of width tile_width whose top left pixel is at
+// (row, col). k'th camera rays of all pixels of tile are traced together as
+// one packet of N lanes, lane i being pixel (row + i / tile_width,
+// col + i % tile_width). Lanes of pixels outside img and of pixels having
+// fewer than k samples are masked off.
+//
+// Precondition:
+//   - N is a multiple of tile_width
+template <std::size_t N, DoubleGenerator random_t, SceneObject Object,
+          PixelSampler<random_t> Sampler, OutputRandomAccessImage Image>
+void generate_tile_pixels(int row, int col, int tile_width,
+                          Object const &world, Image &img,
+                          rendering_context_t ctx, Sampler sampler,
+                          color_t const &background_color,
+                          generator_view<random_t> rand) {
+  auto ray_origin_generator = make_ray_origin_generator(ctx, rand);
+  auto const width_ = static_cast<std::size_t>(tile_width);
+  auto pixel_of = [row, col, width_](std::size_t lane) {
+    return std::pair{col + static_cast<int>(lane % width_),
+                     row + static_cast<int>(lane / width_)};
+  };
+  std::array<std::vector<point3>, N> sampling_points;
+  std::size_t max_samples = 0;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    auto const [x, y] = pixel_of(lane);
+    if (x >= width(img) || y >= height(img))
+      continue;
+    auto pixel_center =
+        ctx.pixel00_loc + x * ctx.pixel_delta_u + y * ctx.pixel_delta_v;
+    for (point3 const &p : sampler(
+             {
+                 .point = pixel_center,
+                 .pixel_delta_u = ctx.pixel_delta_u,
+                 .pixel_delta_v = ctx.pixel_delta_v,
+             },
+             rand)) {
+      sampling_points[lane].push_back(p);
+    }
+    max_samples = std::max(max_samples, sampling_points[lane].size());
+  }
+
+  std::array<color_t, N> colors;
+  colors.fill(color_t{0, 0, 0});
+  for (std::size_t k = 0; k < max_samples; ++k) {
+    ray_packet_t<N> packet{};
+    packet_mask_t active = 0;
+    for (std::size_t lane = 0; lane < N; ++lane) {
+      if (k >= sampling_points[lane].size())
+        continue;
+      auto const ray_origin = std::invoke(ray_origin_generator);
+      set_lane(packet, lane,
+               ray_t{
+                   .origin = ray_origin,
+                   .direction = sampling_points[lane][k] - ray_origin,
+               });
+      active |= packet_mask_t{1} << lane;
+    }
+    packet_hits_t<hit_object_t<Object>, N> hits;
+    hits.closest.fill(std::numeric_limits<double>::infinity());
+    hit_lanes(world, packet, __renderer_details::closeness_limit, hits,
+              active);
+    for_each_lane(active, [&](std::size_t lane) {
+      if (ctx.rendering_depth <= 0)
+        return;
+      auto const &hit_rec = hits.hits[lane];
+      colors[lane] +=
+          hit_rec ? hit_color(lane_ray(packet, lane), *hit_rec, world,
+                              ctx.rendering_depth, background_color, rand)
+                  : background_color;
+    });
+  }
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    if (sampling_points[lane].empty())
+      continue;
+    auto const [x, y] = pixel_of(lane);
+    set_pixel_at(img, x, y,
+                 colors[lane] /
+                     static_cast<double>(sampling_points[lane].size()));
+  }
+}
+
+// Renders tile of pixels of given size whose top left pixel is at (row, col),
+// tracing rays of all its samples bounce by bounce. A path carries product of
+// attenuations along it, so color it adds to its pixel is what ray_color
+// would give for it.
+template <DoubleGenerator random_t, SceneObject Object,
+          PixelSampler<random_t> Sampler, OutputRandomAccessImage Image>
+void generate_stream_tile_pixels(int row, int col, int tile_width,
+                                 int tile_height, Object const &world,
+                                 Image &img, rendering_context_t ctx,
+                                 Sampler sampler,
+                                 color_t const &background_color,
+                                 generator_view<random_t> rand) {
+  struct path_t {
+    std::size_t pixel;
+    color_t throughput;
+  };
+
+  constexpr static auto hit_interval =
+      interval_t{__renderer_details::closeness_limit,
+                 std::numeric_limits<double>::infinity()};
+  auto ray_origin_generator = make_ray_origin_generator(ctx, rand);
+  auto const tile_cols = std::min(tile_width, width(img) - col);
+  auto const tile_rows = std::min(tile_height, height(img) - row);
+  auto const num_pixels = static_cast<std::size_t>(tile_cols * tile_rows);
+  std::vector<color_t> colors(num_pixels, color_t{0, 0, 0});
+  std::vector<std::size_t> num_samples(num_pixels, 0);
+  std::vector<path_t> paths;
+  std::vector<ray_t> rays;
+  for (std::size_t pixel = 0; pixel < num_pixels; ++pixel) {
+    auto const x = col + static_cast<int>(pixel) % tile_cols;
+    auto const y = row + static_cast<int>(pixel) / tile_cols;
+    auto pixel_center =
+        ctx.pixel00_loc + x * ctx.pixel_delta_u + y * ctx.pixel_delta_v;
+    for (point3 const &p : sampler(
+             {
+                 .point = pixel_center,
+                 .pixel_delta_u = ctx.pixel_delta_u,
+                 .pixel_delta_v = ctx.pixel_delta_v,
+             },
+             rand)) {
+      auto const ray_origin = std::invoke(ray_origin_generator);
+      paths.push_back({pixel, color_t{1, 1, 1}});
+      rays.push_back(ray_t{.origin = ray_origin, .direction = p - ray_origin});
+      ++num_samples[pixel];
+    }
+  }
+
+  std::vector<std::optional<hit_info_of<Object>>> hits;
+  for (auto depth = ctx.rendering_depth; depth > 0 && !paths.empty();
+       --depth) {
+    hits.resize(rays.size());
+    hit_rays(world, std::span<ray_t const>{rays}, hit_interval,
+             std::span{hits});
+    std::size_t num_scattered = 0;
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+      auto const &path = paths[i];
+      if (!hits[i]) {
+        colors[path.pixel] += path.throughput * background_color;
+        continue;
+      }
+      auto const &ray = rays[i];
+      auto const hit_distance = hits[i]->hit_distance;
+      HitObject<random_t> auto const &hit_obj = hits[i]->hit_object;
+      auto const scattering = scattering_for(hit_obj, ray, hit_distance, rand);
+      if (auto const emitted =
+              emission_at(hit_obj, ray.at(hit_distance), rand)) {
+        colors[path.pixel] += path.throughput * emitted->color;
+      }
+      if (!scattering)
+        continue;
+      paths[num_scattered] = {path.pixel,
+                              path.throughput * scattering->attenuated_color};
+      rays[num_scattered] = scattering->scattered_ray;
+      ++num_scattered;
+    }
+    paths.resize(num_scattered);
+    rays.erase(rays.begin() + static_cast<std::ptrdiff_t>(num_scattered),
+               rays.end());
+  }
+
+  for (std::size_t pixel = 0; pixel < num_pixels; ++pixel) {
+    if (num_samples[pixel] == 0)
+      continue;
+    set_pixel_at(img, col + static_cast<int>(pixel) % tile_cols,
+                 row + static_cast<int>(pixel) / tile_cols,
+                 colors[pixel] / static_cast<double>(num_samples[pixel]));
+  }
+}
+
 template <Camera camera_t, OutputRandomAccessImage Image, Scheduler scheduler_t,
           DoubleGenerator random_t, SceneObject Object,
           PixelSampler<random_t> Sampler>
@@ -175,21 +418,46 @@ constexpr auto
 render_image(Object const &world, Image &img, camera_t const &camera,
              camera_orientation_t const &orientation, Sampler sampler,
              int rendering_depth, color_t const &background_color,
-             scheduler_t scheduler, generator_view<random_t> rand) {
+             scheduler_t scheduler, generator_view<random_t> rand,
+             render_mode_t mode = render_mode_t::single_ray) {
   auto rendering_ctx =
       build_rendering_context(img, camera, orientation, rendering_depth);
+  auto const tile_width = tile_size(mode).first;
+  auto const tile_height = tile_size(mode).second;
+  auto const tiles_per_row = (width(img) + tile_width - 1) / tile_width;
+  auto const num_tiles =
+      tiles_per_row * ((height(img) + tile_height - 1) / tile_height);
 
-  auto set_pixel_at_coord = [&img, &world, rendering_ctx, sampler, rand,
-                             background_color](auto coord) {
-    auto x = coord % width(img);
-    auto y = coord / width(img);
+  auto set_pixels_of_tile = [&img, &world, rendering_ctx, sampler, rand,
+                             background_color, mode, tiles_per_row,
+                             tile_width, tile_height](auto tile) {
+    auto x = static_cast<int>(tile) % tiles_per_row * tile_width;
+    auto y = static_cast<int>(tile) / tiles_per_row * tile_height;
+    auto set_tile = [&]<std::size_t N> {
+      generate_tile_pixels<N>(y, x, tile_width, world, img, rendering_ctx,
+                              sampler, background_color, rand);
+    };
+    switch (mode) {
+    case render_mode_t::packet_4:
+      return set_tile.template operator()<4>();
+    case render_mode_t::packet_8:
+      return set_tile.template operator()<8>();
+    case render_mode_t::packet_16:
+      return set_tile.template operator()<16>();
+    case render_mode_t::ray_queue:
+      return generate_stream_tile_pixels(y, x, tile_width, tile_height, world,
+                                         img, rendering_ctx, sampler,
+                                         background_color, rand);
+    default:
+      break;
+    }
     auto color = generate_pixel(y, x, world, rendering_ctx, sampler,
                                 background_color, rand);
     set_pixel_at(img, x, y, color);
   };
 
   return stdexec::schedule(scheduler) |
-         stdexec::bulk(height(img) * width(img), set_pixel_at_coord);
+         stdexec::bulk(num_tiles, set_pixels_of_tile);
 }
 
 template <Camera camera_t, Scheduler scheduler_t,
@@ -204,6 +472,7 @@ struct img_renderer_t {
   random_generator_t gen;
   int rendering_depth;
   Sampler sampler;
+  render_mode_t render_mode = render_mode_t::single_ray;
 
   img_renderer_t(camera_t camera_, camera_orientation_t camera_orientation_,
                  color_t const &background_color_, scheduler_t scheduler_,
@@ -228,7 +497,7 @@ struct img_renderer_t {
   constexpr auto render(Object const &world, Image &img) {
     return render_image(world, img, camera, camera_orientation, sampler,
                         rendering_depth, background_color, scheduler,
-                        generator_view{gen});
+                        generator_view{gen}, render_mode);
   }
 };
 
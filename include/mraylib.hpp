@@ -36,22 +36,52 @@
 #include "pixel_sampler/identity_sampler.hpp"
 #include "pixel_sampler/sampler_args.hpp"
 #include "point.hpp"
+#include "prepared_ray.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
 #include "rotation.hpp"
 #include "scale_2d.hpp"
 #include "scene.hpp"
 #include "scene_objects/any_scene_object.hpp"
 #include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/bvh/cost.hpp"
+#include "scene_objects/bvh/layout.hpp"
+#include "scene_objects/bvh/lbvh.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/parallel_build.hpp"
+#include "scene_objects/bvh/quantized_node.hpp"
+#include "scene_objects/bvh/refit.hpp"
+#include "scene_objects/bvh/sbvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/bvh/stats.hpp"
+#include "scene_objects/bvh/treelet.hpp"
+#include "scene_objects/bvh/treelet_partition.hpp"
+#include "scene_objects/bvh/wide_node.hpp"
 #include "scene_objects/concepts.hpp"
+#include "scene_objects/dynamic_bvh.hpp"
+#include "scene_objects/grid.hpp"
+#include "scene_objects/instance.hpp"
+#include "scene_objects/kd_tree.hpp"
+#include "scene_objects/laid_out_bvh.hpp"
+#include "scene_objects/lazy_bvh.hpp"
 #include "scene_objects/object_ref.hpp"
+#include "scene_objects/quantized_bvh.hpp"
+#include "scene_objects/ray_queue_bvh.hpp"
 #include "scene_objects/rotate_object.hpp"
 #include "scene_objects/scene_object_range.hpp"
 #include "scene_objects/shapes/concepts.hpp"
 #include "scene_objects/shapes/quad.hpp"
+#include "scene_objects/shapes/shape_block.hpp"
 #include "scene_objects/shapes/shape_object.hpp"
+#include "scene_objects/shapes/shape_object_block.hpp"
 #include "scene_objects/shapes/sphere.hpp"
 #include "scene_objects/traits.hpp"
+#include "scene_objects/transform_object.hpp"
 #include "scene_objects/translate_object.hpp"
+#include "scene_objects/two_level_bvh.hpp"
+#include "scene_objects/variant_scene_object.hpp"
+#include "scene_objects/wide_bvh.hpp"
 #include "schedulers/concepts.hpp"
 #include "schedulers/inline_scheduler.hpp"
 #include "schedulers/libdispatch_queue.hpp"
@@ -69,5 +99,6 @@
 #include "textures/image_texture.hpp"
 #include "textures/perlin_texture.hpp"
 #include "textures/solid_color.hpp"
+#include "transform.hpp"
 #include "utils/double_utils.hpp"
 #include "vector.hpp"
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "point.hpp"
+#include "ray.hpp"
+#include "vector.hpp"
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace mrl {
+// ray_t with reciprocal of its direction and signs of its direction
+// components computed once, to be tested against many bounds.
+//
+// Class Invariant:
+//   - sign[i] is 1 if i'th component of direction is negative (including -0)
+//     and 0 otherwise
+//   - components of inv_direction are +-infinity for zero components of
+//     direction
+struct prepared_ray_t {
+  point3 origin;
+  vec3 inv_direction;
+  std::array<std::size_t, 3> sign;
+};
+
+constexpr prepared_ray_t prepare(ray_t const &r) {
+  auto const dir = r.direction.val();
+  return {
+      .origin = r.origin,
+      .inv_direction = vec3{1 / dir.x, 1 / dir.y, 1 / dir.z},
+      .sign =
+          {
+              static_cast<std::size_t>(std::signbit(dir.x)),
+              static_cast<std::size_t>(std::signbit(dir.y)),
+              static_cast<std::size_t>(std::signbit(dir.z)),
+          },
+  };
+}
+} // namespace mrl
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "bound.hpp"
+#include "direction.hpp"
+#include "hit_info.hpp"
+#include "point.hpp"
+#include "ray.hpp"
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace mrl {
+// Lanes of a packet, lane i is bit i.
+using packet_mask_t = std::uint32_t;
+
+// Coherent rays (like primary rays of neighbouring pixels) are traced in
+// packets of 4, 8 or 16.
+template <std::size_t N>
+concept PacketWidth = N == 4 || N == 8 || N == 16;
+
+template <std::size_t N>
+constexpr packet_mask_t all_lanes = (packet_mask_t{1} << N) - 1;
+
+// N rays in structure of arrays layout, so that a loop over lanes doing the
+// same arithmetic for every lane compiles to SIMD instructions.
+//
+// Class Invariant:
+//   - direction of every lane is a unit vector
+//   - inv_direction of every lane is reciprocal of its direction
+template <std::size_t N> struct ray_packet_t {
+  static_assert(N >= 1 && N <= 32);
+  std::array<std::array<double, N>, 3> origin;
+  std::array<std::array<double, N>, 3> direction;
+  std::array<std::array<double, N>, 3> inv_direction;
+};
+
+template <std::size_t N>
+constexpr void set_lane(ray_packet_t<N> &packet, std::size_t lane,
+                        ray_t const &r) {
+  auto const &o = r.origin;
+  auto const d = r.direction.val();
+  packet.origin[0][lane] = o.x;
+  packet.origin[1][lane] = o.y;
+  packet.origin[2][lane] = o.z;
+  packet.direction[0][lane] = d.x;
+  packet.direction[1][lane] = d.y;
+  packet.direction[2][lane] = d.z;
+  packet.inv_direction[0][lane] = 1 / d.x;
+  packet.inv_direction[1][lane] = 1 / d.y;
+  packet.inv_direction[2][lane] = 1 / d.z;
+}
+
+template <std::size_t N>
+constexpr ray_packet_t<N> make_ray_packet(std::array<ray_t, N> const &rays) {
+  ray_packet_t<N> packet;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    set_lane(packet, lane, rays[lane]);
+  }
+  return packet;
+}
+
+template <std::size_t N>
+constexpr ray_t lane_ray(ray_packet_t<N> const &packet, std::size_t lane) {
+  return {
+      .origin = point3{packet.origin[0][lane], packet.origin[1][lane],
+                       packet.origin[2][lane]},
+      .direction =
+          dir_from_unit(vec3{packet.direction[0][lane],
+                             packet.direction[1][lane],
+                             packet.direction[2][lane]}),
+  };
+}
+
+// Calls fn(lane) for every lane in mask in increasing order.
+template <typename Fn>
+constexpr void for_each_lane(packet_mask_t mask, Fn &&fn) {
+  for (; mask != 0; mask &= mask - 1) {
+    fn(static_cast<std::size_t>(std::countr_zero(mask)));
+  }
+}
+
+// Closest hits found so far for lanes of a packet.
+//
+// Class Invariant:
+//   - closest[i] is upper end of interval lane i still looks for hits in, it
+//     is hit distance of hits[i] if that has a value
+template <typename HitObject, std::size_t N> struct packet_hits_t {
+  std::array<double, N> closest;
+  std::array<std::optional<hit_info_t<HitObject>>, N> hits;
+};
+
+// Postcondition:
+//   - returns clip_interval of ray of lane with interval
+template <std::size_t N>
+constexpr interval_t clip_lane(ray_packet_t<N> const &packet, std::size_t lane,
+                               minmax_bound_t const &bounds,
+                               interval_t const &interval) {
+  auto const &inv = packet.inv_direction;
+  return clip_interval(
+      prepared_ray_t{
+          .origin = point3{packet.origin[0][lane], packet.origin[1][lane],
+                           packet.origin[2][lane]},
+          .inv_direction = vec3{inv[0][lane], inv[1][lane], inv[2][lane]},
+          .sign =
+              {
+                  static_cast<std::size_t>(std::signbit(inv[0][lane])),
+                  static_cast<std::size_t>(std::signbit(inv[1][lane])),
+                  static_cast<std::size_t>(std::signbit(inv[2][lane])),
+              },
+      },
+      bounds, interval);
+}
+
+// Slab test of clip_interval for every lane in active, with interval
+// [t_min, closest[i]] for lane i.
+//
+// Postcondition:
+//   - returns lanes in active whose rays hit bounds
+//   - entry[i] is distance where ray of lane i enters bounds, for returned
+//     lanes
+template <std::size_t N>
+constexpr packet_mask_t
+hit_bounds_lanes(ray_packet_t<N> const &packet, minmax_bound_t const &bounds,
+                 double t_min, std::array<double, N> const &closest,
+                 packet_mask_t active, std::array<double, N> &entry) {
+  using namespace __details;
+  constexpr double far_scale = 1 + 2 * gamma_3;
+  auto const &[min, max] = bounds.corners;
+  std::array<double, N> exit;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    entry[lane] = t_min;
+    exit[lane] = closest[lane];
+  }
+  for (int axis = 0; axis < 3; ++axis) {
+    auto const lo = component(min, axis);
+    auto const hi = component(max, axis);
+    auto const &o = packet.origin[static_cast<std::size_t>(axis)];
+    auto const &inv = packet.inv_direction[static_cast<std::size_t>(axis)];
+    for (std::size_t lane = 0; lane < N; ++lane) {
+      auto const t_lo = (lo - o[lane]) * inv[lane];
+      auto const t_hi = (hi - o[lane]) * inv[lane];
+      auto const negative = inv[lane] < 0;
+      auto const near = negative ? t_hi : t_lo;
+      auto const far = (negative ? t_lo : t_hi) * far_scale;
+      entry[lane] = max_ignore_nan(near, entry[lane]);
+      exit[lane] = min_ignore_nan(far, exit[lane]);
+    }
+  }
+  packet_mask_t res = 0;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    res |= packet_mask_t{entry[lane] <= exit[lane]} << lane;
+  }
+  return res & active;
+}
+} // namespace mrl
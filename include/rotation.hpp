@@ -8,6 +8,8 @@
 #include <functional>
 
 namespace mrl {
+// Rotates vector r around direction of axis, ignoring axis.origin, so it
+// suits directions. Points are rotated by rotate_point.
 constexpr vec3 rotate(vec3 const &r, ray_t const &axis, angle_t const &angle) {
   auto const adir = axis.direction.val();
 
@@ -19,6 +21,14 @@ constexpr vec3 rotate(vec3 const &r, ray_t const &axis, angle_t const &angle) {
          adir * dot(adir, r) * (1 - cos_theta);
 }
 
+// Postcondition:
+//   - returns p rotated around axis through axis.origin, as rotate of a ray
+//     rotates its origin
+constexpr point3 rotate_point(point3 const &p, ray_t const &axis,
+                              angle_t const &angle) {
+  return axis.origin + rotate(p - axis.origin, axis, angle);
+}
+
 constexpr ray_t rotate(ray_t const &r, ray_t const &axis,
                        angle_t const &angle) {
   vec3 translated_origin = r.origin - axis.origin;
@@ -58,11 +68,11 @@ constexpr bound_t rotate(bound_t const &bound, ray_t const &axis,
       {x_range.max, y_range.max, z_range.max},
   };
 
-  auto rotate_point = [&axis, &angle](point3 const &p) {
-    return rotate(p, axis, angle);
+  auto rotate_corner = [&axis, &angle](point3 const &p) {
+    return rotate_point(p, axis, angle);
   };
 
-  rng::transform(corners, std::begin(corners), rotate_point);
+  rng::transform(corners, std::begin(corners), rotate_corner);
 
   auto [min_x, max_x] =
       rng::minmax_element(corners, std::less<>{}, std::mem_fn(&vec3::x));
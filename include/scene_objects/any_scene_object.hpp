@@ -9,90 +9,248 @@
 #include "materials/scatter_info.hpp"
 #include "point.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
 #include "scale_2d.hpp"
 #include "scene_objects/concepts.hpp"
+#include <array>
+#include <concepts>
+#include <cstddef>
 #include <memory>
+#include <new>
 #include <optional>
+#include <type_traits>
+#include <utility>
 
 namespace mrl {
-template <DoubleGenerator Generator> struct any_hit_object {
-  template <typename Object>
-  any_hit_object(Object o)
-      : self_(std::make_shared<model_t<Object>>(std::move(o))) {}
+// 96 bytes hold hit objects of shapes and of a translate_object wrapped in a
+// rotate_object around them, but not of an any_scene_object wrapped in
+// anything (its own hit object takes 112 bytes).
+constexpr static std::size_t any_hit_object_default_size = 96;
 
-  struct concept_t {
-    virtual ~concept_t() = default;
-    virtual direction_t normal_at_mem(point3 const &) const = 0;
-    virtual scale_2d_t scaling_2d_at_mem(point3 const &) const = 0;
-    virtual std::optional<scatter_info_t>
-    scattering_for_mem(ray_t const &, double,
-                       generator_view<Generator>) const = 0;
-    virtual std::optional<emit_info_t>
-    emission_at_mem(point3 const &, generator_view<Generator>) const = 0;
+// Type erased HitObject. A hit object is made for every hit found while
+// traversing an acceleration structure, so unlike any_scene_object it
+// stores its object inline in InlineSize bytes without allocating and
+// dispatches through a vtable of plain function pointers without reference
+// counting. Hit objects not fitting in InlineSize bytes are rejected at
+// compile time, so any_scene_object wrapping them needs a larger InlineSize,
+// or has to be asked to store them out of line (see
+// out_of_line_hit_objects).
+//
+// Class Invariant:
+//   - storage_ holds object of type vtable_ was made for
+template <DoubleGenerator Generator,
+          std::size_t InlineSize = any_hit_object_default_size>
+struct any_hit_object {
+  struct vtable_t {
+    direction_t (*normal_at)(void const *, point3 const &);
+    scale_2d_t (*scaling_2d_at)(void const *, point3 const &);
+    std::optional<scatter_info_t> (*scattering_for)(void const *,
+                                                    ray_t const &, double,
+                                                    generator_view<Generator>);
+    std::optional<emit_info_t> (*emission_at)(void const *, point3 const &,
+                                              generator_view<Generator>);
+    // Constructs a copy of object at from in storage to.
+    void (*copy)(void const *from, void *to);
+    // Constructs object at from in storage to, leaving from destructible.
+    void (*move)(void *from, void *to) noexcept;
+    void (*destroy)(void *) noexcept;
   };
 
-  template <HitObject<Generator> T> struct model_t final : concept_t {
-    model_t(T h_arg) : obj(std::move(h_arg)){};
+  template <HitObject<Generator> T> struct model_t {
+    static_assert(sizeof(T) <= InlineSize,
+                  "hit object does not fit in any_hit_object, use larger "
+                  "InlineSize or out_of_line_hit_objects");
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "over-aligned hit object can not be stored in "
+                  "any_hit_object");
+    static_assert(std::is_nothrow_move_constructible_v<T>,
+                  "hit object stored in any_hit_object must be nothrow "
+                  "movable");
 
-    direction_t normal_at_mem(point3 const &p) const override {
-      return normal_at(obj, p);
-    };
-    scale_2d_t scaling_2d_at_mem(point3 const &p) const override {
-      return scaling_2d_at(obj, p);
-    };
-    std::optional<scatter_info_t>
-    scattering_for_mem(ray_t const &r, double hit_distance,
-                       generator_view<Generator> rand) const override {
-      return scattering_for(obj, r, hit_distance, rand);
-    };
-    std::optional<emit_info_t>
-    emission_at_mem(point3 const &p,
-                    generator_view<Generator> rand) const override {
-      return emission_at(obj, p, rand);
-    };
+    static T const &get(void const *storage) {
+      return *std::launder(static_cast<T const *>(storage));
+    }
 
-    T obj;
+    static void construct(void *storage, T obj) {
+      ::new (storage) T(std::move(obj));
+    }
+
+    constexpr static vtable_t vtable{
+        .normal_at = [](void const *self, point3 const &p) {
+          return normal_at(get(self), p);
+        },
+        .scaling_2d_at = [](void const *self, point3 const &p) {
+          return scaling_2d_at(get(self), p);
+        },
+        .scattering_for =
+            [](void const *self, ray_t const &r, double hit_distance,
+               generator_view<Generator> rand) {
+              return scattering_for(get(self), r, hit_distance, rand);
+            },
+        .emission_at =
+            [](void const *self, point3 const &p,
+               generator_view<Generator> rand) {
+              return emission_at(get(self), p, rand);
+            },
+        .copy = [](void const *from, void *to) { construct(to, get(from)); },
+        .move =
+            [](void *from, void *to) noexcept {
+              ::new (to) T(std::move(*std::launder(static_cast<T *>(from))));
+            },
+        .destroy =
+            [](void *self) noexcept {
+              std::destroy_at(std::launder(static_cast<T *>(self)));
+            },
+    };
   };
 
-  std::shared_ptr<concept_t const> self_;
+  template <typename Object>
+    requires(!std::same_as<Object, any_hit_object> &&
+             HitObject<Object, Generator>)
+  any_hit_object(Object o) : vtable_(&model_t<Object>::vtable) {
+    model_t<Object>::construct(storage_.data(), std::move(o));
+  }
+
+  any_hit_object(any_hit_object const &other) : vtable_(other.vtable_) {
+    vtable_->copy(other.storage_.data(), storage_.data());
+  }
+
+  any_hit_object(any_hit_object &&other) noexcept : vtable_(other.vtable_) {
+    vtable_->move(other.storage_.data(), storage_.data());
+  }
+
+  any_hit_object &operator=(any_hit_object const &other) {
+    if (this != &other) {
+      auto copy = other;
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+
+  any_hit_object &operator=(any_hit_object &&other) noexcept {
+    if (this != &other) {
+      vtable_->destroy(storage_.data());
+      vtable_ = other.vtable_;
+      vtable_->move(other.storage_.data(), storage_.data());
+    }
+    return *this;
+  }
+
+  ~any_hit_object() { vtable_->destroy(storage_.data()); }
+
+  alignas(std::max_align_t) std::array<std::byte, InlineSize> storage_;
+  vtable_t const *vtable_;
 };
 
-template <typename Object>
-auto normal_at(any_hit_object<Object> const &o, point3 const &p) {
-  return o.self_->normal_at_mem(p);
+template <typename Object, std::size_t InlineSize>
+auto normal_at(any_hit_object<Object, InlineSize> const &o, point3 const &p) {
+  return o.vtable_->normal_at(o.storage_.data(), p);
+}
+template <typename Object, std::size_t InlineSize>
+auto scaling_2d_at(any_hit_object<Object, InlineSize> const &o,
+                   point3 const &p) {
+  return o.vtable_->scaling_2d_at(o.storage_.data(), p);
 }
-template <typename Object>
-auto scaling_2d_at(any_hit_object<Object> const &o, point3 const &p) {
-  return o.self_->scaling_2d_at_mem(p);
+template <DoubleGenerator Generator, std::size_t InlineSize>
+auto scattering_for(any_hit_object<Generator, InlineSize> const &o,
+                    ray_t const &r, double hit_distance,
+                    generator_view<Generator> rand) {
+  return o.vtable_->scattering_for(o.storage_.data(), r, hit_distance, rand);
 }
-template <DoubleGenerator Generator>
-auto scattering_for(any_hit_object<Generator> const &o, ray_t const &r,
+template <DoubleGenerator Generator, std::size_t InlineSize>
+auto emission_at(any_hit_object<Generator, InlineSize> const &o,
+                 point3 const &p, generator_view<Generator> rand) {
+  return o.vtable_->emission_at(o.storage_.data(), p, rand);
+}
+
+// HitObject keeping hit object of type T on heap, so that any_hit_object
+// only stores a pointer to it.
+template <typename T> struct out_of_line_hit_object {
+  std::shared_ptr<T const> obj;
+};
+
+template <typename T>
+auto normal_at(out_of_line_hit_object<T> const &o, point3 const &p) {
+  return normal_at(*o.obj, p);
+}
+template <typename T>
+auto scaling_2d_at(out_of_line_hit_object<T> const &o, point3 const &p) {
+  return scaling_2d_at(*o.obj, p);
+}
+template <typename T, DoubleGenerator Generator>
+auto scattering_for(out_of_line_hit_object<T> const &o, ray_t const &r,
                     double hit_distance, generator_view<Generator> rand) {
-  return o.self_->scattering_for_mem(r, hit_distance, rand);
+  return scattering_for(*o.obj, r, hit_distance, rand);
 }
-template <DoubleGenerator Generator>
-auto emission_at(any_hit_object<Generator> const &o, point3 const &p,
+template <typename T, DoubleGenerator Generator>
+auto emission_at(out_of_line_hit_object<T> const &o, point3 const &p,
                  generator_view<Generator> rand) {
-  return o.self_->emission_at_mem(p, rand);
+  return emission_at(*o.obj, p, rand);
 }
 
-template <DoubleGenerator Generator> struct any_scene_object {
-  using hit_object_type = any_hit_object<Generator>;
+// Tag asking any_scene_object to store hit objects of an object out of line.
+struct out_of_line_hit_objects_t {};
+constexpr static out_of_line_hit_objects_t out_of_line_hit_objects{};
+
+// InlineSize is size of buffer of its hit objects, see any_hit_object.
+template <DoubleGenerator Generator,
+          std::size_t InlineSize = any_hit_object_default_size>
+struct any_scene_object {
+  using hit_object_type = any_hit_object<Generator, InlineSize>;
+
+  template <typename T>
+  any_scene_object(T x)
+      : self_(std::make_shared<model_t<T, false>>(std::move(x))) {}
 
+  // For objects whose hit objects do not fit in InlineSize bytes. Every hit
+  // object made for x is allocated on heap and any_hit_object holds a pointer
+  // to it.
   template <typename T>
-  any_scene_object(T x) : self_(std::make_shared<model_t<T>>(std::move(x))) {}
+  any_scene_object(out_of_line_hit_objects_t, T x)
+      : self_(std::make_shared<model_t<T, true>>(std::move(x))) {}
 
+  template <std::size_t N>
+  using packet_hits_type = packet_hits_t<hit_object_type, N>;
+
+  // Virtual functions can not be templates, so every packet width has its
+  // own.
   struct concept_t {
     virtual ~concept_t() = default;
     virtual std::optional<hit_info_t<hit_object_type>>
     hit_mem(ray_t const &, interval_t const &) const = 0;
+    virtual packet_mask_t hit_packet_mem(ray_packet_t<4> const &, double,
+                                         packet_hits_type<4> &,
+                                         packet_mask_t) const = 0;
+    virtual packet_mask_t hit_packet_mem(ray_packet_t<8> const &, double,
+                                         packet_hits_type<8> &,
+                                         packet_mask_t) const = 0;
+    virtual packet_mask_t hit_packet_mem(ray_packet_t<16> const &, double,
+                                         packet_hits_type<16> &,
+                                         packet_mask_t) const = 0;
+    virtual bool occluded_mem(ray_t const &, interval_t const &) const = 0;
+    virtual bool is_deferred_mem() const = 0;
+    virtual std::optional<double> intersect_mem(ray_t const &,
+                                                interval_t const &) const = 0;
+    virtual hit_object_type hit_object_at_mem(ray_t const &, interval_t const &,
+                                              double) const = 0;
     virtual bound_t get_bounds_mem() const = 0;
+    virtual std::array<bound_t, 2> split_bounds_mem(bound_t const &, int,
+                                                    double) const = 0;
   };
 
-  template <SceneObject T> struct model_t final : concept_t {
+  template <SceneObject T, bool OutOfLine> struct model_t final : concept_t {
     T hittable;
     model_t(T h_arg) : hittable(std::move(h_arg)){};
 
+    static hit_object_type erase(hit_object_t<T> obj) {
+      if constexpr (OutOfLine) {
+        return hit_object_type{out_of_line_hit_object<hit_object_t<T>>{
+            std::make_shared<hit_object_t<T> const>(std::move(obj))}};
+      } else {
+        return hit_object_type{std::move(obj)};
+      }
+    }
+
     std::optional<hit_info_t<hit_object_type>>
     hit_mem(ray_t const &ray, interval_t const &t_rng) const override {
       auto res = hit(hittable, ray, t_rng);
@@ -100,25 +258,124 @@ template <DoubleGenerator Generator> struct any_scene_object {
         return std::nullopt;
       return hit_info_t<hit_object_type>{
           .hit_distance = res->hit_distance,
-          .hit_object = hit_object_type{std::move(res->hit_object)},
+          .hit_object = erase(std::move(res->hit_object)),
       };
     }
 
+    template <std::size_t N>
+    packet_mask_t hit_lanes_of(ray_packet_t<N> const &packet, double t_min,
+                               packet_hits_type<N> &hits,
+                               packet_mask_t active) const {
+      packet_hits_t<hit_object_t<T>, N> own;
+      own.closest = hits.closest;
+      auto const res = hit_lanes(hittable, packet, t_min, own, active);
+      for_each_lane(res, [&](std::size_t lane) {
+        hits.closest[lane] = own.closest[lane];
+        hits.hits[lane] = hit_info_t<hit_object_type>{
+            .hit_distance = own.hits[lane]->hit_distance,
+            .hit_object = erase(std::move(own.hits[lane]->hit_object)),
+        };
+      });
+      return res;
+    }
+
+    packet_mask_t hit_packet_mem(ray_packet_t<4> const &packet, double t_min,
+                                 packet_hits_type<4> &hits,
+                                 packet_mask_t active) const override {
+      return hit_lanes_of(packet, t_min, hits, active);
+    }
+    packet_mask_t hit_packet_mem(ray_packet_t<8> const &packet, double t_min,
+                                 packet_hits_type<8> &hits,
+                                 packet_mask_t active) const override {
+      return hit_lanes_of(packet, t_min, hits, active);
+    }
+    packet_mask_t hit_packet_mem(ray_packet_t<16> const &packet, double t_min,
+                                 packet_hits_type<16> &hits,
+                                 packet_mask_t active) const override {
+      return hit_lanes_of(packet, t_min, hits, active);
+    }
+
+    bool occluded_mem(ray_t const &ray,
+                      interval_t const &t_rng) const override {
+      return is_occluded(hittable, ray, t_rng);
+    }
+
+    bool is_deferred_mem() const override { return DeferredHittable<T>; }
+
+    std::optional<double>
+    intersect_mem(ray_t const &ray, interval_t const &t_rng) const override {
+      return intersection_distance(hittable, ray, t_rng);
+    }
+
+    hit_object_type hit_object_at_mem(ray_t const &ray, interval_t const &t_rng,
+                                      double t) const override {
+      return erase(hit_object_of(hittable, ray, t_rng, t));
+    }
+
     bound_t get_bounds_mem() const override { return get_bounds(hittable); }
+
+    std::array<bound_t, 2> split_bounds_mem(bound_t const &bounds, int axis,
+                                            double position) const override {
+      return split_object_bounds(hittable, bounds, axis, position);
+    }
   };
 
 public:
   std::shared_ptr<concept_t const> self_;
 };
 
-template <DoubleGenerator Generator>
-auto hit(any_scene_object<Generator> const &o, ray_t const &r,
+template <DoubleGenerator Generator, std::size_t InlineSize>
+auto hit(any_scene_object<Generator, InlineSize> const &o, ray_t const &r,
          interval_t const &i) {
   return o.self_->hit_mem(r, i);
 }
 
-template <DoubleGenerator Generator>
-bound_t get_bounds(any_scene_object<Generator> const &obj) {
+template <DoubleGenerator Generator, std::size_t InlineSize, std::size_t N>
+  requires PacketWidth<N>
+packet_mask_t
+hit_packet(any_scene_object<Generator, InlineSize> const &o,
+           ray_packet_t<N> const &packet, double t_min,
+           packet_hits_t<any_hit_object<Generator, InlineSize>, N> &hits,
+           packet_mask_t active) {
+  return o.self_->hit_packet_mem(packet, t_min, hits, active);
+}
+
+template <DoubleGenerator Generator, std::size_t InlineSize>
+bool occluded(any_scene_object<Generator, InlineSize> const &o, ray_t const &r,
+              interval_t const &i) {
+  return o.self_->occluded_mem(r, i);
+}
+
+// False for objects that are not DeferredHittable themselves, e.g. bvhs, as
+// hit_object_at would hit them again. bvh_t hits those by hit alone.
+template <DoubleGenerator Generator, std::size_t InlineSize>
+bool is_deferred(any_scene_object<Generator, InlineSize> const &o) {
+  return o.self_->is_deferred_mem();
+}
+
+template <DoubleGenerator Generator, std::size_t InlineSize>
+std::optional<double>
+intersect(any_scene_object<Generator, InlineSize> const &o, ray_t const &r,
+          interval_t const &i) {
+  return o.self_->intersect_mem(r, i);
+}
+
+template <DoubleGenerator Generator, std::size_t InlineSize>
+any_hit_object<Generator, InlineSize>
+hit_object_at(any_scene_object<Generator, InlineSize> const &o, ray_t const &r,
+              interval_t const &i, double t) {
+  return o.self_->hit_object_at_mem(r, i, t);
+}
+
+template <DoubleGenerator Generator, std::size_t InlineSize>
+bound_t get_bounds(any_scene_object<Generator, InlineSize> const &obj) {
   return obj.self_->get_bounds_mem();
 }
+
+template <DoubleGenerator Generator, std::size_t InlineSize>
+std::array<bound_t, 2>
+split_bounds(any_scene_object<Generator, InlineSize> const &obj,
+             bound_t const &bounds, int axis, double position) {
+  return obj.self_->split_bounds_mem(bounds, axis, position);
+}
 } // namespace mrl
@@ -2,69 +2,382 @@
 
 #include "bound.hpp"
 #include "interval.hpp"
+#include "prepared_ray.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/bvh/cost.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/refit.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/bvh/treelet.hpp"
 #include "scene_objects/concepts.hpp"
 #include "scene_objects/scene_object_range.hpp"
-#include "std/hierarchy_tree.hpp"
+#include "schedulers/concepts.hpp"
+#include "stdexec/execution.hpp"
 #include "traits.hpp"
-#include <functional>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 #include <ranges>
+#include <span>
+#include <vector>
 
 namespace mrl {
 namespace __bvh_details {
-constexpr auto get_bounds_obj = lift(get_bounds);
-constexpr auto union_bounds_obj = lift(union_bounds);
+struct ignore_visit {
+  constexpr void operator()(std::uint32_t) const {}
+};
 } // namespace __bvh_details
+
+// bvh_t stores its nodes in a flat array in depth first order and its objects
+// in a separate contiguous array ordered such that every leaf refers to a
+// contiguous range of objects.
 template <typename Object> class bvh_t {
 public:
   using object_type = Object;
   using hit_object_type = hit_object_t<Object>;
 
 private:
-  using tree_type = hierarchy_tree<object_type, bound_t,
-                                   decltype(__bvh_details::get_bounds_obj),
-                                   decltype(__bvh_details::union_bounds_obj)>;
-
-  tree_type tree;
+  std::vector<object_type> objects_;
+  std::vector<bvh_node_t> nodes_;
+  double built_cost_;
 
 public:
-  template <std::ranges::random_access_range Range>
-  bvh_t(Range &&rng)
-      : tree([&rng] {
-          auto bound_x_min = [](auto const &obj) {
-            return get_bounds(obj).x_range.min;
-          };
-          std::ranges::sort(rng, std::less<>{}, bound_x_min);
-          return tree_type(std::forward<Range>(rng),
-                           __bvh_details::get_bounds_obj,
-                           __bvh_details::union_bounds_obj);
-        }()) {}
-
-  bound_t bounds() const { return tree.bounds(); }
-
-  auto hit_ray(ray_t const &r, interval_t const &interval) const {
+  // Split decides how objects are divided between children of every node.
+  // median_split is used by default, sah_split gives better trees for
+  // unevenly distributed objects at the cost of slower construction.
+  template <std::ranges::random_access_range Range,
+            typename Split = median_split>
+    requires BvhSplitStrategy<Split, bvh_primitive_iterator>
+  bvh_t(Range &&rng, Split split = {})
+      : objects_(to_object_vector<object_type>(std::forward<Range>(rng))),
+        nodes_(build_bvh_nodes(objects_, split)), built_cost_(sah_cost()) {}
+
+  // Precondition:
+  //   - nodes form a bvh over objects as described by bvh_node_t
+  bvh_t(std::vector<object_type> objects, std::vector<bvh_node_t> nodes)
+      : objects_(std::move(objects)), nodes_(std::move(nodes)),
+        built_cost_(sah_cost()) {}
+
+  // Postcondition:
+  //   - returns empty bound for bvh with no objects
+  bound_t bounds() const {
+    if (nodes_.empty())
+      return bound_t{};
+    return to_bound(nodes_.front().bounds);
+  }
+
+  std::vector<bvh_node_t> const &nodes() const { return nodes_; }
+
+  std::vector<object_type> const &objects() const { return objects_; }
+
+  // Objects may be modified through it, e.g. to move them between frames.
+  // Hits do not reflect modified bounds until refit or rebuild is called.
+  std::span<object_type> objects() { return objects_; }
+
+  // Recomputes bounds of all nodes from current bounds of objects keeping
+  // the topology. It takes O(n) time and does no allocation.
+  void refit() {
+    refit_nodes(nodes_, objects_, 0,
+                static_cast<std::uint32_t>(nodes_.size()));
+  }
+
+  // Same as refit(), but independent subtrees are refitted in parallel on
+  // scheduler.
+  //
+  // Postcondition:
+  //   - returns a sender that completes after refitting
+  template <Scheduler scheduler_t> auto refit(scheduler_t scheduler) {
+    auto refit_subtree = [this](std::size_t i, bvh_refit_plan_t const &plan) {
+      if (i >= plan.num_subtrees)
+        return;
+      auto const root = plan.subtrees[i];
+      refit_nodes(nodes_, objects_, root, subtree_end(nodes_, root));
+    };
+    auto refit_top = [this](bvh_refit_plan_t const &plan) {
+      for (auto i = plan.num_top_nodes; i > 0; --i) {
+        refit_node(nodes_, objects_, plan.top_nodes[i - 1]);
+      }
+    };
+    return stdexec::schedule(scheduler) |
+           stdexec::then([this] { return make_refit_plan(nodes_); }) |
+           stdexec::bulk(bvh_refit_plan_t::max_subtrees, refit_subtree) |
+           stdexec::then(refit_top);
+  }
+
+  // Postcondition:
+  //   - returns SAH cost of bvh with its current bounds, see mrl::sah_cost
+  double sah_cost() const { return mrl::sah_cost(nodes_); }
+
+  // Refitting keeps topology, so as objects move the tree degrades.
+  //
+  // Postcondition:
+  //   - returns true if SAH cost grew more than max_cost_ratio times since
+  //     bvh was last built
+  bool needs_rebuild(double max_cost_ratio = 1.5) const {
+    return sah_cost() > built_cost_ * max_cost_ratio;
+  }
+
+  // Builds bvh again over its objects, which may reorder them.
+  template <typename Split = median_split>
+    requires BvhSplitStrategy<Split, bvh_primitive_iterator>
+  void rebuild(Split split = {}) {
+    nodes_ = build_bvh_nodes(objects_, split);
+    built_cost_ = sah_cost();
+  }
+
+  // Improves topology of bvh, whichever builder made it, by restructuring
+  // its treelets of about 7 leaves to least SAH cost. Leaves and objects are
+  // kept as they are. Restructured bvh becomes the baseline of
+  // needs_rebuild.
+  treelet_report_t restructure_treelets() {
+    auto const before = sah_cost();
+    mrl::restructure_treelets(nodes_);
+    built_cost_ = sah_cost();
+    return {before, built_cost_};
+  }
+
+  // Same as restructure_treelets(), but treelets not sharing nodes are
+  // restructured in parallel on scheduler.
+  //
+  // Postcondition:
+  //   - returns a sender that completes with treelet_report_t after
+  //     restructuring
+  template <Scheduler scheduler_t>
+  auto restructure_treelets(scheduler_t scheduler) {
+    using __treelet_details::state_t;
+    auto finish = [this](state_t const &state) -> treelet_report_t {
+      auto const before = sah_cost();
+      nodes_ = state.flatten();
+      built_cost_ = sah_cost();
+      return {before, built_cost_};
+    };
+    return __treelet_details::restructure_batches<0>(
+               stdexec::schedule(scheduler) |
+               stdexec::then([this] { return state_t(nodes_); })) |
+           stdexec::then(finish);
+  }
+
+  // Children are visited front to back by their entry distance and interval
+  // is narrowed to the closest hit found so far, so nodes entirely behind it
+  // are never descended. on_visit(index) is called for every node visited,
+  // see bvh_profiler_t.
+  //
+  // DeferredHittable objects are intersected by distance alone, only the
+  // closest hit distance and index of its object being kept, and hit object
+  // is built once for the closest hit after traversal. Those that do not
+  // defer their hit objects (see defers_hit_object) are hit as other objects
+  // are, keeping their whole hit.
+  template <typename OnVisit = __bvh_details::ignore_visit>
+  auto hit_ray(ray_t const &r, interval_t interval,
+               OnVisit on_visit = {}) const {
+    struct pending_node {
+      std::uint32_t index;
+      double entry_distance;
+    };
+    // interval_max is max of interval object was intersected with.
+    struct closest_hit {
+      double hit_distance;
+      double interval_max;
+      std::uint32_t index;
+    };
+
     std::optional<hit_info_t<hit_object_type>> res;
-    auto hit_obj = [&r, &interval, &res](object_type const &obj) {
-      auto hit_rec = hit(obj, r, interval);
-      if (hit_rec) {
-        if (res) {
-          *res = std::min(*res, *hit_rec, [](auto const &a, auto const &b) {
-            return a.hit_distance < b.hit_distance;
-          });
-        } else {
-          res = hit_rec;
+    std::optional<closest_hit> closest;
+    auto const ray = prepare(r);
+    if (nodes_.empty() || !hit_bounds(ray, nodes_.front().bounds, interval))
+      return res;
+    auto const is_closer = [&](double t) {
+      return closest ? t < closest->hit_distance
+                     : !res || t < res->hit_distance;
+    };
+    std::array<pending_node, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    std::uint32_t cur = 0;
+    while (true) {
+      on_visit(cur);
+      auto const &node = nodes_[cur];
+      if (is_leaf(node)) {
+        for (auto i = node.offset; i < node.offset + node.count; ++i) {
+          if constexpr (DeferredHittable<object_type>) {
+            if (defers_hit_object(objects_[i])) {
+              auto const t = intersect(objects_[i], r, interval);
+              if (t && is_closer(*t)) {
+                closest = closest_hit{*t, interval.max, i};
+                res.reset();
+                interval.max = *t;
+              }
+              continue;
+            }
+          }
+          auto hit_rec = hit(objects_[i], r, interval);
+          if (hit_rec && is_closer(hit_rec->hit_distance)) {
+            interval.max = hit_rec->hit_distance;
+            res = std::move(hit_rec);
+            closest.reset();
+          }
+        }
+      } else {
+        auto const left = cur + 1;
+        auto const right = node.offset;
+        auto const left_clip =
+            clip_interval(ray, nodes_[left].bounds, interval);
+        auto const right_clip =
+            clip_interval(ray, nodes_[right].bounds, interval);
+        auto const hit_left = left_clip.min <= left_clip.max;
+        auto const hit_right = right_clip.min <= right_clip.max;
+        if (hit_left && hit_right) {
+          auto const left_first = left_clip.min <= right_clip.min;
+          cur = left_first ? left : right;
+          to_visit[num_to_visit++] =
+              left_first ? pending_node{right, right_clip.min}
+                         : pending_node{left, left_clip.min};
+          continue;
         }
+        if (hit_left || hit_right) {
+          cur = hit_left ? left : right;
+          continue;
+        }
+      }
+      auto found = false;
+      while (num_to_visit > 0 && !found) {
+        auto const pending = to_visit[--num_to_visit];
+        found = pending.entry_distance <= interval.max;
+        cur = pending.index;
+      }
+      if (!found)
+        break;
+    }
+    if constexpr (DeferredHittable<object_type>) {
+      if (closest) {
+        res = hit_info_t<hit_object_type>{
+            closest->hit_distance,
+            hit_object_at(objects_[closest->index], r,
+                          interval_t{interval.min, closest->interval_max},
+                          closest->hit_distance),
+        };
       }
+    }
+    return res;
+  }
+
+  // Lanes of packet share one traversal stack, every pending node carrying
+  // lanes that may enter it. A node is visited once for all its lanes. For
+  // coherent lanes testing the first lane alone mostly suffices: if it enters
+  // a node, all lanes descend without being tested. Otherwise all lanes are
+  // tested and only those entering the node descend. Children are visited in
+  // order of entry distance of the lane found entering them.
+  template <std::size_t N>
+  packet_mask_t hit_ray_packet(ray_packet_t<N> const &packet, double t_min,
+                               packet_hits_t<hit_object_type, N> &hits,
+                               packet_mask_t active) const {
+    struct pending_node {
+      std::uint32_t index;
+      packet_mask_t active;
+    };
+    struct entered_node {
+      packet_mask_t active;
+      double entry_distance;
     };
-    tree.for_each_if(
-        hit_obj, [&r](bound_t const &bound) { return hit_bounds(r, bound); });
+
+    std::array<double, N> entry;
+    auto enter = [&](std::uint32_t index, packet_mask_t lanes) {
+      auto const &bounds = nodes_[index].bounds;
+      if (lanes == 0)
+        return entered_node{0, 0};
+      auto lane = static_cast<std::size_t>(std::countr_zero(lanes));
+      auto const clipped = clip_lane(packet, lane, bounds,
+                                     interval_t{t_min, hits.closest[lane]});
+      if (clipped.min <= clipped.max)
+        return entered_node{lanes, clipped.min};
+      lanes = hit_bounds_lanes(packet, bounds, t_min, hits.closest, lanes,
+                               entry);
+      if (lanes == 0)
+        return entered_node{0, 0};
+      lane = static_cast<std::size_t>(std::countr_zero(lanes));
+      return entered_node{lanes, entry[lane]};
+    };
+
+    packet_mask_t res = 0;
+    if (nodes_.empty())
+      return res;
+    active = enter(0, active).active;
+    std::array<pending_node, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    std::uint32_t cur = 0;
+    while (true) {
+      auto const &node = nodes_[cur];
+      if (active != 0 && is_leaf(node)) {
+        for (auto i = node.offset; i < node.offset + node.count; ++i) {
+          res |= hit_lanes(objects_[i], packet, t_min, hits, active);
+        }
+      } else if (active != 0) {
+        auto const left = cur + 1;
+        auto const right = node.offset;
+        auto const left_node = enter(left, active);
+        auto const right_node = enter(right, active);
+        if (left_node.active != 0 && right_node.active != 0) {
+          auto const left_first =
+              left_node.entry_distance <= right_node.entry_distance;
+          cur = left_first ? left : right;
+          active = left_first ? left_node.active : right_node.active;
+          to_visit[num_to_visit++] =
+              left_first ? pending_node{right, right_node.active}
+                         : pending_node{left, left_node.active};
+          continue;
+        }
+        if (left_node.active != 0 || right_node.active != 0) {
+          cur = left_node.active != 0 ? left : right;
+          active = left_node.active | right_node.active;
+          continue;
+        }
+      }
+      if (num_to_visit == 0)
+        break;
+      auto const pending = to_visit[--num_to_visit];
+      cur = pending.index;
+      active = enter(cur, pending.active).active;
+    }
     return res;
   }
+
+  // Order of visiting nodes does not matter as traversal stops at first
+  // object occluding the ray.
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    auto const ray = prepare(r);
+    if (nodes_.empty() || !hit_bounds(ray, nodes_.front().bounds, interval))
+      return false;
+    std::array<std::uint32_t, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    to_visit[num_to_visit++] = 0;
+    while (num_to_visit > 0) {
+      auto const cur = to_visit[--num_to_visit];
+      auto const &node = nodes_[cur];
+      if (is_leaf(node)) {
+        for (auto i = node.offset; i < node.offset + node.count; ++i) {
+          if (is_occluded(objects_[i], r, interval))
+            return true;
+        }
+        continue;
+      }
+      auto const left = cur + 1;
+      if (hit_bounds(ray, nodes_[node.offset].bounds, interval))
+        to_visit[num_to_visit++] = node.offset;
+      if (hit_bounds(ray, nodes_[left].bounds, interval))
+        to_visit[num_to_visit++] = left;
+    }
+    return false;
+  }
 };
 
 template <std::ranges::random_access_range Range>
 bvh_t(Range &&rng) -> bvh_t<std::ranges::range_value_t<Range>>;
 
+template <std::ranges::random_access_range Range, typename Split>
+bvh_t(Range &&rng, Split) -> bvh_t<std::ranges::range_value_t<Range>>;
+
 template <BoundedObject Object>
 inline bound_t get_bounds(bvh_t<Object> const &bvh) {
   return bvh.bounds();
@@ -75,4 +388,18 @@ inline auto hit(bvh_t<Object> const &bvh, ray_t const &r,
                 interval_t const &interval) {
   return bvh.hit_ray(r, interval);
 }
+
+template <SceneObject Object, std::size_t N>
+inline packet_mask_t hit_packet(bvh_t<Object> const &bvh,
+                                ray_packet_t<N> const &packet, double t_min,
+                                packet_hits_t<hit_object_t<Object>, N> &hits,
+                                packet_mask_t active) {
+  return bvh.hit_ray_packet(packet, t_min, hits, active);
+}
+
+template <SceneObject Object>
+inline bool occluded(bvh_t<Object> const &bvh, ray_t const &r,
+                     interval_t const &interval) {
+  return bvh.occluded_ray(r, interval);
+}
 } // namespace mrl
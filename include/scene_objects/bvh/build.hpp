@@ -0,0 +1,160 @@
+#pragma once
+
+#include "bound.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <type_traits>
+#include <vector>
+
+namespace mrl {
+// Stands for object at index of bvh's object array while building the bvh,
+// caching its bounds.
+struct bvh_primitive_ref_t {
+  bound_t bounds;
+  std::uint32_t index;
+};
+
+constexpr bound_t get_bounds(bvh_primitive_ref_t const &ref) {
+  return ref.bounds;
+}
+
+using bvh_primitive_iterator = std::vector<bvh_primitive_ref_t>::iterator;
+
+namespace __bvh_build_details {
+// Beyond this depth nodes are split at midpoint. This keeps depth of any bvh
+// with less than 2^32 objects below bvh_max_depth.
+constexpr static std::size_t max_split_depth = bvh_max_depth - 33;
+
+template <std::random_access_iterator Iter, typename Split> struct builder {
+  Iter first;
+  Split const &split;
+  std::vector<bvh_node_t> nodes;
+  // Ranges of at most this many objects become leaves.
+  std::size_t max_leaf_objects = 1;
+
+  // Postcondition:
+  //   - returns index of the root node of built subtree
+  std::uint32_t build(Iter begin, Iter end, std::size_t depth) {
+    auto const index = static_cast<std::uint32_t>(nodes.size());
+    nodes.push_back({});
+    auto const n = std::distance(begin, end);
+    if (static_cast<std::size_t>(n) <= max_leaf_objects) {
+      auto bounds = get_bounds(*begin);
+      for (auto it = std::next(begin); it != end; ++it) {
+        bounds = union_bounds(bounds, get_bounds(*it));
+      }
+      nodes[index] = bvh_node_t{
+          .bounds = to_minmax_bound(bounds),
+          .offset = static_cast<std::uint32_t>(std::distance(first, begin)),
+          .count = static_cast<std::uint32_t>(n),
+      };
+      return index;
+    }
+    auto const mid = depth < max_split_depth ? split(begin, end)
+                                             : std::next(begin, n / 2);
+    build(begin, mid, depth + 1);
+    auto const right = build(mid, end, depth + 1);
+    nodes[index] = bvh_node_t{
+        .bounds = union_bounds(nodes[index + 1].bounds, nodes[right].bounds),
+        .offset = right,
+        .count = 0,
+    };
+    return index;
+  }
+};
+} // namespace __bvh_build_details
+
+// Every leaf gets at most max_leaf_objects objects, e.g. to pack objects of
+// a leaf in a block tested at once.
+//
+// Precondition:
+//   - std::distance(begin, end) < 2^32
+//   - max_leaf_objects >= 1
+//
+// Postcondition:
+//   - [begin, end) is reordered such that every leaf refers to a contiguous
+//     range of it
+//   - returns nodes of bvh over [begin, end) in depth first order
+template <std::random_access_iterator Iter, BvhSplitStrategy<Iter> Split>
+std::vector<bvh_node_t> build_bvh_nodes(Iter begin, Iter end,
+                                        Split const &split,
+                                        std::size_t max_leaf_objects = 1) {
+  __bvh_build_details::builder<Iter, Split> builder{begin, split, {},
+                                                    max_leaf_objects};
+  if (begin == end)
+    return {};
+  builder.nodes.reserve(
+      2 * static_cast<std::size_t>(std::distance(begin, end)) - 1);
+  builder.build(begin, end, 0);
+  return std::move(builder.nodes);
+}
+
+// Postcondition:
+//   - returns vector of elements of rng, moved from rng if it is an rvalue
+template <typename Object, std::ranges::input_range Range>
+std::vector<Object> to_object_vector(Range &&rng) {
+  using object_type = Object;
+  if constexpr (std::is_rvalue_reference_v<Range &&>) {
+    return std::vector<object_type>(
+        std::make_move_iterator(std::ranges::begin(rng)),
+        std::make_move_iterator(std::ranges::end(rng)));
+  } else {
+    return std::vector<object_type>(std::ranges::begin(rng),
+                                    std::ranges::end(rng));
+  }
+}
+
+// Precondition:
+//   - objects.size() < 2^32
+//
+// Postcondition:
+//   - returns refs to objects in same order as objects
+template <BoundedObject Object>
+std::vector<bvh_primitive_ref_t>
+make_primitive_refs(std::vector<Object> const &objects) {
+  std::vector<bvh_primitive_ref_t> refs;
+  refs.reserve(objects.size());
+  for (std::size_t i = 0; i < objects.size(); ++i) {
+    refs.push_back({get_bounds(objects[i]), static_cast<std::uint32_t>(i)});
+  }
+  return refs;
+}
+
+// Precondition:
+//   - refs is a permutation of refs to objects
+//
+// Postcondition:
+//   - objects[i] is the object refs[i] referred to
+template <typename Object>
+void reorder_objects(std::vector<Object> &objects,
+                     std::vector<bvh_primitive_ref_t> const &refs) {
+  std::vector<Object> reordered;
+  reordered.reserve(objects.size());
+  for (auto const &ref : refs) {
+    reordered.push_back(std::move(objects[ref.index]));
+  }
+  objects = std::move(reordered);
+}
+
+// Precondition:
+//   - objects.size() < 2^32
+//
+// Postcondition:
+//   - objects are reordered such that every leaf refers to a contiguous range
+//     of it
+//   - returns nodes of bvh over objects in depth first order
+template <BoundedObject Object,
+          BvhSplitStrategy<bvh_primitive_iterator> Split>
+std::vector<bvh_node_t> build_bvh_nodes(std::vector<Object> &objects,
+                                        Split const &split) {
+  auto refs = make_primitive_refs(objects);
+  auto nodes = build_bvh_nodes(refs.begin(), refs.end(), split);
+  reorder_objects(objects, refs);
+  return nodes;
+}
+} // namespace mrl
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "bound.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include <vector>
+
+namespace mrl {
+// Surface Area Heuristic cost of a bvh, i.e. expected cost of hitting it with
+// a ray hitting its root, with same cost model as sah_split:
+//   sum over interior nodes N of traversal_cost * SA(N) / SA(root) +
+//   sum over leaves L of intersection_cost * |L| * SA(L) / SA(root)
+//
+// Postcondition:
+//   - returns 0 for bvh with no nodes
+inline double sah_cost(std::vector<bvh_node_t> const &nodes,
+                       double traversal_cost = 1.0,
+                       double intersection_cost = 1.0) {
+  if (nodes.empty())
+    return 0;
+  auto const root_area = surface_area(to_bound(nodes.front().bounds));
+  auto const area_scale = root_area > 0 ? 1 / root_area : 1.0;
+  double cost = 0;
+  for (auto const &node : nodes) {
+    auto const area = surface_area(to_bound(node.bounds)) * area_scale;
+    cost += is_leaf(node) ? intersection_cost * node.count * area
+                          : traversal_cost * area;
+  }
+  return cost;
+}
+} // namespace mrl
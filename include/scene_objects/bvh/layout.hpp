@@ -0,0 +1,197 @@
+#pragma once
+
+#include "bound.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <queue>
+#include <vector>
+
+namespace mrl {
+// Node of a bvh whose nodes may be stored in any order, unlike bvh_node_t
+// whose left child is always the node just after it.
+//
+// Interior node:
+//   - count is 0
+//   - children are the nodes at index left and right
+//
+// Leaf node:
+//   - count > 0
+//   - contains objects [left, left + count) of bvh's object array
+struct alignas(64) bvh_layout_node_t {
+  minmax_bound_t bounds;
+  std::uint32_t left;
+  std::uint32_t right;
+  std::uint32_t count;
+};
+
+static_assert(sizeof(bvh_layout_node_t) == sizeof(bvh_node_t));
+
+constexpr bool is_leaf(bvh_layout_node_t const &node) {
+  return node.count > 0;
+}
+
+// Layout decides where every node of a bvh is stored, which decides how many
+// cache lines and pages a traversal touches.
+//
+// Precondition:
+//   - nodes form a bvh as described by bvh_node_t
+//
+// Postcondition:
+//   - layout(nodes) returns a permutation of indices of nodes starting with
+//     0, its i'th element being the node to be stored at index i
+template <typename Layout>
+concept BvhLayout =
+    requires(Layout const &layout, std::vector<bvh_node_t> const &nodes) {
+      { layout(nodes) } -> std::same_as<std::vector<std::uint32_t>>;
+    };
+
+namespace __layout_details {
+// Both children of a node are always tested together, so they are stored
+// next to each other. Root is placed first and then children of interior
+// nodes in order of interior.
+//
+// Precondition:
+//   - interior has every interior node once, every node after its parent
+inline std::vector<std::uint32_t>
+sibling_pair_order(std::vector<bvh_node_t> const &nodes,
+                   std::vector<std::uint32_t> const &interior) {
+  std::vector<std::uint32_t> order;
+  order.reserve(nodes.size());
+  order.push_back(0);
+  for (auto index : interior) {
+    order.push_back(index + 1);
+    order.push_back(nodes[index].offset);
+  }
+  return order;
+}
+} // namespace __layout_details
+
+// Depth first order nodes are built in.
+struct depth_first_layout {
+  std::vector<std::uint32_t>
+  operator()(std::vector<bvh_node_t> const &nodes) const {
+    std::vector<std::uint32_t> order(nodes.size());
+    std::iota(order.begin(), order.end(), std::uint32_t{0});
+    return order;
+  }
+};
+
+// van Emde Boas layout. Tree of h levels is split into a top tree of h / 2
+// levels and bottom trees rooted below it. Top tree and then every bottom
+// tree is laid out recursively, each stored contiguously. For any block size
+// (cache line, page), a path from root to a leaf then crosses O(log_B n)
+// blocks without layout knowing block size. Interior nodes are laid out so,
+// each followed by its children as a pair.
+struct van_emde_boas_layout {
+  std::vector<std::uint32_t>
+  operator()(std::vector<bvh_node_t> const &nodes) const {
+    if (nodes.empty())
+      return {};
+    std::vector<std::uint32_t> interior;
+    std::vector<std::uint32_t> height(nodes.size());
+    for (auto i = nodes.size(); i > 0; --i) {
+      auto const &node = nodes[i - 1];
+      height[i - 1] =
+          is_leaf(node) ? 0 : 1 + std::max(height[i], height[node.offset]);
+    }
+    // Appends interior nodes at depth below levels of subtree at root.
+    auto lay_out = [&](auto &self, std::uint32_t root,
+                       std::uint32_t levels) -> void {
+      if (is_leaf(nodes[root]))
+        return;
+      levels = std::min(levels, height[root] + 1);
+      if (levels == 1) {
+        interior.push_back(root);
+        return;
+      }
+      auto const top_levels = levels / 2;
+      self(self, root, top_levels);
+      std::vector<std::uint32_t> bottom_roots;
+      auto collect = [&](auto &collect_self, std::uint32_t index,
+                         std::uint32_t depth) -> void {
+        if (depth == top_levels) {
+          bottom_roots.push_back(index);
+          return;
+        }
+        if (is_leaf(nodes[index]))
+          return;
+        collect_self(collect_self, index + 1, depth + 1);
+        collect_self(collect_self, nodes[index].offset, depth + 1);
+      };
+      collect(collect, root, 0);
+      for (auto bottom_root : bottom_roots) {
+        self(self, bottom_root, levels - top_levels);
+      }
+    };
+    lay_out(lay_out, 0, height[0] + 1);
+    return __layout_details::sibling_pair_order(nodes, interior);
+  }
+};
+
+// Nodes most visited by rays first, as measured by a profiling render (see
+// bvh_profiler_t), so that nodes most rays visit share cache lines and
+// pages. Interior nodes are ordered by their visits, every one after its
+// parent, and their children stored as pairs in that order.
+//
+// Class Invariant:
+//   - visits[i] is number of times node i was visited
+struct frequency_layout {
+  std::vector<std::uint64_t> visits;
+
+  // Precondition:
+  //   - visits.size() == nodes.size()
+  std::vector<std::uint32_t>
+  operator()(std::vector<bvh_node_t> const &nodes) const {
+    if (nodes.empty())
+      return {};
+    std::vector<std::uint32_t> interior;
+    auto colder = [this](std::uint32_t a, std::uint32_t b) {
+      return visits[a] != visits[b] ? visits[a] < visits[b] : a > b;
+    };
+    std::priority_queue<std::uint32_t, std::vector<std::uint32_t>,
+                        decltype(colder)>
+        to_place(colder);
+    auto place = [&](std::uint32_t index) {
+      if (!is_leaf(nodes[index]))
+        to_place.push(index);
+    };
+    place(0);
+    while (!to_place.empty()) {
+      auto const cur = to_place.top();
+      to_place.pop();
+      interior.push_back(cur);
+      place(cur + 1);
+      place(nodes[cur].offset);
+    }
+    return __layout_details::sibling_pair_order(nodes, interior);
+  }
+};
+
+// Postcondition:
+//   - returns nodes stored in order given by layout, root being at index 0
+template <BvhLayout Layout>
+std::vector<bvh_layout_node_t>
+lay_out_bvh_nodes(std::vector<bvh_node_t> const &nodes, Layout const &layout) {
+  auto const order = layout(nodes);
+  std::vector<std::uint32_t> position(nodes.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    position[order[i]] = static_cast<std::uint32_t>(i);
+  }
+  std::vector<bvh_layout_node_t> res;
+  res.reserve(nodes.size());
+  for (auto index : order) {
+    auto const &node = nodes[index];
+    if (is_leaf(node)) {
+      res.push_back({node.bounds, node.offset, 0, node.count});
+    } else {
+      res.push_back(
+          {node.bounds, position[index + 1], position[node.offset], 0});
+    }
+  }
+  return res;
+}
+} // namespace mrl
@@ -0,0 +1,508 @@
+#pragma once
+
+#include "bound.hpp"
+#include "point.hpp"
+#include "schedulers/concepts.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/concepts.hpp"
+#include "stdexec/execution.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ranges>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace mrl {
+// Options of linear bvh construction.
+//
+// With ploc set, hierarchy is built by Parallel Locally-Ordered Clustering
+// instead of Morton code prefixes: every cluster merges with its nearest
+// cluster (by surface area of merged bounds) among ploc_search_radius
+// clusters on either side of it in Morton order. Chunks of clusters are
+// clustered in parallel until few clusters are left in each, then those left
+// are clustered together. It is slower to build, but gives trees close to
+// sah_split ones.
+//
+// Precondition:
+//   - ploc_search_radius >= 1
+struct lbvh_options {
+  bool ploc = false;
+  int ploc_search_radius = 16;
+};
+
+// Postcondition:
+//   - returns 63 bit Morton code of p, interleaving 21 bits of every
+//     coordinate, where p is in [0, 1]^3
+constexpr std::uint64_t morton_code(point3 const &p) {
+  constexpr std::uint64_t max_coordinate = (std::uint64_t{1} << 21) - 1;
+  auto quantize = [](double x) {
+    constexpr auto scale = static_cast<double>(max_coordinate + 1);
+    auto const scaled =
+        std::clamp(x * scale, 0.0, static_cast<double>(max_coordinate));
+    return static_cast<std::uint64_t>(scaled);
+  };
+  auto expand_bits = [](std::uint64_t x) {
+    x = (x | x << 32) & 0x1f00000000ffff;
+    x = (x | x << 16) & 0x1f0000ff0000ff;
+    x = (x | x << 8) & 0x100f00f00f00f00f;
+    x = (x | x << 4) & 0x10c30c30c30c30c3;
+    x = (x | x << 2) & 0x1249249249249249;
+    return x;
+  };
+  return expand_bits(quantize(p.x)) << 2 | expand_bits(quantize(p.y)) << 1 |
+         expand_bits(quantize(p.z));
+}
+
+namespace __lbvh_details {
+constexpr static std::size_t num_chunks = 64;
+constexpr static std::size_t radix_bits = 8;
+constexpr static std::size_t radix_size = std::size_t{1} << radix_bits;
+constexpr static std::size_t num_radix_passes = 64 / radix_bits;
+
+// Intermediate hierarchy over n sorted primitives. Cluster id i < n is the
+// leaf of i'th primitive in Morton order and id n + k is k'th internal
+// cluster with children children[k].
+//
+// With ploc, internal clusters made while clustering a chunk of primitives
+// [b, e) are k'th for k in [b, e), and those made while clustering what is
+// left of all chunks are k'th for k >= n. So some k are left unused.
+//
+// Precondition:
+//   - number of objects < 2^32
+template <typename Object> struct build_state_t {
+  using children_t = std::array<std::uint32_t, 2>;
+
+  std::vector<Object> objects;
+  lbvh_options options;
+  std::array<std::vector<bvh_primitive_ref_t>, 2> refs;
+  std::array<std::vector<std::uint64_t>, 2> codes;
+  std::array<bound_t, num_chunks> chunk_centroid_bounds;
+  bound_t centroid_bounds;
+  std::vector<std::array<std::size_t, radix_size>> histograms;
+  std::vector<children_t> children;
+  std::uint32_t root = 0;
+  // Bounds of clusters by id, only with ploc.
+  std::vector<bound_t> cluster_bounds;
+  // Ids of clusters of every chunk, the first num_chunk_clusters[c] of
+  // those of chunk c being clusters left after clustering it.
+  std::vector<std::uint32_t> clusters;
+  std::array<std::size_t, num_chunks> num_chunk_clusters{};
+
+  build_state_t(std::vector<Object> objects_arg, lbvh_options options_arg)
+      : objects(std::move(objects_arg)), options(options_arg),
+        refs{std::vector<bvh_primitive_ref_t>(objects.size()),
+             std::vector<bvh_primitive_ref_t>(objects.size())},
+        codes{std::vector<std::uint64_t>(objects.size()),
+              std::vector<std::uint64_t>(objects.size())},
+        histograms(num_chunks) {
+    auto const n = objects.size();
+    if (n == 0)
+      return;
+    children.resize(options.ploc ? 2 * n - 1 : n - 1);
+    if (options.ploc) {
+      cluster_bounds.resize(n + children.size());
+      clusters.resize(n);
+    }
+  }
+
+  std::size_t num_objects() const { return objects.size(); }
+
+  std::size_t chunk_begin(std::size_t chunk) const {
+    return chunk * num_objects() / num_chunks;
+  }
+
+  void make_refs(std::size_t chunk) {
+    bound_t bounds;
+    for (auto i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+      refs[0][i] = {get_bounds(objects[i]), static_cast<std::uint32_t>(i)};
+      auto const center = centroid(refs[0][i].bounds);
+      bounds = union_bounds(bounds, bound_from_diagonal_points(center, center));
+    }
+    chunk_centroid_bounds[chunk] = bounds;
+  }
+
+  void reduce_centroid_bounds() {
+    for (auto const &bounds : chunk_centroid_bounds) {
+      centroid_bounds = union_bounds(centroid_bounds, bounds);
+    }
+  }
+
+  void make_codes(std::size_t chunk) {
+    auto normalize = [](interval_t const &range, double x) {
+      return size(range) > 0 ? (x - range.min) / size(range) : 0.0;
+    };
+    for (auto i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+      auto const center = centroid(refs[0][i].bounds);
+      codes[0][i] = morton_code({
+          normalize(centroid_bounds.x_range, center.x),
+          normalize(centroid_bounds.y_range, center.y),
+          normalize(centroid_bounds.z_range, center.z),
+      });
+    }
+  }
+
+  // Least significant digit radix sort of codes, pass p reads buffer p % 2
+  // and writes the other one. It is stable, so primitives with equal codes
+  // stay in their original order.
+  static std::size_t digit(std::uint64_t code, std::size_t pass) {
+    return (code >> (pass * radix_bits)) & (radix_size - 1);
+  }
+
+  void count_digits(std::size_t pass, std::size_t chunk) {
+    auto &histogram = histograms[chunk];
+    histogram.fill(0);
+    auto const &in = codes[pass % 2];
+    for (auto i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+      ++histogram[digit(in[i], pass)];
+    }
+  }
+
+  // Postcondition:
+  //   - histograms[c][d] is the position first code of chunk c with digit d
+  //     is written to
+  void scan_digits() {
+    std::size_t offset = 0;
+    for (std::size_t d = 0; d < radix_size; ++d) {
+      for (auto &histogram : histograms) {
+        offset += std::exchange(histogram[d], offset);
+      }
+    }
+  }
+
+  void scatter_digits(std::size_t pass, std::size_t chunk) {
+    auto &histogram = histograms[chunk];
+    auto const &in_codes = codes[pass % 2];
+    auto const &in_refs = refs[pass % 2];
+    auto &out_codes = codes[(pass + 1) % 2];
+    auto &out_refs = refs[(pass + 1) % 2];
+    for (auto i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+      auto const pos = histogram[digit(in_codes[i], pass)]++;
+      out_codes[pos] = in_codes[i];
+      out_refs[pos] = in_refs[i];
+    }
+  }
+
+  // Length of common prefix of codes i and j, with index used as tie breaker
+  // of equal codes. -1 if j is out of range.
+  int common_prefix(std::int64_t i, std::int64_t j) const {
+    if (j < 0 || j >= static_cast<std::int64_t>(num_objects()))
+      return -1;
+    auto const ci = codes[0][static_cast<std::size_t>(i)];
+    auto const cj = codes[0][static_cast<std::size_t>(j)];
+    if (ci == cj)
+      return 64 + std::countl_zero(static_cast<std::uint32_t>(i ^ j));
+    return std::countl_zero(ci ^ cj);
+  }
+
+  // Karras, "Maximizing Parallelism in the Construction of BVHs, Octrees,
+  // and k-d Trees". Internal cluster i is found independently of others.
+  void make_radix_node(std::size_t index) {
+    auto const n = static_cast<std::int64_t>(num_objects());
+    auto const i = static_cast<std::int64_t>(index);
+    auto const d = common_prefix(i, i + 1) > common_prefix(i, i - 1) ? 1 : -1;
+    auto const min_prefix = common_prefix(i, i - d);
+    std::int64_t max_length = 2;
+    while (common_prefix(i, i + max_length * d) > min_prefix)
+      max_length *= 2;
+    std::int64_t length = 0;
+    for (auto t = max_length / 2; t >= 1; t /= 2) {
+      if (common_prefix(i, i + (length + t) * d) > min_prefix)
+        length += t;
+    }
+    auto const j = i + length * d;
+    auto const node_prefix = common_prefix(i, j);
+    std::int64_t split = 0;
+    auto t = length;
+    do {
+      t = (t + 1) / 2;
+      if (common_prefix(i, i + (split + t) * d) > node_prefix)
+        split += t;
+    } while (t > 1);
+    auto const gamma = i + split * d + std::min(d, 0);
+    auto cluster = [n](std::int64_t k, bool is_leaf) {
+      return static_cast<std::uint32_t>(is_leaf ? k : n + k);
+    };
+    children[index] = {cluster(gamma, std::min(i, j) == gamma),
+                       cluster(gamma + 1, std::max(i, j) == gamma + 1)};
+  }
+
+  void make_radix_nodes(std::size_t chunk) {
+    if (options.ploc)
+      return;
+    auto const n = num_objects();
+    for (auto i = chunk * n / num_chunks;
+         i < std::min((chunk + 1) * n / num_chunks, n - 1); ++i) {
+      make_radix_node(i);
+    }
+  }
+
+  // Meister and Bittner, "Parallel Locally-Ordered Clustering for Bounding
+  // Volume Hierarchy Construction". Mutually nearest clusters of cluster_ids
+  // are merged until at most target clusters are left, making internal
+  // clusters first_internal'th, (first_internal + 1)'th and so on.
+  //
+  // Precondition:
+  //   - target >= 1
+  //
+  // Postcondition:
+  //   - returns number of clusters left, which are at front of cluster_ids
+  //     in Morton order
+  std::size_t merge_nearest(std::span<std::uint32_t> cluster_ids,
+                            std::size_t first_internal, std::size_t target) {
+    auto const n = num_objects();
+    auto const radius = static_cast<std::size_t>(options.ploc_search_radius);
+    std::vector<std::size_t> nearest;
+    auto num_internal = first_internal;
+    auto m = cluster_ids.size();
+    while (m > target) {
+      nearest.resize(m);
+      for (std::size_t i = 0; i < m; ++i) {
+        auto best = std::numeric_limits<double>::infinity();
+        nearest[i] = m;
+        auto const last = std::min(m, i + radius + 1);
+        for (auto j = i > radius ? i - radius : 0; j < last; ++j) {
+          if (j == i)
+            continue;
+          auto const area = surface_area(union_bounds(
+              cluster_bounds[cluster_ids[i]], cluster_bounds[cluster_ids[j]]));
+          if (nearest[i] == m || area < best) {
+            best = area;
+            nearest[i] = j;
+          }
+        }
+      }
+      // Ties are broken towards lower index, so the pair with least area,
+      // then least indices is always mutually nearest. Clusters are
+      // compacted in place, as none is written past the one being read.
+      std::size_t num_left = 0;
+      for (std::size_t i = 0; i < m; ++i) {
+        auto const j = nearest[i];
+        if (nearest[j] != i) {
+          cluster_ids[num_left++] = cluster_ids[i];
+        } else if (i < j) {
+          auto const id = static_cast<std::uint32_t>(n + num_internal);
+          children[num_internal++] = {cluster_ids[i], cluster_ids[j]};
+          cluster_bounds[id] = union_bounds(cluster_bounds[cluster_ids[i]],
+                                            cluster_bounds[cluster_ids[j]]);
+          cluster_ids[num_left++] = id;
+        }
+      }
+      m = num_left;
+    }
+    return m;
+  }
+
+  // Clusters chunk until 2 * ploc_search_radius clusters are left in it, so
+  // that those near its ends can still merge with clusters of neighbouring
+  // chunks when what is left of all chunks is clustered together.
+  void cluster_chunk(std::size_t chunk) {
+    if (!options.ploc)
+      return;
+    auto const first = chunk_begin(chunk);
+    auto const last = chunk_begin(chunk + 1);
+    for (auto i = first; i < last; ++i) {
+      clusters[i] = static_cast<std::uint32_t>(i);
+      cluster_bounds[i] = refs[0][i].bounds;
+    }
+    auto const target =
+        2 * static_cast<std::size_t>(options.ploc_search_radius);
+    num_chunk_clusters[chunk] = merge_nearest(
+        std::span(clusters).subspan(first, last - first), first, target);
+  }
+
+  // Precondition:
+  //   - every chunk is clustered
+  void cluster_chunks_left() {
+    std::size_t m = 0;
+    for (std::size_t chunk = 0; chunk < num_chunks; ++chunk) {
+      auto const first = chunk_begin(chunk);
+      for (std::size_t k = 0; k < num_chunk_clusters[chunk]; ++k) {
+        clusters[m++] = clusters[first + k];
+      }
+    }
+    merge_nearest(std::span(clusters).first(m), num_objects(), 1);
+    root = clusters.front();
+  }
+
+  // Builder over refs of final bvh, subtrees deeper than max_split_depth are
+  // rebuilt by splitting at midpoint to keep bvh within bvh_max_depth.
+  struct flattener {
+    build_state_t const &state;
+    std::vector<bvh_primitive_ref_t> ordered;
+    std::vector<bvh_node_t> nodes;
+
+    std::uint32_t flatten(std::uint32_t id, std::size_t depth) {
+      auto const n = state.num_objects();
+      auto const index = static_cast<std::uint32_t>(nodes.size());
+      if (id < n) {
+        nodes.push_back({
+            .bounds = to_minmax_bound(state.refs[0][id].bounds),
+            .offset = static_cast<std::uint32_t>(ordered.size()),
+            .count = 1,
+        });
+        ordered.push_back(state.refs[0][id]);
+        return index;
+      }
+      if (depth >= __bvh_build_details::max_split_depth) {
+        auto const begin = ordered.size();
+        append_leaves(id);
+        median_split split;
+        __bvh_build_details::builder<bvh_primitive_iterator, median_split>
+            builder{ordered.begin(), split, std::move(nodes)};
+        builder.build(std::next(ordered.begin(),
+                                static_cast<std::ptrdiff_t>(begin)),
+                      ordered.end(), depth);
+        nodes = std::move(builder.nodes);
+        return index;
+      }
+      nodes.push_back({});
+      auto const &[left, right] = state.children[id - n];
+      flatten(left, depth + 1);
+      auto const right_index = flatten(right, depth + 1);
+      nodes[index] = bvh_node_t{
+          .bounds =
+              union_bounds(nodes[index + 1].bounds, nodes[right_index].bounds),
+          .offset = right_index,
+          .count = 0,
+      };
+      return index;
+    }
+
+    void append_leaves(std::uint32_t id) {
+      auto const n = state.num_objects();
+      std::vector<std::uint32_t> to_visit{id};
+      while (!to_visit.empty()) {
+        auto const cur = to_visit.back();
+        to_visit.pop_back();
+        if (cur < n) {
+          ordered.push_back(state.refs[0][cur]);
+        } else {
+          to_visit.push_back(state.children[cur - n][1]);
+          to_visit.push_back(state.children[cur - n][0]);
+        }
+      }
+    }
+  };
+
+  bvh_t<Object> finish() {
+    auto const n = num_objects();
+    if (n == 0)
+      return bvh_t<Object>({}, {});
+    if (options.ploc) {
+      cluster_chunks_left();
+    } else {
+      root = static_cast<std::uint32_t>(n == 1 ? 0 : n);
+    }
+    flattener f{*this, {}, {}};
+    f.ordered.reserve(n);
+    f.nodes.reserve(2 * n - 1);
+    f.flatten(root, 0);
+    reorder_objects(objects, f.ordered);
+    return bvh_t<Object>(std::move(objects), std::move(f.nodes));
+  }
+};
+
+template <std::size_t pass, typename Sender>
+auto radix_sort_passes(Sender &&sender) {
+  if constexpr (pass == num_radix_passes) {
+    return std::forward<Sender>(sender);
+  } else {
+    return radix_sort_passes<pass + 1>(
+        std::forward<Sender>(sender) |
+        stdexec::bulk(num_chunks,
+                      [](std::size_t chunk, auto &state) {
+                        state.count_digits(pass, chunk);
+                      }) |
+        stdexec::bulk(1,
+                      [](std::size_t, auto &state) { state.scan_digits(); }) |
+        stdexec::bulk(num_chunks, [](std::size_t chunk, auto &state) {
+          state.scatter_digits(pass, chunk);
+        }));
+  }
+}
+} // namespace __lbvh_details
+
+// Builds bvh over objects of rng from Morton codes of centroids of their
+// bounds. Build time is linear in number of objects, but resulting tree is
+// usually worse than the one built with sah_split unless options.ploc is set.
+//
+// Precondition:
+//   - std::ranges::size(rng) < 2^32
+template <std::ranges::random_access_range Range>
+  requires BoundedObject<std::ranges::range_value_t<Range>>
+bvh_t<std::ranges::range_value_t<Range>> build_lbvh(Range &&rng,
+                                                    lbvh_options options = {}) {
+  using namespace __lbvh_details;
+  using object_type = std::ranges::range_value_t<Range>;
+  build_state_t<object_type> state(
+      to_object_vector<object_type>(std::forward<Range>(rng)), options);
+  for (std::size_t chunk = 0; chunk < num_chunks; ++chunk)
+    state.make_refs(chunk);
+  state.reduce_centroid_bounds();
+  for (std::size_t chunk = 0; chunk < num_chunks; ++chunk)
+    state.make_codes(chunk);
+  for (std::size_t pass = 0; pass < num_radix_passes; ++pass) {
+    for (std::size_t chunk = 0; chunk < num_chunks; ++chunk)
+      state.count_digits(pass, chunk);
+    state.scan_digits();
+    for (std::size_t chunk = 0; chunk < num_chunks; ++chunk)
+      state.scatter_digits(pass, chunk);
+  }
+  for (std::size_t chunk = 0; chunk < num_chunks; ++chunk)
+    state.make_radix_nodes(chunk);
+  for (std::size_t chunk = 0; chunk < num_chunks; ++chunk)
+    state.cluster_chunk(chunk);
+  return state.finish();
+}
+
+// Same as build_lbvh(rng, options), but computing Morton codes, sorting them
+// and building internal nodes from them, or clustering chunks with ploc, in
+// parallel on scheduler.
+//
+// Postcondition:
+//   - returns a sender that completes with the built bvh_t
+template <Scheduler scheduler_t, std::ranges::random_access_range Range>
+  requires BoundedObject<std::ranges::range_value_t<Range>>
+auto build_lbvh(scheduler_t scheduler, Range &&rng, lbvh_options options = {}) {
+  using namespace __lbvh_details;
+  using object_type = std::ranges::range_value_t<Range>;
+  using state_t = build_state_t<object_type>;
+
+  auto make_state = [objects = to_object_vector<object_type>(
+                         std::forward<Range>(rng)),
+                     options]() mutable {
+    return state_t(std::move(objects), options);
+  };
+  auto codes_built =
+      stdexec::schedule(scheduler) | stdexec::then(std::move(make_state)) |
+      stdexec::bulk(num_chunks,
+                    [](std::size_t chunk, state_t &state) {
+                      state.make_refs(chunk);
+                    }) |
+      stdexec::bulk(1,
+                    [](std::size_t, state_t &state) {
+                      state.reduce_centroid_bounds();
+                    }) |
+      stdexec::bulk(num_chunks, [](std::size_t chunk, state_t &state) {
+        state.make_codes(chunk);
+      });
+  return radix_sort_passes<0>(std::move(codes_built)) |
+         stdexec::bulk(num_chunks,
+                       [](std::size_t chunk, state_t &state) {
+                         state.make_radix_nodes(chunk);
+                       }) |
+         stdexec::bulk(num_chunks,
+                       [](std::size_t chunk, state_t &state) {
+                         state.cluster_chunk(chunk);
+                       }) |
+         stdexec::then([](state_t state) { return state.finish(); });
+}
+} // namespace mrl
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "bound.hpp"
+#include <cstddef>
+#include <cstdint>
+
+namespace mrl {
+// Node of a flattened bvh. Nodes are stored in depth first order.
+//
+// Interior node:
+//   - count is 0
+//   - left child is the node just after it
+//   - right child is the node at index offset
+//
+// Leaf node:
+//   - count > 0
+//   - contains objects [offset, offset + count) of bvh's object array
+struct alignas(64) bvh_node_t {
+  minmax_bound_t bounds;
+  std::uint32_t offset;
+  std::uint32_t count;
+};
+
+static_assert(sizeof(bvh_node_t) == 64);
+
+// Upper bound on depth of any bvh, traversal stacks are sized with it.
+constexpr static std::size_t bvh_max_depth = 64;
+
+constexpr bool is_leaf(bvh_node_t const &node) { return node.count > 0; }
+} // namespace mrl
@@ -0,0 +1,239 @@
+#pragma once
+
+#include "bound.hpp"
+#include "schedulers/concepts.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/concepts.hpp"
+#include "stdexec/execution.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+namespace mrl {
+namespace __bvh_parallel_build_details {
+// Top parallel_split_depth levels of bvh are split level by level, all nodes
+// of a level in parallel. Subtrees below them are then built in parallel.
+constexpr static std::size_t parallel_split_depth = 6;
+constexpr static std::size_t num_subtrees = std::size_t{1}
+                                            << parallel_split_depth;
+constexpr static std::size_t num_ref_chunks = 64;
+static_assert(num_ref_chunks >= num_subtrees / 2);
+
+// Range [begin, end) of refs a node of top levels is built over.
+//
+// A node that is not split passes its whole range to its left child and an
+// empty range to its right child.
+struct slot_t {
+  std::uint32_t begin = 0;
+  std::uint32_t end = 0;
+  bool is_split = false;
+};
+
+constexpr std::size_t slot_index(std::size_t level, std::size_t i) {
+  return (std::size_t{1} << level) - 1 + i;
+}
+
+// Node bounds of every slot of a level are computed in num_ref_chunks chunks
+// in parallel, slots of level sharing them evenly.
+constexpr std::size_t chunks_per_slot(std::size_t level) {
+  return num_ref_chunks >> level;
+}
+
+// Class Invariant:
+//   - slots are laid out as a complete binary tree of parallel_split_depth + 1
+//     levels, children of slot k are slots 2k + 1 and 2k + 2
+template <typename Object, typename Split> struct build_state_t {
+  std::vector<Object> objects;
+  Split split;
+  std::vector<bvh_primitive_ref_t> refs;
+  std::array<slot_t, 2 * num_subtrees - 1> slots;
+  // Node bounds of chunks of slots of level being split.
+  std::array<node_bounds_t, num_ref_chunks> chunk_bounds;
+  std::array<std::vector<bvh_node_t>, num_subtrees> subtrees;
+
+  build_state_t(std::vector<Object> objects_arg, Split split_arg)
+      : objects(std::move(objects_arg)), split(std::move(split_arg)),
+        refs(objects.size()) {
+    slots[0] = {0, static_cast<std::uint32_t>(objects.size()), false};
+  }
+
+  void make_refs(std::size_t chunk) {
+    auto const n = objects.size();
+    auto const first = chunk * n / num_ref_chunks;
+    auto const last = (chunk + 1) * n / num_ref_chunks;
+    for (auto i = first; i < last; ++i) {
+      refs[i] = {get_bounds(objects[i]), static_cast<std::uint32_t>(i)};
+    }
+  }
+
+  // Precondition:
+  //   - all slots of level have their ranges assigned
+  //
+  // Postcondition:
+  //   - chunk_bounds[chunk] is node bounds of its part of its slot of level
+  void bound_chunk(std::size_t level, std::size_t chunk) {
+    auto const per_slot = chunks_per_slot(level);
+    auto const &slot = slots[slot_index(level, chunk / per_slot)];
+    auto const n = std::size_t{slot.end - slot.begin};
+    auto const part = chunk % per_slot;
+    auto const first = refs.begin() + slot.begin;
+    auto const chunk_begin = static_cast<std::ptrdiff_t>(part * n / per_slot);
+    auto const chunk_end =
+        static_cast<std::ptrdiff_t>((part + 1) * n / per_slot);
+    chunk_bounds[chunk] =
+        node_bounds_of(first + chunk_begin, first + chunk_end);
+  }
+
+  // Precondition:
+  //   - all slots of level have their ranges assigned
+  //   - chunk_bounds holds node bounds of chunks of level
+  //
+  // Postcondition:
+  //   - ranges of children of i'th slot of level are assigned
+  void split_slot(std::size_t level, std::size_t i) {
+    auto const index = slot_index(level, i);
+    auto &slot = slots[index];
+    auto &left = slots[2 * index + 1];
+    auto &right = slots[2 * index + 2];
+    if (slot.end - slot.begin < 2) {
+      left = {slot.begin, slot.end, false};
+      right = {slot.end, slot.end, false};
+      return;
+    }
+    auto const begin = refs.begin() + slot.begin;
+    auto const end = refs.begin() + slot.end;
+    auto const mid = [&] {
+      if constexpr (NodeBoundsSplitStrategy<Split, bvh_primitive_iterator>) {
+        auto const per_slot = chunks_per_slot(level);
+        node_bounds_t node_bounds;
+        for (auto chunk = i * per_slot; chunk < (i + 1) * per_slot; ++chunk) {
+          node_bounds = union_bounds(node_bounds, chunk_bounds[chunk]);
+        }
+        return split(begin, end, node_bounds);
+      } else {
+        return split(begin, end);
+      }
+    }();
+    auto const mid_index = static_cast<std::uint32_t>(mid - refs.begin());
+    slot.is_split = true;
+    left = {slot.begin, mid_index, false};
+    right = {mid_index, slot.end, false};
+  }
+
+  void build_subtree(std::size_t i) {
+    auto const &slot = slots[slot_index(parallel_split_depth, i)];
+    if (slot.begin == slot.end)
+      return;
+    __bvh_build_details::builder<bvh_primitive_iterator, Split> builder{
+        refs.begin(), split, {}};
+    builder.nodes.reserve(2 * std::size_t{slot.end - slot.begin} - 1);
+    builder.build(refs.begin() + slot.begin, refs.begin() + slot.end,
+                  parallel_split_depth);
+    subtrees[i] = std::move(builder.nodes);
+  }
+
+  // Appends nodes of subtree rooted at slot at index in depth first order.
+  //
+  // Postcondition:
+  //   - returns index of root node of appended subtree
+  std::uint32_t stitch(std::vector<bvh_node_t> &nodes, std::size_t level,
+                       std::size_t index) const {
+    auto const root = static_cast<std::uint32_t>(nodes.size());
+    if (level == parallel_split_depth) {
+      auto const &subtree = subtrees[index - slot_index(level, 0)];
+      for (auto node : subtree) {
+        if (!is_leaf(node))
+          node.offset += root;
+        nodes.push_back(node);
+      }
+      return root;
+    }
+    if (!slots[index].is_split)
+      return stitch(nodes, level + 1, 2 * index + 1);
+    nodes.push_back({});
+    stitch(nodes, level + 1, 2 * index + 1);
+    auto const right = stitch(nodes, level + 1, 2 * index + 2);
+    nodes[root] = bvh_node_t{
+        .bounds = union_bounds(nodes[root + 1].bounds, nodes[right].bounds),
+        .offset = right,
+        .count = 0,
+    };
+    return root;
+  }
+
+  bvh_t<Object> finish() {
+    std::vector<bvh_node_t> nodes;
+    if (!objects.empty()) {
+      nodes.reserve(2 * objects.size() - 1);
+      stitch(nodes, 0, 0);
+    }
+    reorder_objects(objects, refs);
+    return bvh_t<Object>(std::move(objects), std::move(nodes));
+  }
+};
+
+template <std::size_t level, typename Sender>
+auto split_levels(Sender &&sender) {
+  if constexpr (level == parallel_split_depth) {
+    return std::forward<Sender>(sender);
+  } else {
+    return split_levels<level + 1>(
+        std::forward<Sender>(sender) |
+        stdexec::bulk(num_ref_chunks,
+                      [](std::size_t chunk, auto &state) {
+                        state.bound_chunk(level, chunk);
+                      }) |
+        stdexec::bulk(std::size_t{1} << level, [](std::size_t i, auto &state) {
+          state.split_slot(level, i);
+        }));
+  }
+}
+} // namespace __bvh_parallel_build_details
+
+// Builds bvh over objects of rng on scheduler.
+//
+// Bounds of objects are computed in parallel chunks. Top levels of bvh are
+// split level by level with all nodes of a level split in parallel, and
+// subtrees below them are built in parallel. Node bounds of top levels are
+// also reduced in parallel chunks and handed to split if it is a
+// NodeBoundsSplitStrategy, like sah_split. Binning and partitioning of a top
+// level node still run on one thread. Resulting bvh is same as the one built
+// by bvh_t(rng, split).
+//
+// Precondition:
+//   - std::ranges::size(rng) < 2^32
+//
+// Postcondition:
+//   - returns a sender that completes with the built bvh_t
+template <Scheduler scheduler_t, std::ranges::random_access_range Range,
+          typename Split = median_split>
+  requires BvhSplitStrategy<Split, bvh_primitive_iterator>
+auto build_bvh(scheduler_t scheduler, Range &&rng, Split split = {}) {
+  using namespace __bvh_parallel_build_details;
+  using object_type = std::ranges::range_value_t<Range>;
+  using state_t = build_state_t<object_type, Split>;
+
+  auto make_state = [objects = to_object_vector<object_type>(
+                         std::forward<Range>(rng)),
+                     split]() mutable {
+    return state_t(std::move(objects), std::move(split));
+  };
+  auto refs_built =
+      stdexec::schedule(scheduler) | stdexec::then(std::move(make_state)) |
+      stdexec::bulk(num_ref_chunks, [](std::size_t chunk, state_t &state) {
+        state.make_refs(chunk);
+      });
+  return split_levels<0>(std::move(refs_built)) |
+         stdexec::bulk(num_subtrees, [](std::size_t i, state_t &state) {
+           state.build_subtree(i);
+         }) |
+         stdexec::then([](state_t state) { return state.finish(); });
+}
+} // namespace mrl
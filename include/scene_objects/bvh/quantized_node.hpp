@@ -0,0 +1,161 @@
+#pragma once
+
+#include "bound.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace mrl {
+// Node of a bvh whose child bounds are quantized to Quant relative to bounds
+// of the node itself. Bounds of a node are only known by decoding them from
+// its parent (bounds of root are stored in full precision), so traversal
+// carries decoded bounds of the current node down the tree.
+//
+// Child i:
+//   - has bounds min[i], max[i] in steps of quantization_step of node bounds
+//     from min corner of node bounds
+//   - is an interior node at index child[i] if count[i] is 0
+//   - is a leaf containing objects [child[i], child[i] + count[i]) otherwise
+//
+// Class Invariant:
+//   - decoded bounds of a child enclose its objects, quantization rounds
+//     outwards
+template <std::unsigned_integral Quant> struct quantized_bvh_node_t {
+  std::array<std::array<Quant, 3>, 2> min;
+  std::array<std::array<Quant, 3>, 2> max;
+  std::array<std::uint32_t, 2> child;
+  std::array<std::uint32_t, 2> count;
+};
+
+// Postcondition:
+//   - returns size of one quantization step of every axis of bounds, rounded
+//     up such that numeric_limits<Quant>::max() steps cover whole bounds
+template <std::unsigned_integral Quant>
+constexpr vec3 quantization_step(minmax_bound_t const &bounds) {
+  constexpr static double max_quant = std::numeric_limits<Quant>::max();
+  constexpr static double round_up =
+      1 + 4 * std::numeric_limits<double>::epsilon();
+  auto const &[min, max] = bounds.corners;
+  return (max - min) * (round_up / max_quant);
+}
+
+// Precondition:
+//   - step is quantization_step<Quant>(bounds), bounds are decoded bounds of
+//     node
+template <std::unsigned_integral Quant>
+constexpr minmax_bound_t child_bounds(quantized_bvh_node_t<Quant> const &node,
+                                      std::size_t i,
+                                      minmax_bound_t const &bounds,
+                                      vec3 const &step) {
+  auto const &origin = bounds.corners[0];
+  auto const &min = node.min[i];
+  auto const &max = node.max[i];
+  return {{
+      point3{origin.x + min[0] * step.x, origin.y + min[1] * step.y,
+             origin.z + min[2] * step.z},
+      point3{origin.x + max[0] * step.x, origin.y + max[1] * step.y,
+             origin.z + max[2] * step.z},
+  }};
+}
+
+namespace __quantized_bvh_details {
+// Precondition:
+//   - bounds encloses exact
+//
+// Postcondition:
+//   - child_bounds(node, i, bounds, step) encloses exact
+template <std::unsigned_integral Quant>
+constexpr void set_child_bounds(quantized_bvh_node_t<Quant> &node,
+                                std::size_t i, bound_t const &exact,
+                                minmax_bound_t const &bounds,
+                                vec3 const &step) {
+  constexpr static double max_quant = std::numeric_limits<Quant>::max();
+  for (std::size_t axis = 0; axis < 3; ++axis) {
+    auto const a = static_cast<int>(axis);
+    auto const origin = component(bounds.corners[0], a);
+    auto const s = component(step, a);
+    auto const &range = axis_range(exact, a);
+    if (!(s > 0)) {
+      node.min[i][axis] = 0;
+      node.max[i][axis] = 0;
+      continue;
+    }
+    auto lo = std::clamp(std::floor((range.min - origin) / s), 0.0, max_quant);
+    auto hi = std::clamp(std::ceil((range.max - origin) / s), 0.0, max_quant);
+    while (lo > 0 && origin + lo * s > range.min)
+      --lo;
+    while (hi < max_quant && origin + hi * s < range.max)
+      ++hi;
+    node.min[i][axis] = static_cast<Quant>(lo);
+    node.max[i][axis] = static_cast<Quant>(hi);
+  }
+}
+
+// Child i never hit by any ray.
+template <std::unsigned_integral Quant>
+constexpr void set_absent_child(quantized_bvh_node_t<Quant> &node,
+                                std::size_t i) {
+  node.min[i].fill(std::numeric_limits<Quant>::max());
+  node.max[i].fill(0);
+  node.child[i] = 0;
+  node.count[i] = 0;
+}
+} // namespace __quantized_bvh_details
+
+// Precondition:
+//   - nodes form a binary bvh as described by bvh_node_t
+//
+// Postcondition:
+//   - returns nodes of a quantized bvh having same leaves as binary bvh nodes
+//   - root of quantized bvh is at index 0 and its bounds are bounds of root
+//     of binary bvh
+template <std::unsigned_integral Quant>
+std::vector<quantized_bvh_node_t<Quant>>
+quantize_bvh_nodes(std::vector<bvh_node_t> const &nodes) {
+  using namespace __quantized_bvh_details;
+  std::vector<quantized_bvh_node_t<Quant>> res;
+  if (nodes.empty())
+    return res;
+
+  // Fills a new node with children of binary node at binary_index, whose
+  // decoded bounds are bounds, and returns its index.
+  auto quantize = [&nodes, &res](
+                      auto &self, std::uint32_t binary_index,
+                      minmax_bound_t const &bounds) -> std::uint32_t {
+    auto const index = res.size();
+    res.emplace_back();
+    auto const step = quantization_step<Quant>(bounds);
+    auto const &root = nodes[binary_index];
+    std::array<std::uint32_t, 2> children{binary_index, binary_index};
+    if (!is_leaf(root))
+      children = {binary_index + 1, root.offset};
+    for (std::size_t i = 0; i < 2; ++i) {
+      auto const &child = nodes[children[i]];
+      if (i == 1 && is_leaf(root)) {
+        set_absent_child(res[index], i);
+        continue;
+      }
+      set_child_bounds(res[index], i, to_bound(child.bounds), bounds, step);
+      res[index].child[i] = child.offset;
+      res[index].count[i] = child.count;
+    }
+    for (std::size_t i = 0; i < 2; ++i) {
+      if (is_leaf(nodes[children[i]]))
+        continue;
+      auto const decoded = child_bounds(res[index], i, bounds, step);
+      auto const child = self(self, children[i], decoded);
+      res[index].child[i] = child;
+    }
+    return static_cast<std::uint32_t>(index);
+  };
+  quantize(quantize, 0, nodes.front().bounds);
+  return res;
+}
+} // namespace mrl
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "bound.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/concepts.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mrl {
+// Precondition:
+//   - children of node at index are already refitted
+//
+// Postcondition:
+//   - bounds of node at index enclose its children or objects
+template <BoundedObject Object>
+void refit_node(std::vector<bvh_node_t> &nodes,
+                std::vector<Object> const &objects, std::uint32_t index) {
+  auto &node = nodes[index];
+  if (is_leaf(node)) {
+    bound_t bounds;
+    for (auto i = node.offset; i < node.offset + node.count; ++i) {
+      bounds = union_bounds(bounds, get_bounds(objects[i]));
+    }
+    node.bounds = to_minmax_bound(bounds);
+  } else {
+    node.bounds = union_bounds(nodes[index + 1].bounds,
+                               nodes[node.offset].bounds);
+  }
+}
+
+// Postcondition:
+//   - returns end of range of nodes of subtree rooted at index, which starts
+//     at index as nodes are in depth first order
+inline std::uint32_t subtree_end(std::vector<bvh_node_t> const &nodes,
+                                 std::uint32_t index) {
+  while (!is_leaf(nodes[index]))
+    index = nodes[index].offset;
+  return index + 1;
+}
+
+// Children are after their parent in depth first order, so visiting nodes in
+// reverse refits every node after its children.
+//
+// Precondition:
+//   - [begin, end) is range of nodes of a subtree
+template <BoundedObject Object>
+void refit_nodes(std::vector<bvh_node_t> &nodes,
+                 std::vector<Object> const &objects, std::uint32_t begin,
+                 std::uint32_t end) {
+  for (auto i = end; i > begin; --i) {
+    refit_node(nodes, objects, i - 1);
+  }
+}
+
+// Splits a bvh in independent subtrees to be refitted in parallel and nodes
+// above them to be refitted afterwards.
+//
+// Class Invariant:
+//   - top_nodes are in depth first order
+struct bvh_refit_plan_t {
+  constexpr static std::size_t split_depth = 6;
+  constexpr static std::size_t max_subtrees = std::size_t{1} << split_depth;
+
+  std::array<std::uint32_t, max_subtrees> subtrees;
+  std::size_t num_subtrees = 0;
+  std::array<std::uint32_t, max_subtrees - 1> top_nodes;
+  std::size_t num_top_nodes = 0;
+};
+
+inline bvh_refit_plan_t make_refit_plan(std::vector<bvh_node_t> const &nodes) {
+  bvh_refit_plan_t plan;
+  if (nodes.empty())
+    return plan;
+  auto visit = [&nodes, &plan](auto &self, std::uint32_t index,
+                               std::size_t depth) -> void {
+    if (depth == bvh_refit_plan_t::split_depth || is_leaf(nodes[index])) {
+      plan.subtrees[plan.num_subtrees++] = index;
+      return;
+    }
+    plan.top_nodes[plan.num_top_nodes++] = index;
+    self(self, index + 1, depth + 1);
+    self(self, nodes[index].offset, depth + 1);
+  };
+  visit(visit, 0, 0);
+  return plan;
+}
+} // namespace mrl
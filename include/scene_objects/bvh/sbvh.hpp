@@ -0,0 +1,269 @@
+#pragma once
+
+#include "bound.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/concepts.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ranges>
+#include <vector>
+
+namespace mrl {
+// Options of spatial split bvh construction. Costs are the same as of
+// sah_split.
+//
+// Spatial splits are only tried for nodes whose children by object split
+// overlap by more than min_overlap times surface area of root. Number of
+// duplicated references is at most max_duplication times number of objects.
+//
+// Precondition:
+//   - 2 <= bin_count <= sah_split::max_bin_count
+struct sbvh_options {
+  int bin_count = 16;
+  double traversal_cost = 1.0;
+  double intersection_cost = 1.0;
+  double min_overlap = 1e-5;
+  double max_duplication = 0.5;
+};
+
+namespace __sbvh_details {
+struct spatial_split_t {
+  double cost = std::numeric_limits<double>::infinity();
+  int axis = -1;
+  double position = 0;
+};
+
+// Stich, Friedrich and Dietrich, "Spatial Splits in Bounding Volume
+// Hierarchies". Every node is split either by object (binned SAH over
+// centroids) or by a plane, in which case references straddling the plane
+// are clipped into both children.
+template <typename Object> struct builder {
+  std::vector<Object> const &objects;
+  sbvh_options options;
+  double root_area;
+  std::size_t duplication_budget;
+  std::vector<bvh_primitive_ref_t> ordered;
+  std::vector<bvh_node_t> nodes;
+
+  using refs_t = std::vector<bvh_primitive_ref_t>;
+
+  sah_split object_split() const {
+    return {options.bin_count, options.traversal_cost,
+            options.intersection_cost};
+  }
+
+  spatial_split_t find_spatial_split(refs_t const &refs,
+                                     bound_t const &node_bounds) const {
+    constexpr static auto max_bins =
+        static_cast<std::size_t>(sah_split::max_bin_count);
+    auto const num_bins = static_cast<std::size_t>(
+        std::clamp(options.bin_count, 2, sah_split::max_bin_count));
+    auto const node_area = surface_area(node_bounds);
+    auto const area_scale = node_area > 0 ? 1 / node_area : 1.0;
+    spatial_split_t res;
+    for (int axis = 0; axis < 3; ++axis) {
+      auto const &range = axis_range(node_bounds, axis);
+      auto const bin_size = size(range) / static_cast<double>(num_bins);
+      if (!(bin_size > 0))
+        continue;
+      auto bin_of = [&range, bin_size, num_bins](double x) {
+        auto const bin = static_cast<std::size_t>(
+            std::max((x - range.min) / bin_size, 0.0));
+        return std::min(bin, num_bins - 1);
+      };
+      auto boundary = [&range, bin_size](std::size_t bin) {
+        return range.min + bin_size * static_cast<double>(bin);
+      };
+
+      std::array<bound_t, max_bins> bin_bounds;
+      std::array<std::size_t, max_bins> entries{};
+      std::array<std::size_t, max_bins> exits{};
+      for (auto const &ref : refs) {
+        auto const &ref_range = axis_range(ref.bounds, axis);
+        auto const first = bin_of(ref_range.min);
+        auto const last = bin_of(ref_range.max);
+        auto rest = ref.bounds;
+        for (auto bin = first; bin < last; ++bin) {
+          auto const parts = split_object_bounds(
+              objects[ref.index], rest, axis, boundary(bin + 1));
+          bin_bounds[bin] = union_bounds(bin_bounds[bin], parts[0]);
+          rest = parts[1];
+        }
+        bin_bounds[last] = union_bounds(bin_bounds[last], rest);
+        ++entries[first];
+        ++exits[last];
+      }
+
+      // right_cost[i] contains cost contribution of bins [i + 1, num_bins)
+      std::array<double, max_bins> right_cost{};
+      std::array<std::size_t, max_bins> right_counts{};
+      bound_t right_bounds;
+      std::size_t right_count = 0;
+      for (auto bin = num_bins - 1; bin > 0; --bin) {
+        right_bounds = union_bounds(right_bounds, bin_bounds[bin]);
+        right_count += exits[bin];
+        right_counts[bin - 1] = right_count;
+        right_cost[bin - 1] =
+            surface_area(right_bounds) * static_cast<double>(right_count);
+      }
+
+      bound_t left_bounds;
+      std::size_t left_count = 0;
+      for (std::size_t bin = 0; bin + 1 < num_bins; ++bin) {
+        left_bounds = union_bounds(left_bounds, bin_bounds[bin]);
+        left_count += entries[bin];
+        if (left_count == 0 || right_counts[bin] == 0)
+          continue;
+        auto const cost =
+            options.traversal_cost +
+            options.intersection_cost * area_scale *
+                (surface_area(left_bounds) * static_cast<double>(left_count) +
+                 right_cost[bin]);
+        if (cost < res.cost)
+          res = {cost, axis, boundary(bin + 1)};
+      }
+    }
+    return res;
+  }
+
+  // Postcondition:
+  //   - returns children references of spatial split, empty if split
+  //     duplicates more references than budget allows or leaves a child
+  //     empty
+  std::array<refs_t, 2> split_spatially(refs_t const &refs,
+                                        spatial_split_t const &split) {
+    std::array<refs_t, 2> res;
+    for (auto const &ref : refs) {
+      auto const &range = axis_range(ref.bounds, split.axis);
+      if (range.max <= split.position) {
+        res[0].push_back(ref);
+      } else if (range.min >= split.position) {
+        res[1].push_back(ref);
+      } else {
+        auto const parts = split_object_bounds(objects[ref.index], ref.bounds,
+                                               split.axis, split.position);
+        for (std::size_t i = 0; i < 2; ++i) {
+          if (!is_empty(parts[i]))
+            res[i].push_back({parts[i], ref.index});
+        }
+      }
+    }
+    auto const num_refs = res[0].size() + res[1].size();
+    if (res[0].empty() || res[1].empty() ||
+        num_refs > refs.size() + duplication_budget)
+      return {};
+    if (num_refs > refs.size())
+      duplication_budget -= num_refs - refs.size();
+    return res;
+  }
+
+  std::array<refs_t, 2> split_by_object(refs_t &refs,
+                                        sah_split_candidate_t const &best) {
+    auto const mid =
+        best.axis == -1
+            ? median_split{}(refs.begin(), refs.end())
+            : std::partition(refs.begin(), refs.end(), [&best](auto &ref) {
+                return goes_left(best, ref.bounds);
+              });
+    return {refs_t(refs.begin(), mid), refs_t(mid, refs.end())};
+  }
+
+  // Postcondition:
+  //   - returns index of the root node of built subtree
+  std::uint32_t build(refs_t refs, std::size_t depth) {
+    auto const index = static_cast<std::uint32_t>(nodes.size());
+    nodes.push_back({});
+    bound_t node_bounds;
+    for (auto const &ref : refs) {
+      node_bounds = union_bounds(node_bounds, ref.bounds);
+    }
+    if (refs.size() == 1) {
+      nodes[index] = bvh_node_t{
+          .bounds = to_minmax_bound(node_bounds),
+          .offset = static_cast<std::uint32_t>(ordered.size()),
+          .count = 1,
+      };
+      ordered.push_back(refs.front());
+      return index;
+    }
+
+    std::array<refs_t, 2> children;
+    if (depth >= __bvh_build_details::max_split_depth) {
+      auto const mid = std::next(refs.begin(), std::ssize(refs) / 2);
+      children = {refs_t(refs.begin(), mid), refs_t(mid, refs.end())};
+    } else {
+      auto const best = object_split().best_split(refs.begin(), refs.end());
+      if (best.axis != -1 && duplication_budget > 0) {
+        bound_t left;
+        bound_t right;
+        for (auto const &ref : refs) {
+          auto &side = goes_left(best, ref.bounds) ? left : right;
+          side = union_bounds(side, ref.bounds);
+        }
+        auto const overlap = surface_area(intersect_bounds(left, right));
+        if (overlap > options.min_overlap * root_area) {
+          auto const spatial = find_spatial_split(refs, node_bounds);
+          if (spatial.cost < best.cost)
+            children = split_spatially(refs, spatial);
+        }
+      }
+      if (children[0].empty())
+        children = split_by_object(refs, best);
+    }
+    refs = {};
+    build(std::move(children[0]), depth + 1);
+    auto const right = build(std::move(children[1]), depth + 1);
+    nodes[index] = bvh_node_t{
+        .bounds = union_bounds(nodes[index + 1].bounds, nodes[right].bounds),
+        .offset = right,
+        .count = 0,
+    };
+    return index;
+  }
+};
+} // namespace __sbvh_details
+
+// Builds spatial split bvh over objects of rng. A node may be split by a
+// plane instead of by objects, putting objects crossing the plane in both
+// children with their bounds clipped to each side (see split_bounds). This
+// lowers overlap of children for large or long diagonal objects.
+//
+// Objects referred from more than one leaf are copied into every leaf, so
+// objects() of resulting bvh may contain an object more than once.
+//
+// Precondition:
+//   - std::ranges::size(rng) * (1 + options.max_duplication) < 2^32
+template <std::ranges::random_access_range Range>
+  requires BoundedObject<std::ranges::range_value_t<Range>> &&
+           std::copyable<std::ranges::range_value_t<Range>>
+bvh_t<std::ranges::range_value_t<Range>> build_sbvh(Range &&rng,
+                                                    sbvh_options options = {}) {
+  using object_type = std::ranges::range_value_t<Range>;
+  auto objects = to_object_vector<object_type>(std::forward<Range>(rng));
+  if (objects.empty())
+    return bvh_t<object_type>({}, {});
+  auto refs = make_primitive_refs(objects);
+  bound_t root_bounds;
+  for (auto const &ref : refs) {
+    root_bounds = union_bounds(root_bounds, ref.bounds);
+  }
+  auto const budget = static_cast<std::size_t>(
+      options.max_duplication * static_cast<double>(objects.size()));
+  __sbvh_details::builder<object_type> builder{
+      objects, options, surface_area(root_bounds), budget, {}, {}};
+  builder.build(std::move(refs), 0);
+
+  std::vector<object_type> leaf_objects;
+  leaf_objects.reserve(builder.ordered.size());
+  for (auto const &ref : builder.ordered) {
+    leaf_objects.push_back(objects[ref.index]);
+  }
+  return bvh_t<object_type>(std::move(leaf_objects), std::move(builder.nodes));
+}
+} // namespace mrl
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "bound.hpp"
+#include "point.hpp"
+#include "scene_objects/concepts.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+namespace mrl {
+// A split strategy decides how objects of a BVH node are divided between
+// its two children.
+//
+// Precondition:
+//   - split is invoked with [begin, end) having at least 2 objects
+//
+// Postcondition:
+//   - split may reorder objects in [begin, end)
+//   - returned iterator mid satisfies begin < mid < end
+template <typename Split, typename Iter>
+concept BvhSplitStrategy =
+    std::random_access_iterator<Iter> &&
+    Bounded<std::iter_value_t<Iter>> &&
+    requires(Split const &split, Iter begin, Iter end) {
+      { split(begin, end) } -> std::same_as<Iter>;
+    };
+
+// Bounds of objects of a node and of their centroids, what a split strategy
+// needs to know about a node before binning its objects.
+struct node_bounds_t {
+  bound_t bounds;
+  bound_t centroid_bounds;
+};
+
+constexpr node_bounds_t union_bounds(node_bounds_t const &a,
+                                     node_bounds_t const &b) {
+  return {union_bounds(a.bounds, b.bounds),
+          union_bounds(a.centroid_bounds, b.centroid_bounds)};
+}
+
+template <std::input_iterator Iter>
+  requires Bounded<std::iter_value_t<Iter>>
+constexpr node_bounds_t node_bounds_of(Iter begin, Iter end) {
+  node_bounds_t res;
+  for (auto it = begin; it != end; ++it) {
+    auto const bound = get_bounds(*it);
+    auto const center = centroid(bound);
+    res.bounds = union_bounds(res.bounds, bound);
+    res.centroid_bounds = union_bounds(
+        res.centroid_bounds, bound_from_diagonal_points(center, center));
+  }
+  return res;
+}
+
+// A split strategy that can be handed node bounds computed elsewhere, e.g. in
+// parallel chunks by a parallel build, instead of computing them itself.
+//
+// Postcondition:
+//   - split(begin, end, node_bounds_of(begin, end)) returns what
+//     split(begin, end) returns and reorders objects the same
+template <typename Split, typename Iter>
+concept NodeBoundsSplitStrategy =
+    BvhSplitStrategy<Split, Iter> &&
+    requires(Split const &split, Iter begin, Iter end,
+             node_bounds_t const &node_bounds) {
+      { split(begin, end, node_bounds) } -> std::same_as<Iter>;
+    };
+
+// Splits every node at its median object according to x_range.min of
+// object bounds.
+struct median_split {
+  template <std::random_access_iterator Iter>
+    requires Bounded<std::iter_value_t<Iter>>
+  constexpr Iter operator()(Iter begin, Iter end) const {
+    auto const mid = std::next(begin, std::distance(begin, end) / 2);
+    auto bound_x_min = [](auto const &obj) {
+      return get_bounds(obj).x_range.min;
+    };
+    std::ranges::nth_element(begin, mid, end, std::less<>{}, bound_x_min);
+    return mid;
+  }
+};
+
+// Candidate split found by sah_split. Objects whose centroid falls in bin
+// <= bin along axis go to left child.
+//
+// Class Invariant:
+//   - axis is -1 if no bin boundary can separate objects, e.g. when all
+//     centroids coincide
+struct sah_split_candidate_t {
+  double cost;
+  int axis;
+  int bin;
+  bound_t centroid_bounds;
+  int num_bins;
+};
+
+// Precondition:
+//   - candidate.axis is not -1
+//
+// Postcondition:
+//   - returns bin of centroid of bounds along axis of candidate
+constexpr int centroid_bin(sah_split_candidate_t const &candidate,
+                           bound_t const &bounds) {
+  auto const axis = candidate.axis;
+  auto const &range = axis_range(candidate.centroid_bounds, axis);
+  auto const scaled = candidate.num_bins *
+                      (component(centroid(bounds), axis) - range.min) /
+                      size(range);
+  return std::clamp(static_cast<int>(scaled), 0, candidate.num_bins - 1);
+}
+
+// Precondition:
+//   - candidate.axis is not -1
+//
+// Postcondition:
+//   - returns true if object with bounds goes to left child of candidate
+constexpr bool goes_left(sah_split_candidate_t const &candidate,
+                         bound_t const &bounds) {
+  return centroid_bin(candidate, bounds) <= candidate.bin;
+}
+
+// Binned Surface Area Heuristic split.
+//
+// Object centroids of a node are distributed in bin_count equal width bins
+// along every axis and the bin boundary with least estimated cost is chosen.
+// Cost of splitting a node with bounds B into children L and R is:
+//   traversal_cost + intersection_cost * (SA(L) * |L| + SA(R) * |R|) / SA(B)
+//
+// Class Invariant:
+//   - 2 <= bin_count <= max_bin_count
+struct sah_split {
+  constexpr static int max_bin_count = 256;
+
+  int bin_count = 16;
+  double traversal_cost = 1.0;
+  double intersection_cost = 1.0;
+
+  // Precondition:
+  //   - [begin, end) has at least 2 objects
+  //
+  // Postcondition:
+  //   - returns split of [begin, end) with least cost
+  template <std::random_access_iterator Iter>
+    requires Bounded<std::iter_value_t<Iter>>
+  sah_split_candidate_t best_split(Iter begin, Iter end) const {
+    std::vector<bound_t> bounds;
+    bounds.reserve(static_cast<std::size_t>(std::distance(begin, end)));
+    node_bounds_t node_bounds;
+    for (auto it = begin; it != end; ++it) {
+      auto const bound = get_bounds(*it);
+      auto const center = centroid(bound);
+      node_bounds.bounds = union_bounds(node_bounds.bounds, bound);
+      node_bounds.centroid_bounds =
+          union_bounds(node_bounds.centroid_bounds,
+                       bound_from_diagonal_points(center, center));
+      bounds.push_back(bound);
+    }
+    return best_split_of(bounds, node_bounds);
+  }
+
+  // Precondition:
+  //   - [begin, end) has at least 2 objects
+  //   - node_bounds is node_bounds_of(begin, end)
+  //
+  // Postcondition:
+  //   - returns split of [begin, end) with least cost
+  template <std::random_access_iterator Iter>
+    requires Bounded<std::iter_value_t<Iter>>
+  sah_split_candidate_t best_split(Iter begin, Iter end,
+                                   node_bounds_t const &node_bounds) const {
+    std::vector<bound_t> bounds;
+    bounds.reserve(static_cast<std::size_t>(std::distance(begin, end)));
+    for (auto it = begin; it != end; ++it) {
+      bounds.push_back(get_bounds(*it));
+    }
+    return best_split_of(bounds, node_bounds);
+  }
+
+  // Precondition:
+  //   - bounds has bounds of at least 2 objects
+  //   - node_bounds is node bounds of those objects
+  //
+  // Postcondition:
+  //   - returns split of objects with least cost
+  sah_split_candidate_t best_split_of(std::vector<bound_t> const &bounds,
+                                      node_bounds_t const &node_bounds) const {
+    auto const n = bounds.size();
+    auto const num_bins = std::clamp(bin_count, 2, max_bin_count);
+    sah_split_candidate_t res{
+        .cost = std::numeric_limits<double>::infinity(),
+        .axis = -1,
+        .bin = -1,
+        .centroid_bounds = node_bounds.centroid_bounds,
+        .num_bins = num_bins,
+    };
+
+    auto const node_area = surface_area(node_bounds.bounds);
+    auto const area_scale = node_area > 0 ? 1 / node_area : 1.0;
+    for (int axis = 0; axis < 3; ++axis) {
+      if (!(size(axis_range(res.centroid_bounds, axis)) > 0))
+        continue;
+      auto candidate = res;
+      candidate.axis = axis;
+      std::array<bound_t, max_bin_count> bin_bounds;
+      std::array<std::size_t, max_bin_count> bin_counts{};
+      for (auto const &bound : bounds) {
+        auto const bin =
+            static_cast<std::size_t>(centroid_bin(candidate, bound));
+        bin_bounds[bin] = union_bounds(bin_bounds[bin], bound);
+        ++bin_counts[bin];
+      }
+
+      // right_cost[i] contains cost contribution of bins [i + 1, num_bins)
+      std::array<double, max_bin_count> right_cost{};
+      bound_t right_bounds;
+      std::size_t right_count = 0;
+      for (int i = num_bins - 1; i > 0; --i) {
+        auto const bin = static_cast<std::size_t>(i);
+        right_bounds = union_bounds(right_bounds, bin_bounds[bin]);
+        right_count += bin_counts[bin];
+        right_cost[bin - 1] =
+            surface_area(right_bounds) * static_cast<double>(right_count);
+      }
+
+      bound_t left_bounds;
+      std::size_t left_count = 0;
+      for (int i = 0; i < num_bins - 1; ++i) {
+        auto const bin = static_cast<std::size_t>(i);
+        left_bounds = union_bounds(left_bounds, bin_bounds[bin]);
+        left_count += bin_counts[bin];
+        if (left_count == 0 || left_count == n)
+          continue;
+        auto const cost =
+            traversal_cost +
+            intersection_cost * area_scale *
+                (surface_area(left_bounds) * static_cast<double>(left_count) +
+                 right_cost[bin]);
+        if (cost < res.cost) {
+          res.cost = cost;
+          res.axis = axis;
+          res.bin = i;
+        }
+      }
+    }
+    return res;
+  }
+
+  template <std::random_access_iterator Iter>
+    requires Bounded<std::iter_value_t<Iter>>
+  Iter operator()(Iter begin, Iter end) const {
+    return split_at(begin, end, best_split(begin, end));
+  }
+
+  // Precondition:
+  //   - node_bounds is node_bounds_of(begin, end)
+  template <std::random_access_iterator Iter>
+    requires Bounded<std::iter_value_t<Iter>>
+  Iter operator()(Iter begin, Iter end,
+                  node_bounds_t const &node_bounds) const {
+    return split_at(begin, end, best_split(begin, end, node_bounds));
+  }
+
+private:
+  template <std::random_access_iterator Iter>
+  static Iter split_at(Iter begin, Iter end,
+                       sah_split_candidate_t const &best) {
+    if (best.axis == -1) {
+      // All centroids coincide, no bin boundary can separate objects.
+      return median_split{}(begin, end);
+    }
+    return std::partition(begin, end, [&best](auto const &obj) {
+      return goes_left(best, get_bounds(obj));
+    });
+  }
+};
+} // namespace mrl
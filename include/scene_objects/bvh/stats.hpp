@@ -0,0 +1,155 @@
+#pragma once
+
+#include "bound.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/cost.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mrl {
+// Structure and quality of a built bvh, to tell whether slow hits come from
+// the tree or from objects in it.
+struct bvh_stats_t {
+  std::size_t num_nodes = 0;
+  std::size_t num_leaves = 0;
+  std::size_t num_objects = 0;
+  // Depth of root is 0.
+  std::size_t max_depth = 0;
+  double average_leaf_depth = 0;
+  // leaf_size_histogram[i] is number of leaves having i objects.
+  std::vector<std::size_t> leaf_size_histogram;
+  // See mrl::sah_cost.
+  double sah_cost = 0;
+  // Mean over interior nodes of SA(intersection of children) / SA(node). 0
+  // means siblings never overlap, 1 means they coincide.
+  double sibling_overlap = 0;
+  // Bytes of node and object arrays. Memory owned by objects themselves (like
+  // any_scene_object's model) is not counted.
+  std::size_t node_bytes = 0;
+  std::size_t object_bytes = 0;
+};
+
+constexpr std::size_t memory_bytes(bvh_stats_t const &stats) {
+  return stats.node_bytes + stats.object_bytes;
+}
+
+// Postcondition:
+//   - object_bytes of returned stats is 0
+inline bvh_stats_t bvh_stats(std::vector<bvh_node_t> const &nodes) {
+  struct pending_node {
+    std::uint32_t index;
+    std::size_t depth;
+  };
+
+  bvh_stats_t stats;
+  stats.num_nodes = nodes.size();
+  stats.node_bytes = nodes.capacity() * sizeof(bvh_node_t);
+  stats.sah_cost = sah_cost(nodes);
+  if (nodes.empty())
+    return stats;
+  std::size_t total_leaf_depth = 0;
+  std::size_t num_interior = 0;
+  double total_overlap = 0;
+  std::array<pending_node, bvh_max_depth + 1> to_visit;
+  std::size_t num_to_visit = 0;
+  to_visit[num_to_visit++] = {0, 0};
+  while (num_to_visit > 0) {
+    auto const [index, depth] = to_visit[--num_to_visit];
+    auto const &node = nodes[index];
+    stats.max_depth = std::max(stats.max_depth, depth);
+    if (is_leaf(node)) {
+      ++stats.num_leaves;
+      stats.num_objects += node.count;
+      total_leaf_depth += depth;
+      if (stats.leaf_size_histogram.size() <= node.count)
+        stats.leaf_size_histogram.resize(node.count + 1);
+      ++stats.leaf_size_histogram[node.count];
+      continue;
+    }
+    ++num_interior;
+    auto const left = to_bound(nodes[index + 1].bounds);
+    auto const right = to_bound(nodes[node.offset].bounds);
+    auto const area = surface_area(to_bound(node.bounds));
+    auto const overlap = intersect_bounds(left, right);
+    if (area > 0 && !is_empty(overlap))
+      total_overlap += surface_area(overlap) / area;
+    to_visit[num_to_visit++] = {node.offset, depth + 1};
+    to_visit[num_to_visit++] = {index + 1, depth + 1};
+  }
+  stats.average_leaf_depth = static_cast<double>(total_leaf_depth) /
+                             static_cast<double>(stats.num_leaves);
+  if (num_interior > 0)
+    stats.sibling_overlap = total_overlap / static_cast<double>(num_interior);
+  return stats;
+}
+
+template <typename Object> bvh_stats_t bvh_stats(bvh_t<Object> const &bvh) {
+  auto stats = bvh_stats(bvh.nodes());
+  stats.object_bytes = bvh.objects().capacity() * sizeof(Object);
+  return stats;
+}
+
+inline std::ostream &operator<<(std::ostream &os, bvh_stats_t const &stats) {
+  os << "nodes: " << stats.num_nodes << " (" << stats.num_leaves
+     << " leaves)\n"
+     << "objects: " << stats.num_objects << '\n'
+     << "depth: max " << stats.max_depth << " , average leaf "
+     << stats.average_leaf_depth << '\n'
+     << "sah cost: " << stats.sah_cost << '\n'
+     << "sibling overlap: " << stats.sibling_overlap << '\n'
+     << "memory: " << memory_bytes(stats) << " bytes (nodes "
+     << stats.node_bytes << " , objects " << stats.object_bytes << ")\n"
+     << "leaf sizes:\n";
+  for (std::size_t i = 0; i < stats.leaf_size_histogram.size(); ++i) {
+    if (stats.leaf_size_histogram[i] > 0)
+      os << "  " << i << ": " << stats.leaf_size_histogram[i] << '\n';
+  }
+  return os;
+}
+
+namespace __bvh_stats_details {
+// JSON has no NaN or infinity, they are written as null.
+struct json_number {
+  double value;
+
+  friend std::ostream &operator<<(std::ostream &os, json_number const &x) {
+    if (std::isfinite(x.value))
+      return os << x.value;
+    return os << "null";
+  }
+};
+} // namespace __bvh_stats_details
+
+// Postcondition:
+//   - returns stats as a single line JSON object, keys are names of members
+//     of bvh_stats_t with memory_bytes added
+//   - members that are not finite, e.g. ratios over a root of no area, are
+//     null
+inline std::string to_json(bvh_stats_t const &stats) {
+  using __bvh_stats_details::json_number;
+  std::ostringstream os;
+  os << "{\"num_nodes\":" << stats.num_nodes
+     << ",\"num_leaves\":" << stats.num_leaves
+     << ",\"num_objects\":" << stats.num_objects
+     << ",\"max_depth\":" << stats.max_depth
+     << ",\"average_leaf_depth\":" << json_number{stats.average_leaf_depth}
+     << ",\"leaf_size_histogram\":[";
+  for (std::size_t i = 0; i < stats.leaf_size_histogram.size(); ++i) {
+    os << (i == 0 ? "" : ",") << stats.leaf_size_histogram[i];
+  }
+  os << "],\"sah_cost\":" << json_number{stats.sah_cost}
+     << ",\"sibling_overlap\":" << json_number{stats.sibling_overlap}
+     << ",\"node_bytes\":" << stats.node_bytes
+     << ",\"object_bytes\":" << stats.object_bytes
+     << ",\"memory_bytes\":" << memory_bytes(stats) << '}';
+  return os.str();
+}
+} // namespace mrl
@@ -0,0 +1,283 @@
+#pragma once
+
+#include "bound.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "stdexec/execution.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace mrl {
+// SAH cost of a bvh before and after restructuring its treelets, see
+// mrl::sah_cost.
+struct treelet_report_t {
+  double sah_cost_before;
+  double sah_cost_after;
+};
+
+namespace __treelet_details {
+constexpr static std::size_t max_treelet_leaves = 7;
+constexpr static std::size_t num_subsets = std::size_t{1}
+                                           << max_treelet_leaves;
+constexpr static std::size_t num_passes = 3;
+constexpr static std::size_t num_batches = num_passes * max_treelet_leaves;
+constexpr static std::size_t num_root_chunks = 64;
+
+// Node of a bvh with explicit children, so that topology can be changed in
+// place.
+//
+// Class Invariant:
+//   - node is a leaf iff count > 0
+struct linked_node_t {
+  bound_t bounds;
+  std::uint32_t left;
+  std::uint32_t right;
+  std::uint32_t offset;
+  std::uint32_t count;
+};
+
+// Karras and Aila, "Fast Parallel Construction of High-Quality Bounding
+// Volume Hierarchies". Treelet of a node is grown by repeatedly expanding its
+// leaf with largest surface area, up to max_treelet_leaves leaves, and its
+// topology is replaced by the one with least SAH cost found by dynamic
+// programming over subsets of its leaves.
+//
+// Treelets are restructured in batches. A treelet has at most
+// max_treelet_leaves - 1 levels of interior nodes, so treelets rooted at
+// depths equal modulo max_treelet_leaves never share interior nodes and a
+// batch restructures all of them in parallel.
+//
+// Class Invariant:
+//   - nodes[0] is root
+struct state_t {
+  std::vector<linked_node_t> nodes;
+  std::vector<std::uint32_t> depth;
+  std::vector<std::uint32_t> height;
+  std::vector<std::uint32_t> roots;
+  std::uint32_t max_growth = 0;
+
+  explicit state_t(std::vector<bvh_node_t> const &flat)
+      : nodes(flat.size()), depth(flat.size()), height(flat.size()) {
+    for (std::size_t i = 0; i < flat.size(); ++i) {
+      auto const &node = flat[i];
+      nodes[i] = {to_bound(node.bounds), static_cast<std::uint32_t>(i + 1),
+                  node.offset, node.offset, node.count};
+    }
+  }
+
+  bool is_leaf(std::uint32_t i) const { return nodes[i].count > 0; }
+
+  // Postcondition:
+  //   - roots are interior nodes at depth congruent to residue modulo
+  //     max_treelet_leaves
+  //   - max_growth is how much a treelet of batch may grow in height without
+  //     making any path longer than bvh_max_depth
+  void prepare_batch(std::size_t residue) {
+    roots.clear();
+    if (nodes.empty())
+      return;
+    std::vector<std::uint32_t> preorder;
+    preorder.reserve(nodes.size());
+    std::vector<std::uint32_t> to_visit{0};
+    depth[0] = 0;
+    while (!to_visit.empty()) {
+      auto const cur = to_visit.back();
+      to_visit.pop_back();
+      preorder.push_back(cur);
+      if (is_leaf(cur))
+        continue;
+      if (depth[cur] % max_treelet_leaves == residue)
+        roots.push_back(cur);
+      for (auto child : {nodes[cur].left, nodes[cur].right}) {
+        depth[child] = depth[cur] + 1;
+        to_visit.push_back(child);
+      }
+    }
+    for (auto it = preorder.rbegin(); it != preorder.rend(); ++it) {
+      auto const &node = nodes[*it];
+      height[*it] = is_leaf(*it)
+                        ? 0
+                        : 1 + std::max(height[node.left], height[node.right]);
+    }
+    // A path passes through at most paths treelets of batch.
+    auto const tree_height = std::size_t{height[0]};
+    auto const paths = tree_height / max_treelet_leaves + 1;
+    auto const room =
+        tree_height < bvh_max_depth ? bvh_max_depth - 1 - tree_height : 0;
+    max_growth = static_cast<std::uint32_t>(room / paths);
+  }
+
+  void restructure_chunk(std::size_t chunk) {
+    auto const first = chunk * roots.size() / num_root_chunks;
+    auto const last = (chunk + 1) * roots.size() / num_root_chunks;
+    for (auto i = first; i < last; ++i) {
+      restructure(roots[i]);
+    }
+  }
+
+  void restructure(std::uint32_t root) {
+    std::array<std::uint32_t, max_treelet_leaves> leaves;
+    std::array<std::uint32_t, max_treelet_leaves - 1> interior;
+    std::size_t num_leaves = 0;
+    std::size_t num_interior = 0;
+    interior[num_interior++] = root;
+    leaves[num_leaves++] = nodes[root].left;
+    leaves[num_leaves++] = nodes[root].right;
+    while (num_leaves < max_treelet_leaves) {
+      auto largest = num_leaves;
+      auto largest_area = -1.0;
+      for (std::size_t i = 0; i < num_leaves; ++i) {
+        auto const area = surface_area(nodes[leaves[i]].bounds);
+        if (!is_leaf(leaves[i]) && area > largest_area) {
+          largest = i;
+          largest_area = area;
+        }
+      }
+      if (largest == num_leaves)
+        break;
+      auto const expanded = leaves[largest];
+      interior[num_interior++] = expanded;
+      leaves[largest] = nodes[expanded].left;
+      leaves[num_leaves++] = nodes[expanded].right;
+    }
+    if (num_leaves < 3)
+      return;
+
+    // Cost of a subset of leaves is sum of surface areas of interior nodes
+    // of its best topology. Costs of leaves themselves are same for every
+    // topology, so they are left out.
+    std::array<bound_t, num_subsets> subset_bounds;
+    std::array<double, num_subsets> cost;
+    std::array<std::uint32_t, num_subsets> subset_height;
+    std::array<std::uint8_t, num_subsets> partition;
+    auto const full = (std::size_t{1} << num_leaves) - 1;
+    for (std::size_t subset = 1; subset <= full; ++subset) {
+      auto const lowest = subset & (~subset + 1);
+      if (subset == lowest) {
+        auto const leaf = leaves[std::bit_width(subset) - 1];
+        subset_bounds[subset] = nodes[leaf].bounds;
+        cost[subset] = 0;
+        subset_height[subset] = height[leaf];
+        continue;
+      }
+      subset_bounds[subset] =
+          union_bounds(subset_bounds[lowest], subset_bounds[subset ^ lowest]);
+      auto best = std::numeric_limits<double>::infinity();
+      // Only parts containing lowest leaf, so every partition is seen once.
+      for (auto part = (subset - 1) & subset; part > 0;
+           part = (part - 1) & subset) {
+        if ((part & lowest) == 0)
+          continue;
+        auto const part_cost = cost[part] + cost[subset ^ part];
+        if (part_cost < best) {
+          best = part_cost;
+          partition[subset] = static_cast<std::uint8_t>(part);
+        }
+      }
+      auto const part = std::size_t{partition[subset]};
+      cost[subset] = surface_area(subset_bounds[subset]) + best;
+      subset_height[subset] =
+          1 + std::max(subset_height[part], subset_height[subset ^ part]);
+    }
+
+    double old_cost = 0;
+    for (std::size_t i = 0; i < num_interior; ++i) {
+      old_cost += surface_area(nodes[interior[i]].bounds);
+    }
+    if (!(cost[full] < old_cost) ||
+        subset_height[full] > height[root] + max_growth)
+      return;
+
+    // Interior nodes of treelet are reused, root first, so parent of treelet
+    // still refers to root.
+    std::size_t next_interior = 0;
+    auto emit = [&](auto &self, std::size_t subset) -> std::uint32_t {
+      if (std::has_single_bit(subset))
+        return leaves[std::bit_width(subset) - 1];
+      auto const index = interior[next_interior++];
+      auto const part = std::size_t{partition[subset]};
+      auto const left = self(self, part);
+      auto const right = self(self, subset ^ part);
+      nodes[index].left = left;
+      nodes[index].right = right;
+      nodes[index].bounds = subset_bounds[subset];
+      return index;
+    };
+    emit(emit, full);
+  }
+
+  // Appends subtree rooted at index in depth first order.
+  //
+  // Postcondition:
+  //   - returns index of root of appended subtree
+  std::uint32_t flatten(std::vector<bvh_node_t> &flat,
+                        std::uint32_t index) const {
+    auto const &node = nodes[index];
+    auto const root = static_cast<std::uint32_t>(flat.size());
+    flat.push_back(bvh_node_t{
+        .bounds = to_minmax_bound(node.bounds),
+        .offset = node.offset,
+        .count = node.count,
+    });
+    if (is_leaf(index))
+      return root;
+    flatten(flat, node.left);
+    flat[root].offset = flatten(flat, node.right);
+    return root;
+  }
+
+  std::vector<bvh_node_t> flatten() const {
+    std::vector<bvh_node_t> flat;
+    flat.reserve(nodes.size());
+    if (!nodes.empty())
+      flatten(flat, 0);
+    return flat;
+  }
+};
+
+// Deeper treelets of every band of max_treelet_leaves levels are
+// restructured first.
+constexpr std::size_t batch_residue(std::size_t batch) {
+  return max_treelet_leaves - 1 - batch % max_treelet_leaves;
+}
+
+template <std::size_t batch, typename Sender>
+auto restructure_batches(Sender &&sender) {
+  if constexpr (batch == num_batches) {
+    return std::forward<Sender>(sender);
+  } else {
+    return restructure_batches<batch + 1>(
+        std::forward<Sender>(sender) |
+        stdexec::bulk(1,
+                      [](std::size_t, state_t &state) {
+                        state.prepare_batch(batch_residue(batch));
+                      }) |
+        stdexec::bulk(num_root_chunks, [](std::size_t chunk, state_t &state) {
+          state.restructure_chunk(chunk);
+        }));
+  }
+}
+} // namespace __treelet_details
+
+// Precondition:
+//   - nodes form a bvh as described by bvh_node_t
+//
+// Postcondition:
+//   - nodes form a bvh with same leaves and SAH cost not more than before
+inline void restructure_treelets(std::vector<bvh_node_t> &nodes) {
+  using namespace __treelet_details;
+  state_t state(nodes);
+  for (std::size_t batch = 0; batch < num_batches; ++batch) {
+    state.prepare_batch(batch_residue(batch));
+    for (auto root : state.roots) {
+      state.restructure(root);
+    }
+  }
+  nodes = state.flatten();
+}
+} // namespace mrl
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "scene_objects/bvh/node.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mrl {
+// Partition of nodes of a bvh into treelets, connected parts of the tree
+// whose nodes and objects fit in a cache of a given size.
+//
+// Class Invariant:
+//   - treelet_of[i] is treelet node i belongs to, treelets being numbered
+//     0 to num_treelets - 1 in depth first order of their roots, root of bvh
+//     being in treelet 0
+struct bvh_treelet_partition_t {
+  std::vector<std::uint32_t> treelet_of;
+  std::uint32_t num_treelets = 0;
+};
+
+// Packs nodes into treelets bottom up. Every node joins treelets of its
+// children to its own, and when they would not fit in max_treelet_bytes
+// together, the larger child (and if still needed, the other one as well) is
+// left as root of a treelet of its own. So every treelet but the top one is
+// filled at least about half. A treelet takes sizeof(bvh_node_t) bytes for
+// every node and bytes_per_object for every object of its leaves, a leaf
+// larger than max_treelet_bytes being a treelet by itself.
+inline bvh_treelet_partition_t
+partition_treelets(std::vector<bvh_node_t> const &nodes,
+                   std::size_t bytes_per_object,
+                   std::size_t max_treelet_bytes) {
+  bvh_treelet_partition_t res;
+  res.treelet_of.resize(nodes.size());
+  if (nodes.empty())
+    return res;
+  // bytes[i] is size of part of treelet of node i below it.
+  std::vector<std::size_t> bytes(nodes.size());
+  std::vector<bool> is_root(nodes.size());
+  is_root[0] = true;
+  for (auto i = nodes.size(); i > 0; --i) {
+    auto const index = i - 1;
+    auto const &node = nodes[index];
+    if (is_leaf(node)) {
+      bytes[index] = sizeof(bvh_node_t) + node.count * bytes_per_object;
+      continue;
+    }
+    auto const left = index + 1;
+    auto const right = std::size_t{node.offset};
+    auto const larger = bytes[left] >= bytes[right] ? left : right;
+    auto const smaller = larger == left ? right : left;
+    auto size = sizeof(bvh_node_t) + bytes[left] + bytes[right];
+    for (auto child : {larger, smaller}) {
+      if (size <= max_treelet_bytes)
+        break;
+      is_root[child] = true;
+      size -= bytes[child];
+    }
+    bytes[index] = size;
+  }
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    if (is_root[i])
+      res.treelet_of[i] = res.num_treelets++;
+    auto const &node = nodes[i];
+    if (is_leaf(node))
+      continue;
+    for (auto child : {i + 1, std::size_t{node.offset}}) {
+      if (!is_root[child])
+        res.treelet_of[child] = res.treelet_of[i];
+    }
+  }
+  return res;
+}
+} // namespace mrl
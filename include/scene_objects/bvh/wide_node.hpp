@@ -0,0 +1,146 @@
+#pragma once
+
+#include "bound.hpp"
+#include "interval.hpp"
+#include "prepared_ray.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mrl {
+// Node of a wide bvh having up to Width children. Child bounds are stored in
+// structure of arrays form, so that all children can be tested against a ray
+// with the same instructions on every lane.
+//
+// Child i:
+//   - is absent if i >= num_children
+//   - is an interior node at index child[i] if count[i] is 0
+//   - is a leaf containing objects [child[i], child[i] + count[i]) otherwise
+template <std::size_t Width> struct alignas(64) wide_bvh_node_t {
+  std::array<double, Width> min_x{};
+  std::array<double, Width> min_y{};
+  std::array<double, Width> min_z{};
+  std::array<double, Width> max_x{};
+  std::array<double, Width> max_y{};
+  std::array<double, Width> max_z{};
+  std::array<std::uint32_t, Width> child{};
+  std::array<std::uint32_t, Width> count{};
+  std::uint32_t num_children{0};
+};
+
+template <std::size_t Width>
+constexpr void set_child_bounds(wide_bvh_node_t<Width> &node, std::size_t i,
+                                bound_t const &bounds) {
+  node.min_x[i] = bounds.x_range.min;
+  node.min_y[i] = bounds.y_range.min;
+  node.min_z[i] = bounds.z_range.min;
+  node.max_x[i] = bounds.x_range.max;
+  node.max_y[i] = bounds.y_range.max;
+  node.max_z[i] = bounds.z_range.max;
+}
+
+// Branchless slab test of all children at once, see clip_interval.
+//
+// Postcondition:
+//   - bit i of returned mask is set iff child i is present and
+//     ray origin + t * direction lies inside its bounds for some t in interval
+template <std::size_t Width>
+constexpr std::uint32_t hit_children(wide_bvh_node_t<Width> const &node,
+                                     prepared_ray_t const &ray,
+                                     interval_t const &interval) {
+  using namespace __details;
+  constexpr double far_scale = 1 + 2 * gamma_3;
+  std::array<double, Width> t_near;
+  std::array<double, Width> t_far;
+  t_near.fill(interval.min);
+  t_far.fill(interval.max);
+  auto slab = [&t_near, &t_far](std::array<double, Width> const &near,
+                                std::array<double, Width> const &far, double o,
+                                double inv_d) {
+    for (std::size_t i = 0; i < Width; ++i) {
+      t_near[i] = max_ignore_nan((near[i] - o) * inv_d, t_near[i]);
+      t_far[i] = min_ignore_nan((far[i] - o) * inv_d * far_scale, t_far[i]);
+    }
+  };
+  auto const &sign = ray.sign;
+  slab(sign[0] ? node.max_x : node.min_x, sign[0] ? node.min_x : node.max_x,
+       ray.origin.x, ray.inv_direction.x);
+  slab(sign[1] ? node.max_y : node.min_y, sign[1] ? node.min_y : node.max_y,
+       ray.origin.y, ray.inv_direction.y);
+  slab(sign[2] ? node.max_z : node.min_z, sign[2] ? node.min_z : node.max_z,
+       ray.origin.z, ray.inv_direction.z);
+  std::uint32_t mask = 0;
+  for (std::size_t i = 0; i < Width; ++i) {
+    mask |= static_cast<std::uint32_t>(t_near[i] <= t_far[i]) << i;
+  }
+  auto const present = (std::uint64_t{1} << node.num_children) - 1;
+  return mask & static_cast<std::uint32_t>(present);
+}
+
+// Postcondition:
+//   - returns nodes of a wide bvh having same leaves as binary bvh nodes
+//   - root of wide bvh is at index 0
+template <std::size_t Width>
+  requires(Width >= 2 && Width <= 32)
+std::vector<wide_bvh_node_t<Width>>
+collapse_bvh_nodes(std::vector<bvh_node_t> const &nodes) {
+  std::vector<wide_bvh_node_t<Width>> res;
+  if (nodes.empty())
+    return res;
+
+  // Fills wide node at index wide_index with children of binary node at
+  // binary_index, expanding the largest interior child until Width children
+  // are collected.
+  auto collapse = [&nodes, &res](auto &self, std::size_t wide_index,
+                                 std::uint32_t binary_index) -> void {
+    std::array<std::uint32_t, Width> children;
+    std::size_t num_children = 0;
+    auto const &root = nodes[binary_index];
+    if (is_leaf(root)) {
+      children[num_children++] = binary_index;
+    } else {
+      children[num_children++] = binary_index + 1;
+      children[num_children++] = root.offset;
+    }
+    while (num_children < Width) {
+      auto largest = num_children;
+      auto largest_area = -1.0;
+      for (std::size_t i = 0; i < num_children; ++i) {
+        auto const &child = nodes[children[i]];
+        auto const area = surface_area(to_bound(child.bounds));
+        if (!is_leaf(child) && area > largest_area) {
+          largest = i;
+          largest_area = area;
+        }
+      }
+      if (largest == num_children)
+        break;
+      auto const expanded = children[largest];
+      children[largest] = expanded + 1;
+      children[num_children++] = nodes[expanded].offset;
+    }
+
+    for (std::size_t i = 0; i < num_children; ++i) {
+      auto const &child = nodes[children[i]];
+      set_child_bounds(res[wide_index], i, to_bound(child.bounds));
+      if (is_leaf(child)) {
+        res[wide_index].child[i] = child.offset;
+        res[wide_index].count[i] = child.count;
+      } else {
+        auto const child_index = res.size();
+        res.emplace_back();
+        res[wide_index].child[i] = static_cast<std::uint32_t>(child_index);
+        self(self, child_index, children[i]);
+      }
+    }
+    res[wide_index].num_children = static_cast<std::uint32_t>(num_children);
+  };
+  res.emplace_back();
+  collapse(collapse, 0, 0);
+  return res;
+}
+} // namespace mrl
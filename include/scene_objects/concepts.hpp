@@ -8,8 +8,15 @@
 #include "materials/scatter_info.hpp"
 #include "point.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
 #include "scale_2d.hpp"
 #include "scene_objects/traits.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <utility>
 
 namespace mrl {
 template <typename Object, typename Generator>
@@ -40,7 +47,211 @@ template <typename Object>
 concept SceneObject = Hittable<Object>;
 
 template <typename Object>
-concept BoundedObject = SceneObject<Object> && requires(Object const &obj) {
+concept Bounded = requires(Object const &obj) {
   { get_bounds(obj) } -> std::same_as<bound_t>;
 };
+
+template <typename Object>
+concept BoundedObject = SceneObject<Object> && Bounded<Object>;
+
+// Precondition:
+//   - bounds encloses some part of obj
+//
+// Postcondition:
+//   - split_bounds(obj, bounds, axis, position) returns bounds of parts of obj
+//     inside bounds on either side of plane where axis'th coordinate is
+//     position, either of them may be empty
+template <typename Object>
+concept BoundsSplittable = requires(Object const &obj, bound_t const &bounds,
+                                    int axis, double position) {
+  {
+    split_bounds(obj, bounds, axis, position)
+  } -> std::same_as<std::array<bound_t, 2>>;
+};
+
+// Uses split_bounds for objects supporting it and otherwise splits bounds
+// itself at the plane.
+template <typename Object>
+constexpr std::array<bound_t, 2> split_object_bounds(Object const &obj,
+                                                     bound_t const &bounds,
+                                                     int axis,
+                                                     double position) {
+  if constexpr (BoundsSplittable<Object>) {
+    return split_bounds(obj, bounds, axis, position);
+  } else {
+    std::array<bound_t, 2> res{bounds, bounds};
+    auto &left = axis_range(res[0], axis);
+    auto &right = axis_range(res[1], axis);
+    left.max = std::min(left.max, position);
+    right.min = std::max(right.min, position);
+    return res;
+  }
+}
+
+// Postcondition:
+//   - occluded(obj, ray, interval) is true iff hit(obj, ray, interval) has a
+//     value
+//   - stops at first hit found and builds no hit object
+template <typename Object>
+concept Occludable =
+    requires(Object const &obj, ray_t const &ray, interval_t const &interval) {
+      { occluded(obj, ray, interval) } -> std::same_as<bool>;
+    };
+
+// Uses occluded for objects supporting it and falls back to hit otherwise.
+template <SceneObject Object>
+constexpr bool is_occluded(Object const &obj, ray_t const &ray,
+                           interval_t const &interval) {
+  if constexpr (Occludable<Object>) {
+    return occluded(obj, ray, interval);
+  } else {
+    return hit(obj, ray, interval).has_value();
+  }
+}
+
+// Objects whose hits can be found by distance alone, their hit object being
+// built afterwards only for the closest hit, e.g. by a bvh after traversing.
+//
+// Postcondition:
+//   - intersect(obj, ray, interval) is hit distance of hit(obj, ray,
+//     interval) if it has a value and nullopt otherwise, built without any
+//     hit object
+//   - hit_object_at(obj, ray, interval, t) for t intersect(obj, ray,
+//     interval) returned is hit object of hit(obj, ray, interval)
+template <typename Object>
+concept DeferredHittable =
+    Hittable<Object> && requires(Object const &obj, ray_t const &ray,
+                                 interval_t const &interval, double t) {
+      { intersect(obj, ray, interval) } -> std::same_as<std::optional<double>>;
+      {
+        hit_object_at(obj, ray, interval, t)
+      } -> std::same_as<hit_object_t<Object>>;
+    };
+
+// DeferredHittable objects telling at run time by is_deferred(obj) whether
+// their hit objects are built by hit_object_at without hitting them again.
+// Type erased objects holding objects that are not DeferredHittable, e.g.
+// bvhs, return false, as they are better hit by hit alone.
+template <typename Object>
+concept ConditionallyDeferredHittable =
+    DeferredHittable<Object> && requires(Object const &obj) {
+      { is_deferred(obj) } -> std::same_as<bool>;
+    };
+
+// Postcondition:
+//   - returns if hit object of obj is better built by hit_object_at after
+//     intersect than by hit
+template <DeferredHittable Object>
+constexpr bool defers_hit_object(Object const &obj) {
+  if constexpr (ConditionallyDeferredHittable<Object>) {
+    return is_deferred(obj);
+  } else {
+    return true;
+  }
+}
+
+// Uses intersect for objects supporting it and falls back to hit otherwise.
+template <SceneObject Object>
+constexpr std::optional<double> intersection_distance(
+    Object const &obj, ray_t const &ray, interval_t const &interval) {
+  if constexpr (DeferredHittable<Object>) {
+    return intersect(obj, ray, interval);
+  } else {
+    auto hit_rec = hit(obj, ray, interval);
+    if (!hit_rec)
+      return std::nullopt;
+    return hit_rec->hit_distance;
+  }
+}
+
+// Uses hit_object_at for objects supporting it and otherwise hits obj again
+// with same interval.
+//
+// Precondition:
+//   - t is intersection_distance(obj, ray, interval)
+template <SceneObject Object>
+constexpr hit_object_t<Object> hit_object_of(Object const &obj,
+                                             ray_t const &ray,
+                                             interval_t const &interval,
+                                             double t) {
+  if constexpr (DeferredHittable<Object>) {
+    return hit_object_at(obj, ray, interval, t);
+  } else {
+    return std::move(hit(obj, ray, interval)->hit_object);
+  }
+}
+
+// Postcondition:
+//   - hit_packet(obj, packet, t_min, hits, active) does for every lane i in
+//     active what hit(obj, lane_ray(packet, i), {t_min, hits.closest[i]})
+//     does, recording hits found in hits, and returns lanes whose hit it
+//     recorded
+template <typename Object, std::size_t N>
+concept PacketHittable =
+    SceneObject<Object> &&
+    requires(Object const &obj, ray_packet_t<N> const &packet, double t_min,
+             packet_hits_t<hit_object_t<Object>, N> &hits,
+             packet_mask_t active) {
+      {
+        hit_packet(obj, packet, t_min, hits, active)
+      } -> std::same_as<packet_mask_t>;
+    };
+
+// Uses hit_packet for objects supporting it and falls back to hit for every
+// lane otherwise.
+template <std::size_t N, SceneObject Object>
+constexpr packet_mask_t hit_lanes(Object const &obj,
+                                  ray_packet_t<N> const &packet, double t_min,
+                                  packet_hits_t<hit_object_t<Object>, N> &hits,
+                                  packet_mask_t active) {
+  if constexpr (PacketHittable<Object, N>) {
+    return hit_packet(obj, packet, t_min, hits, active);
+  } else {
+    packet_mask_t res = 0;
+    for_each_lane(active, [&](std::size_t lane) {
+      auto hit_rec = hit(obj, lane_ray(packet, lane),
+                         interval_t{t_min, hits.closest[lane]});
+      if (!hit_rec)
+        return;
+      hits.closest[lane] = hit_rec->hit_distance;
+      hits.hits[lane] = std::move(hit_rec);
+      res |= packet_mask_t{1} << lane;
+    });
+    return res;
+  }
+}
+
+// Precondition:
+//   - rays.size() == hits.size()
+//
+// Postcondition:
+//   - hit_stream(obj, rays, interval, hits) sets hits[i] to
+//     hit(obj, rays[i], interval) for every i, in whatever order of rays and
+//     objects suits obj
+template <typename Object>
+concept StreamHittable =
+    SceneObject<Object> &&
+    requires(Object const &obj, std::span<ray_t const> rays,
+             interval_t const &interval,
+             std::span<std::optional<hit_info_of<Object>>> hits) {
+      { hit_stream(obj, rays, interval, hits) } -> std::same_as<void>;
+    };
+
+// Uses hit_stream for objects supporting it and falls back to hit for every
+// ray otherwise.
+//
+// Precondition:
+//   - rays.size() == hits.size()
+template <SceneObject Object>
+constexpr void hit_rays(Object const &obj, std::span<ray_t const> rays,
+                        interval_t const &interval,
+                        std::span<std::optional<hit_info_of<Object>>> hits) {
+  if constexpr (StreamHittable<Object>) {
+    hit_stream(obj, rays, interval, hits);
+  } else {
+    for (std::size_t i = 0; i < rays.size(); ++i) {
+      hits[i] = hit(obj, rays[i], interval);
+    }
+  }
+}
 } // namespace mrl
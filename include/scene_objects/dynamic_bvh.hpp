@@ -0,0 +1,550 @@
+#pragma once
+
+#include "bound.hpp"
+#include "interval.hpp"
+#include "prepared_ray.hpp"
+#include "ray.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/concepts.hpp"
+#include "traits.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace mrl {
+// bvh supporting insertion and removal of objects in O(log n), for scenes
+// edited object by object where rebuilding bvh_t on every edit is too slow.
+// Every leaf holds one object.
+//
+// Like dynamic AABB trees of physics engines, a new object descends from root
+// towards the child whose surface area it grows least, until pairing it with
+// the current node is cheaper than descending, and a new parent is made for
+// both. Removing an object replaces its parent by its sibling. Nodes on the
+// path from an edit to root are then rotated to lower their surface area
+// (Kopta et al., "Fast, Effective BVH Updates for Animated Scenes"), and
+// lifted like in AVL trees where heights of children differ too much, which
+// keeps height close to log2(n).
+//
+// Class Invariant:
+//   - height of tree is less than bvh_max_depth, tree is rebuilt balanced in
+//     the rare case an edit makes it taller
+//   - leaf of objects_[i] is object_leaves_[i]
+template <typename Object> class dynamic_bvh_t {
+public:
+  using object_type = Object;
+  using hit_object_type = hit_object_t<Object>;
+
+  // Refers to an inserted object until it is removed.
+  using handle_t = std::uint32_t;
+
+private:
+  constexpr static std::uint32_t null_node =
+      std::numeric_limits<std::uint32_t>::max();
+  // Balancing more strictly makes tree shallower but keeps large objects
+  // like a ground plane away from root, which costs more than it saves.
+  constexpr static std::uint32_t max_height_difference = 4;
+
+  // Free nodes are linked through parent.
+  //
+  // Class Invariant:
+  //   - node is a leaf iff left is null_node, leaf holds objects_[object]
+  //   - height of a leaf is 0
+  struct node_t {
+    minmax_bound_t bounds;
+    std::uint32_t parent;
+    std::uint32_t left;
+    std::uint32_t right;
+    std::uint32_t object;
+    std::uint32_t height;
+  };
+
+  std::vector<object_type> objects_;
+  std::vector<handle_t> object_leaves_;
+  std::vector<node_t> nodes_;
+  std::uint32_t root_ = null_node;
+  std::uint32_t free_nodes_ = null_node;
+
+  static double area(minmax_bound_t const &bounds) {
+    return surface_area(to_bound(bounds));
+  }
+
+  static std::uint32_t height_difference(std::uint32_t a, std::uint32_t b) {
+    return a > b ? a - b : b - a;
+  }
+
+  bool is_leaf(std::uint32_t index) const {
+    return nodes_[index].left == null_node;
+  }
+
+  std::uint32_t allocate_node() {
+    if (free_nodes_ == null_node) {
+      nodes_.emplace_back();
+      return static_cast<std::uint32_t>(nodes_.size() - 1);
+    }
+    auto const index = free_nodes_;
+    free_nodes_ = nodes_[index].parent;
+    return index;
+  }
+
+  void free_node(std::uint32_t index) {
+    nodes_[index].parent = free_nodes_;
+    free_nodes_ = index;
+  }
+
+  void replace_child(std::uint32_t parent, std::uint32_t old_child,
+                     std::uint32_t new_child) {
+    nodes_[new_child].parent = parent;
+    if (parent == null_node) {
+      root_ = new_child;
+      return;
+    }
+    auto &node = nodes_[parent];
+    (node.left == old_child ? node.left : node.right) = new_child;
+  }
+
+  void set_children(std::uint32_t index, std::uint32_t left,
+                    std::uint32_t right) {
+    nodes_[index].left = left;
+    nodes_[index].right = right;
+    nodes_[left].parent = index;
+    nodes_[right].parent = index;
+    refit(index);
+  }
+
+  // Precondition:
+  //   - index is an interior node
+  void refit(std::uint32_t index) {
+    auto &node = nodes_[index];
+    auto const &left = nodes_[node.left];
+    auto const &right = nodes_[node.right];
+    node.bounds = union_bounds(left.bounds, right.bounds);
+    node.height = 1 + std::max(left.height, right.height);
+  }
+
+  // Cost of pairing bounds with a node is twice surface area of their new
+  // parent, as both children of the parent are tested whenever it is. Cost
+  // of descending further is at least growth of the node and of the child.
+  //
+  // Precondition:
+  //   - tree is not empty
+  std::uint32_t find_sibling(minmax_bound_t const &bounds) const {
+    auto cur = root_;
+    while (!is_leaf(cur)) {
+      auto const &node = nodes_[cur];
+      auto const combined = area(union_bounds(node.bounds, bounds));
+      auto const pair_cost = 2 * combined;
+      auto const inherited_cost = 2 * (combined - area(node.bounds));
+      auto descend_cost = [&](std::uint32_t child) {
+        auto const &child_bounds = nodes_[child].bounds;
+        auto const child_combined = area(union_bounds(child_bounds, bounds));
+        auto const growth = is_leaf(child)
+                                ? child_combined
+                                : child_combined - area(child_bounds);
+        return growth + inherited_cost;
+      };
+      auto const left_cost = descend_cost(node.left);
+      auto const right_cost = descend_cost(node.right);
+      if (pair_cost < left_cost && pair_cost < right_cost)
+        break;
+      cur = left_cost < right_cost ? node.left : node.right;
+    }
+    return cur;
+  }
+
+  // Precondition:
+  //   - leaf is not in tree and its bounds are set
+  void insert_leaf(std::uint32_t leaf) {
+    if (root_ == null_node) {
+      root_ = leaf;
+      nodes_[leaf].parent = null_node;
+      return;
+    }
+    auto const sibling = find_sibling(nodes_[leaf].bounds);
+    auto const parent = allocate_node();
+    replace_child(nodes_[sibling].parent, sibling, parent);
+    set_children(parent, sibling, leaf);
+    fix_upwards(nodes_[parent].parent);
+  }
+
+  // Precondition:
+  //   - leaf is in tree
+  void remove_leaf(std::uint32_t leaf) {
+    if (leaf == root_) {
+      root_ = null_node;
+      return;
+    }
+    auto const parent = nodes_[leaf].parent;
+    auto const &parent_node = nodes_[parent];
+    auto const sibling =
+        parent_node.left == leaf ? parent_node.right : parent_node.left;
+    auto const grand_parent = parent_node.parent;
+    replace_child(grand_parent, parent, sibling);
+    free_node(parent);
+    fix_upwards(grand_parent);
+  }
+
+  // Rebalances and rotates every node from index to root, refitting it after
+  // its children.
+  void fix_upwards(std::uint32_t index) {
+    while (index != null_node) {
+      index = balance(index);
+      rotate(index);
+      refit(index);
+      index = nodes_[index].parent;
+    }
+    if (root_ != null_node && nodes_[root_].height >= bvh_max_depth)
+      rebuild();
+  }
+
+  // Lifts taller child of node at index to its place, putting its shorter
+  // child under node, if heights of children of node differ by more than
+  // max_height_difference.
+  //
+  // Postcondition:
+  //   - returns node now at place of index
+  std::uint32_t balance(std::uint32_t index) {
+    auto const &node = nodes_[index];
+    auto const left = node.left;
+    auto const right = node.right;
+    auto const left_height = nodes_[left].height;
+    auto const right_height = nodes_[right].height;
+    if (height_difference(left_height, right_height) <= max_height_difference)
+      return index;
+    auto const tall = left_height > right_height ? left : right;
+    auto const short_child = tall == left ? right : left;
+    auto const &tall_node = nodes_[tall];
+    auto const tall_left = tall_node.left;
+    auto const tall_right = tall_node.right;
+    auto const left_taller =
+        nodes_[tall_left].height > nodes_[tall_right].height;
+    auto const taller = left_taller ? tall_left : tall_right;
+    auto const shorter = left_taller ? tall_right : tall_left;
+    replace_child(node.parent, index, tall);
+    set_children(index, short_child, shorter);
+    set_children(tall, index, taller);
+    return tall;
+  }
+
+  // Among rotations swapping a child of node at index with a grandchild
+  // under its other child, applies the one lowering surface area of that
+  // other child most, if any does. Bounds of node at index stay same.
+  void rotate(std::uint32_t index) {
+    struct rotation_t {
+      std::uint32_t outer;
+      std::uint32_t inner;
+      double gain;
+    };
+
+    auto const &node = nodes_[index];
+    rotation_t best{null_node, null_node, 0};
+    for (auto [outer, other] :
+         {std::pair{node.left, node.right}, std::pair{node.right, node.left}}) {
+      if (is_leaf(other))
+        continue;
+      auto const &other_node = nodes_[other];
+      for (auto [inner, kept] :
+           {std::pair{other_node.left, other_node.right},
+            std::pair{other_node.right, other_node.left}}) {
+        auto const gain =
+            area(other_node.bounds) -
+            area(union_bounds(nodes_[outer].bounds, nodes_[kept].bounds));
+        if (gain > best.gain)
+          best = {outer, inner, gain};
+      }
+    }
+    if (best.outer == null_node)
+      return;
+    auto const other = nodes_[best.inner].parent;
+    replace_child(index, best.outer, best.inner);
+    replace_child(other, best.inner, best.outer);
+    refit(other);
+  }
+
+  // Splits leaves at median of their centroids along axis where centroids
+  // spread most.
+  //
+  // Precondition:
+  //   - leaves is not empty
+  //
+  // Postcondition:
+  //   - returns root of a tree of height ceil(log2(leaves.size())) over
+  //     leaves
+  std::uint32_t build_balanced(std::span<std::uint32_t> leaves) {
+    if (leaves.size() == 1)
+      return leaves.front();
+    auto centroid_of = [this](std::uint32_t leaf) {
+      return centroid(to_bound(nodes_[leaf].bounds));
+    };
+    auto min = centroid_of(leaves.front());
+    auto max = min;
+    for (auto leaf : leaves) {
+      auto const c = centroid_of(leaf);
+      min = vec3{std::min(min.x, c.x), std::min(min.y, c.y),
+                 std::min(min.z, c.z)};
+      max = vec3{std::max(max.x, c.x), std::max(max.y, c.y),
+                 std::max(max.z, c.z)};
+    }
+    auto const extent = max - min;
+    auto const axis =
+        extent.x >= extent.y ? (extent.x >= extent.z ? 0 : 2)
+                             : (extent.y >= extent.z ? 1 : 2);
+    auto const half = leaves.size() / 2;
+    auto const mid = leaves.begin() + static_cast<std::ptrdiff_t>(half);
+    std::ranges::nth_element(leaves, mid,
+                             [&](std::uint32_t a, std::uint32_t b) {
+                               return component(centroid_of(a), axis) <
+                                      component(centroid_of(b), axis);
+                             });
+    auto const left = build_balanced(leaves.first(half));
+    auto const right = build_balanced(leaves.subspan(half));
+    auto const index = allocate_node();
+    set_children(index, left, right);
+    return index;
+  }
+
+  void set_leaf_bounds(std::uint32_t leaf) {
+    auto &node = nodes_[leaf];
+    node.bounds = to_minmax_bound(get_bounds(objects_[node.object]));
+  }
+
+public:
+  dynamic_bvh_t() = default;
+
+  // Inserts objects of rng one by one.
+  template <std::ranges::input_range Range>
+  explicit dynamic_bvh_t(Range &&rng) {
+    for (auto &&obj : rng) {
+      insert(std::forward<decltype(obj)>(obj));
+    }
+  }
+
+  std::size_t size() const { return objects_.size(); }
+
+  bool empty() const { return objects_.empty(); }
+
+  // Removing an object moves last object to its place.
+  std::span<object_type const> objects() const { return objects_; }
+
+  // Precondition:
+  //   - handle refers to an object in bvh
+  object_type const &object(handle_t handle) const {
+    return objects_[nodes_[handle].object];
+  }
+
+  // Postcondition:
+  //   - returns empty bound for bvh with no objects
+  bound_t bounds() const {
+    if (root_ == null_node)
+      return bound_t{};
+    return to_bound(nodes_[root_].bounds);
+  }
+
+  // Postcondition:
+  //   - returns height of tree, 0 for at most one object
+  std::size_t height() const {
+    return root_ == null_node ? 0 : nodes_[root_].height;
+  }
+
+  // Postcondition:
+  //   - returns handle referring to obj until it is removed
+  handle_t insert(object_type obj) {
+    auto const leaf = allocate_node();
+    auto &node = nodes_[leaf];
+    node.left = null_node;
+    node.right = null_node;
+    node.object = static_cast<std::uint32_t>(objects_.size());
+    node.height = 0;
+    objects_.push_back(std::move(obj));
+    object_leaves_.push_back(leaf);
+    set_leaf_bounds(leaf);
+    insert_leaf(leaf);
+    return leaf;
+  }
+
+  // Precondition:
+  //   - handle refers to an object in bvh
+  //
+  // Postcondition:
+  //   - handle and removed object's memory may be reused by later insertions
+  void remove(handle_t handle) {
+    remove_leaf(handle);
+    auto const object = nodes_[handle].object;
+    free_node(handle);
+    if (object + 1 != objects_.size()) {
+      objects_[object] = std::move(objects_.back());
+      object_leaves_[object] = object_leaves_.back();
+      nodes_[object_leaves_[object]].object = object;
+    }
+    objects_.pop_back();
+    object_leaves_.pop_back();
+  }
+
+  // Replaces object referred by handle by obj (e.g. same object moved) and
+  // reinserts its leaf where obj fits best.
+  //
+  // Precondition:
+  //   - handle refers to an object in bvh
+  void update(handle_t handle, object_type obj) {
+    objects_[nodes_[handle].object] = std::move(obj);
+    remove_leaf(handle);
+    set_leaf_bounds(handle);
+    insert_leaf(handle);
+  }
+
+  // Builds tree again over same objects, balanced by median splits, for when
+  // many edits made it worse than needed. Handles stay valid. It takes
+  // O(n log n) time.
+  void rebuild() {
+    if (root_ == null_node)
+      return;
+    // Tree may be taller than bvh_max_depth here.
+    std::vector<std::uint32_t> to_visit{root_};
+    while (!to_visit.empty()) {
+      auto const cur = to_visit.back();
+      to_visit.pop_back();
+      if (is_leaf(cur))
+        continue;
+      to_visit.push_back(nodes_[cur].left);
+      to_visit.push_back(nodes_[cur].right);
+      free_node(cur);
+    }
+    std::vector<std::uint32_t> leaves(object_leaves_);
+    root_ = build_balanced(leaves);
+    nodes_[root_].parent = null_node;
+  }
+
+  // Postcondition:
+  //   - returns SAH cost of tree, see mrl::sah_cost
+  double sah_cost(double traversal_cost = 1.0,
+                  double intersection_cost = 1.0) const {
+    if (root_ == null_node)
+      return 0;
+    auto const root_area = area(nodes_[root_].bounds);
+    auto const area_scale = root_area > 0 ? 1 / root_area : 1.0;
+    double cost = 0;
+    std::array<std::uint32_t, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    to_visit[num_to_visit++] = root_;
+    while (num_to_visit > 0) {
+      auto const cur = to_visit[--num_to_visit];
+      auto const &node = nodes_[cur];
+      auto const node_area = area(node.bounds) * area_scale;
+      if (is_leaf(cur)) {
+        cost += intersection_cost * node_area;
+        continue;
+      }
+      cost += traversal_cost * node_area;
+      to_visit[num_to_visit++] = node.left;
+      to_visit[num_to_visit++] = node.right;
+    }
+    return cost;
+  }
+
+  // Same traversal as bvh_t::hit_ray.
+  auto hit_ray(ray_t const &r, interval_t interval) const {
+    struct pending_node {
+      std::uint32_t index;
+      double entry_distance;
+    };
+
+    std::optional<hit_info_t<hit_object_type>> res;
+    auto const ray = prepare(r);
+    if (root_ == null_node || !hit_bounds(ray, nodes_[root_].bounds, interval))
+      return res;
+    std::array<pending_node, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    auto cur = root_;
+    while (true) {
+      auto const &node = nodes_[cur];
+      if (is_leaf(cur)) {
+        auto hit_rec = hit(objects_[node.object], r, interval);
+        if (hit_rec && (!res || hit_rec->hit_distance < res->hit_distance)) {
+          interval.max = hit_rec->hit_distance;
+          res = std::move(hit_rec);
+        }
+      } else {
+        auto const left = node.left;
+        auto const right = node.right;
+        auto const left_clip =
+            clip_interval(ray, nodes_[left].bounds, interval);
+        auto const right_clip =
+            clip_interval(ray, nodes_[right].bounds, interval);
+        auto const hit_left = left_clip.min <= left_clip.max;
+        auto const hit_right = right_clip.min <= right_clip.max;
+        if (hit_left && hit_right) {
+          auto const left_first = left_clip.min <= right_clip.min;
+          cur = left_first ? left : right;
+          to_visit[num_to_visit++] =
+              left_first ? pending_node{right, right_clip.min}
+                         : pending_node{left, left_clip.min};
+          continue;
+        }
+        if (hit_left || hit_right) {
+          cur = hit_left ? left : right;
+          continue;
+        }
+      }
+      auto found = false;
+      while (num_to_visit > 0 && !found) {
+        auto const pending = to_visit[--num_to_visit];
+        found = pending.entry_distance <= interval.max;
+        cur = pending.index;
+      }
+      if (!found)
+        break;
+    }
+    return res;
+  }
+
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    auto const ray = prepare(r);
+    if (root_ == null_node || !hit_bounds(ray, nodes_[root_].bounds, interval))
+      return false;
+    std::array<std::uint32_t, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    to_visit[num_to_visit++] = root_;
+    while (num_to_visit > 0) {
+      auto const cur = to_visit[--num_to_visit];
+      auto const &node = nodes_[cur];
+      if (is_leaf(cur)) {
+        if (is_occluded(objects_[node.object], r, interval))
+          return true;
+        continue;
+      }
+      if (hit_bounds(ray, nodes_[node.right].bounds, interval))
+        to_visit[num_to_visit++] = node.right;
+      if (hit_bounds(ray, nodes_[node.left].bounds, interval))
+        to_visit[num_to_visit++] = node.left;
+    }
+    return false;
+  }
+};
+
+template <std::ranges::input_range Range>
+dynamic_bvh_t(Range &&rng) -> dynamic_bvh_t<std::ranges::range_value_t<Range>>;
+
+template <BoundedObject Object>
+inline bound_t get_bounds(dynamic_bvh_t<Object> const &bvh) {
+  return bvh.bounds();
+}
+
+template <SceneObject Object>
+inline auto hit(dynamic_bvh_t<Object> const &bvh, ray_t const &r,
+                interval_t const &interval) {
+  return bvh.hit_ray(r, interval);
+}
+
+template <SceneObject Object>
+inline bool occluded(dynamic_bvh_t<Object> const &bvh, ray_t const &r,
+                     interval_t const &interval) {
+  return bvh.occluded_ray(r, interval);
+}
+} // namespace mrl
@@ -0,0 +1,258 @@
+#pragma once
+
+#include "bound.hpp"
+#include "interval.hpp"
+#include "prepared_ray.hpp"
+#include "ray.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/traits.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <vector>
+
+namespace mrl {
+// Precondition:
+//   - density > 0
+//   - max_resolution >= 1
+struct grid_options {
+  // Number of cells is about density times number of objects.
+  double density = 4.0;
+  // Upper bound of number of cells along any axis.
+  int max_resolution = 128;
+};
+
+// Uniform grid over bounds of all objects. Every cell refers to objects whose
+// bounds overlap it. A ray walks cells it passes through front to back
+// (3D-DDA) and stops at the first cell whose closest hit lies before its
+// exit.
+//
+// Grid suits dense and evenly distributed objects, where walking cells is
+// cheaper than descending a hierarchy. Unevenly distributed objects leave
+// most cells empty and few cells crowded, where bvh_t does better.
+//
+// Class Invariant:
+//   - objects of cell i are cell_objects_[cell_offsets_[i],
+//     cell_offsets_[i + 1])
+template <typename Object> class grid_t {
+public:
+  using object_type = Object;
+  using hit_object_type = hit_object_t<Object>;
+
+private:
+  std::vector<object_type> objects_;
+  bound_t bounds_;
+  std::array<int, 3> resolution_{};
+  vec3 cell_size_{};
+  std::vector<std::uint32_t> cell_offsets_;
+  std::vector<std::uint32_t> cell_objects_;
+
+  int cell_of(double x, std::size_t axis) const {
+    auto const &range = axis_range(bounds_, static_cast<int>(axis));
+    auto const cell =
+        (x - range.min) / component(cell_size_, static_cast<int>(axis));
+    auto const max_cell = static_cast<double>(resolution_[axis] - 1);
+    return static_cast<int>(std::clamp(cell, 0.0, max_cell));
+  }
+
+  std::size_t cell_index(std::array<int, 3> const &cell) const {
+    auto const [nx, ny, nz] = resolution_;
+    return static_cast<std::size_t>((cell[2] * ny + cell[1]) * nx + cell[0]);
+  }
+
+  template <typename Fn>
+  void for_each_cell(bound_t const &bound, Fn &&fn) const {
+    std::array<int, 3> first;
+    std::array<int, 3> last;
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      auto const &range = axis_range(bound, static_cast<int>(axis));
+      first[axis] = cell_of(range.min, axis);
+      last[axis] = cell_of(range.max, axis);
+    }
+    for (auto z = first[2]; z <= last[2]; ++z) {
+      for (auto y = first[1]; y <= last[1]; ++y) {
+        for (auto x = first[0]; x <= last[0]; ++x) {
+          fn(cell_index({x, y, z}));
+        }
+      }
+    }
+  }
+
+  void build(grid_options const &options) {
+    if (objects_.empty())
+      return;
+    std::vector<bound_t> object_bounds;
+    object_bounds.reserve(objects_.size());
+    bound_t bounds;
+    for (auto const &obj : objects_) {
+      object_bounds.push_back(get_bounds(obj));
+      bounds = union_bounds(bounds, object_bounds.back());
+    }
+    bounds_ = pad_bounds(bounds);
+
+    auto const extent = vec3{size(bounds_.x_range), size(bounds_.y_range),
+                             size(bounds_.z_range)};
+    auto const num_objects = static_cast<double>(objects_.size());
+    auto const cells_per_unit = std::cbrt(options.density * num_objects /
+                                          (extent.x * extent.y * extent.z));
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      auto const cells = std::round(
+          component(extent, static_cast<int>(axis)) * cells_per_unit);
+      resolution_[axis] = static_cast<int>(std::clamp(
+          cells, 1.0, static_cast<double>(options.max_resolution)));
+    }
+    cell_size_ = vec3{extent.x / resolution_[0], extent.y / resolution_[1],
+                      extent.z / resolution_[2]};
+
+    auto const num_cells = static_cast<std::size_t>(resolution_[0]) *
+                           static_cast<std::size_t>(resolution_[1]) *
+                           static_cast<std::size_t>(resolution_[2]);
+    cell_offsets_.assign(num_cells + 1, 0);
+    for (auto const &bound : object_bounds) {
+      for_each_cell(bound, [this](std::size_t cell) {
+        ++cell_offsets_[cell + 1];
+      });
+    }
+    std::partial_sum(cell_offsets_.begin(), cell_offsets_.end(),
+                     cell_offsets_.begin());
+    cell_objects_.resize(cell_offsets_.back());
+    std::vector<std::uint32_t> next(cell_offsets_.begin(),
+                                    cell_offsets_.end() - 1);
+    for (std::size_t i = 0; i < object_bounds.size(); ++i) {
+      for_each_cell(object_bounds[i], [this, &next, i](std::size_t cell) {
+        cell_objects_[next[cell]++] = static_cast<std::uint32_t>(i);
+      });
+    }
+  }
+
+  // Calls visit(cell, exit_distance) for cells pierced by r within interval
+  // in order until it returns true.
+  template <typename Visit>
+  void walk_cells(ray_t const &r, interval_t const &interval,
+                  Visit &&visit) const {
+    constexpr static auto inf = std::numeric_limits<double>::infinity();
+    if (objects_.empty())
+      return;
+    auto const clipped =
+        clip_interval(prepare(r), to_minmax_bound(bounds_), interval);
+    if (clipped.min > clipped.max)
+      return;
+    auto const entry = r.at(clipped.min);
+    auto const dir = r.direction.val();
+    std::array<int, 3> cell;
+    std::array<int, 3> step;
+    std::array<double, 3> next_distance;
+    std::array<double, 3> delta_distance;
+    for (std::size_t axis = 0; axis < 3; ++axis) {
+      auto const i = static_cast<int>(axis);
+      auto const d = component(dir, i);
+      auto const o = component(r.origin, i);
+      auto const min = axis_range(bounds_, i).min;
+      auto const cell_size = component(cell_size_, i);
+      cell[axis] = cell_of(component(entry, i), axis);
+      if (d > 0) {
+        step[axis] = 1;
+        next_distance[axis] = (min + (cell[axis] + 1) * cell_size - o) / d;
+        delta_distance[axis] = cell_size / d;
+      } else if (d < 0) {
+        step[axis] = -1;
+        next_distance[axis] = (min + cell[axis] * cell_size - o) / d;
+        delta_distance[axis] = -cell_size / d;
+      } else {
+        step[axis] = 0;
+        next_distance[axis] = inf;
+        delta_distance[axis] = inf;
+      }
+    }
+    while (true) {
+      auto const axis = static_cast<std::size_t>(
+          std::ranges::min_element(next_distance) - next_distance.begin());
+      auto const exit = std::min(next_distance[axis], clipped.max);
+      if (visit(cell_index(cell), exit) || next_distance[axis] > clipped.max)
+        return;
+      cell[axis] += step[axis];
+      if (cell[axis] < 0 || cell[axis] >= resolution_[axis])
+        return;
+      next_distance[axis] += delta_distance[axis];
+    }
+  }
+
+public:
+  template <std::ranges::random_access_range Range>
+  explicit grid_t(Range &&rng, grid_options const &options = {})
+      : objects_(to_object_vector<object_type>(std::forward<Range>(rng))) {
+    build(options);
+  }
+
+  // Postcondition:
+  //   - returns empty bound for grid with no objects
+  bound_t bounds() const { return bounds_; }
+
+  std::array<int, 3> const &resolution() const { return resolution_; }
+
+  std::vector<object_type> const &objects() const { return objects_; }
+
+  // An object overlapping many cells is tested once per cell, its hit is
+  // accepted only when cell containing it is reached.
+  auto hit_ray(ray_t const &r, interval_t interval) const {
+    std::optional<hit_info_t<hit_object_type>> res;
+    walk_cells(r, interval, [&](std::size_t cell, double exit) {
+      for (auto i = cell_offsets_[cell]; i < cell_offsets_[cell + 1]; ++i) {
+        auto hit_rec = hit(objects_[cell_objects_[i]], r, interval);
+        if (hit_rec && (!res || hit_rec->hit_distance < res->hit_distance)) {
+          interval.max = hit_rec->hit_distance;
+          res = std::move(hit_rec);
+        }
+      }
+      return interval.max <= exit;
+    });
+    return res;
+  }
+
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    auto res = false;
+    walk_cells(r, interval, [&](std::size_t cell, double exit) {
+      for (auto i = cell_offsets_[cell]; i < cell_offsets_[cell + 1]; ++i) {
+        if (is_occluded(objects_[cell_objects_[i]], r, interval)) {
+          res = true;
+          break;
+        }
+      }
+      return res || interval.max <= exit;
+    });
+    return res;
+  }
+};
+
+template <std::ranges::random_access_range Range>
+grid_t(Range &&rng) -> grid_t<std::ranges::range_value_t<Range>>;
+
+template <std::ranges::random_access_range Range>
+grid_t(Range &&rng, grid_options const &)
+    -> grid_t<std::ranges::range_value_t<Range>>;
+
+template <BoundedObject Object>
+inline bound_t get_bounds(grid_t<Object> const &grid) {
+  return grid.bounds();
+}
+
+template <SceneObject Object>
+inline auto hit(grid_t<Object> const &grid, ray_t const &r,
+                interval_t const &interval) {
+  return grid.hit_ray(r, interval);
+}
+
+template <SceneObject Object>
+inline bool occluded(grid_t<Object> const &grid, ray_t const &r,
+                     interval_t const &interval) {
+  return grid.occluded_ray(r, interval);
+}
+} // namespace mrl
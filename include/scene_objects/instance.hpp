@@ -0,0 +1,115 @@
+#pragma once
+
+#include "bound.hpp"
+#include "direction.hpp"
+#include "generator/concepts.hpp"
+#include "generator/generator_view.hpp"
+#include "hit_info.hpp"
+#include "interval.hpp"
+#include "materials/scatter_info.hpp"
+#include "point.hpp"
+#include "ray.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/traits.hpp"
+#include "transform.hpp"
+#include <memory>
+#include <optional>
+
+namespace mrl {
+template <typename Object> struct instance_hit_object {
+  hit_object_t<Object> hit_obj;
+  transform_t const *transform;
+};
+
+// Places a shared object in world with a transform. Object is not copied, so
+// many instances of same object (usually a bvh_t) cost memory of only one.
+//
+// Class Invariant:
+//   - object is not null
+template <typename Object> struct instance_t {
+  using object_type = Object;
+  using hit_object_type = instance_hit_object<Object>;
+
+  std::shared_ptr<object_type const> object;
+  transform_t transform;
+
+  instance_t(std::shared_ptr<object_type const> object_,
+             transform_t const &transform_)
+      : object(std::move(object_)), transform(transform_) {}
+};
+
+template <typename Object>
+instance_t(std::shared_ptr<Object const>, transform_t const &)
+    -> instance_t<Object>;
+
+template <typename Object>
+instance_t(std::shared_ptr<Object>, transform_t const &) -> instance_t<Object>;
+
+template <typename Object>
+constexpr auto normal_at(instance_hit_object<Object> const &o,
+                         point3 const &p) {
+  auto const local_normal =
+      normal_at(o.hit_obj, transform_point(o.transform->inverse, p)).val();
+  return direction_t{
+      transpose_transform_vector(o.transform->inverse, local_normal)};
+}
+
+template <typename Object>
+constexpr auto scaling_2d_at(instance_hit_object<Object> const &o,
+                             point3 const &p) {
+  return scaling_2d_at(o.hit_obj, transform_point(o.transform->inverse, p));
+}
+
+template <DoubleGenerator Generator, typename Object>
+constexpr std::optional<scatter_info_t>
+scattering_for(instance_hit_object<Object> const &o, ray_t const &r,
+               double hit_distance, generator_view<Generator> rand) {
+  auto const local = transform_ray(o.transform->inverse, r);
+  auto res = scattering_for(o.hit_obj, local.ray,
+                            hit_distance * local.distance_scale, rand);
+  if (res) {
+    res->scattered_ray =
+        transform_ray(o.transform->matrix, res->scattered_ray).ray;
+  }
+  return res;
+}
+
+template <DoubleGenerator Generator, typename Object>
+constexpr auto emission_at(instance_hit_object<Object> const &o,
+                           point3 const &p, generator_view<Generator> rand) {
+  return emission_at(o.hit_obj, transform_point(o.transform->inverse, p),
+                     rand);
+}
+
+// Ray is transformed to object space once and interval is scaled with it, so
+// object is hit in its own space.
+template <SceneObject Object>
+constexpr std::optional<hit_info_t<instance_hit_object<Object>>>
+hit(instance_t<Object> const &obj, ray_t const &r,
+    interval_t const &interval) {
+  auto const local = transform_ray(obj.transform.inverse, r);
+  auto const scale = local.distance_scale;
+  auto const local_interval =
+      interval_t{interval.min * scale, interval.max * scale};
+  auto internal_hit = hit(*obj.object, local.ray, local_interval);
+  if (!internal_hit)
+    return std::nullopt;
+  return hit_info_t<instance_hit_object<Object>>{
+      internal_hit->hit_distance / scale,
+      {std::move(internal_hit->hit_object), &obj.transform}};
+}
+
+template <SceneObject Object>
+constexpr bool occluded(instance_t<Object> const &obj, ray_t const &r,
+                        interval_t const &interval) {
+  auto const local = transform_ray(obj.transform.inverse, r);
+  auto const scale = local.distance_scale;
+  return is_occluded(*obj.object, local.ray,
+                     interval_t{interval.min * scale, interval.max * scale});
+}
+
+template <BoundedObject Object>
+constexpr bound_t get_bounds(instance_t<Object> const &obj) {
+  return transform_bounds(obj.transform.matrix, get_bounds(*obj.object));
+}
+} // namespace mrl
@@ -0,0 +1,383 @@
+#pragma once
+
+#include "bound.hpp"
+#include "interval.hpp"
+#include "prepared_ray.hpp"
+#include "ray.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/traits.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <vector>
+
+namespace mrl {
+// Node of a flattened kd-tree. Nodes are stored in depth first order.
+//
+// Interior node:
+//   - splits its space by plane where axis'th coordinate is split
+//   - child below plane is the node just after it
+//   - child above plane is the node at index offset
+//
+// Leaf node:
+//   - axis is 3
+//   - contains objects object_indices[offset, offset + count) of kd-tree
+//
+// Class Invariant:
+//   - flags holds axis in its lowest 2 bits and count of a leaf above them
+struct kd_node_t {
+  double split;
+  std::uint32_t offset;
+  std::uint32_t flags;
+};
+
+static_assert(sizeof(kd_node_t) == 16);
+
+// Upper bound on depth of any kd-tree, traversal stacks are sized with it.
+constexpr static std::size_t kd_tree_max_depth = 64;
+
+constexpr kd_node_t make_kd_leaf(std::uint32_t offset, std::uint32_t count) {
+  return {0, offset, count << 2 | 3};
+}
+
+constexpr kd_node_t make_kd_interior(int axis, double split,
+                                     std::uint32_t above) {
+  return {split, above, static_cast<std::uint32_t>(axis)};
+}
+
+constexpr bool is_leaf(kd_node_t const &node) { return (node.flags & 3) == 3; }
+
+constexpr int split_axis(kd_node_t const &node) {
+  return static_cast<int>(node.flags & 3);
+}
+
+constexpr std::uint32_t leaf_count(kd_node_t const &node) {
+  return node.flags >> 2;
+}
+
+// Cost model of SAH kd-tree. Splitting a node with bounds B into children L
+// and R costs:
+//   traversal_cost +
+//   intersection_cost * (1 - bonus) * (SA(L) * |L| + SA(R) * |R|) / SA(B)
+// where bonus is empty_bonus if either child is empty and 0 otherwise.
+// Making the node a leaf costs intersection_cost * |B|.
+//
+// Precondition:
+//   - 0 <= empty_bonus < 1
+struct kd_tree_options {
+  double traversal_cost = 1.0;
+  double intersection_cost = 4.0;
+  double empty_bonus = 0.5;
+  // Nodes with at most these many objects are not split.
+  std::size_t max_leaf_objects = 1;
+};
+
+namespace __kd_tree_details {
+struct edge_t {
+  double position;
+  std::uint32_t ref;
+  bool is_start;
+};
+
+// Order of edges at same position makes objects starting at a split
+// position go above it and objects ending at it go below it.
+constexpr bool operator<(edge_t const &a, edge_t const &b) {
+  if (a.position != b.position)
+    return a.position < b.position;
+  return a.is_start && !b.is_start;
+}
+
+struct split_t {
+  double cost = std::numeric_limits<double>::infinity();
+  int axis = -1;
+  std::size_t edge = 0;
+};
+
+// Wald and Havran, "On building fast kd-trees for ray tracing, and on doing
+// that in O(N log N)", with edges sorted per node, taking O(N log^2 N).
+struct builder {
+  std::vector<bound_t> const &bounds;
+  kd_tree_options options;
+  std::size_t max_depth;
+  std::vector<kd_node_t> nodes;
+  std::vector<std::uint32_t> object_indices;
+  std::array<std::vector<edge_t>, 3> edges;
+
+  void sort_edges(bound_t const &node_bounds,
+                  std::vector<std::uint32_t> const &refs, int axis) {
+    auto &axis_edges = edges[static_cast<std::size_t>(axis)];
+    axis_edges.clear();
+    for (auto ref : refs) {
+      auto const clipped = intersect_bounds(bounds[ref], node_bounds);
+      auto const &range = axis_range(clipped, axis);
+      axis_edges.push_back({range.min, ref, true});
+      axis_edges.push_back({range.max, ref, false});
+    }
+    std::ranges::sort(axis_edges, std::less<>{});
+  }
+
+  // Postcondition:
+  //   - edges of every axis are sorted edges of refs clipped to node_bounds
+  split_t best_split(bound_t const &node_bounds,
+                     std::vector<std::uint32_t> const &refs) {
+    auto const n = refs.size();
+    auto const inv_area = 1 / surface_area(node_bounds);
+    split_t res;
+    for (int axis = 0; axis < 3; ++axis) {
+      sort_edges(node_bounds, refs, axis);
+      auto const &axis_edges = edges[static_cast<std::size_t>(axis)];
+      auto const &range = axis_range(node_bounds, axis);
+      std::size_t num_below = 0;
+      std::size_t num_above = n;
+      for (std::size_t i = 0; i < axis_edges.size(); ++i) {
+        auto const &edge = axis_edges[i];
+        if (!edge.is_start)
+          --num_above;
+        if (range.min < edge.position && edge.position < range.max) {
+          auto below = node_bounds;
+          auto above = node_bounds;
+          axis_range(below, axis).max = edge.position;
+          axis_range(above, axis).min = edge.position;
+          auto const bonus =
+              num_below == 0 || num_above == 0 ? options.empty_bonus : 0.0;
+          auto const cost =
+              options.traversal_cost +
+              options.intersection_cost * (1 - bonus) * inv_area *
+                  (surface_area(below) * static_cast<double>(num_below) +
+                   surface_area(above) * static_cast<double>(num_above));
+          if (cost < res.cost)
+            res = {cost, axis, i};
+        }
+        if (edge.is_start)
+          ++num_below;
+      }
+    }
+    return res;
+  }
+
+  void make_leaf(std::vector<std::uint32_t> const &refs) {
+    nodes.push_back(make_kd_leaf(
+        static_cast<std::uint32_t>(object_indices.size()),
+        static_cast<std::uint32_t>(refs.size())));
+    object_indices.insert(object_indices.end(), refs.begin(), refs.end());
+  }
+
+  // Like Havran's termination criteria, a split costlier than a leaf is
+  // still taken a few times in a path, as splits below it may pay off.
+  void build(bound_t const &node_bounds, std::vector<std::uint32_t> refs,
+             std::size_t depth, int bad_refines) {
+    constexpr static int max_bad_refines = 3;
+    if (refs.size() <= options.max_leaf_objects || depth >= max_depth) {
+      make_leaf(refs);
+      return;
+    }
+    auto const split = best_split(node_bounds, refs);
+    auto const leaf_cost =
+        options.intersection_cost * static_cast<double>(refs.size());
+    if (split.cost > leaf_cost)
+      ++bad_refines;
+    if (split.axis == -1 || bad_refines == max_bad_refines ||
+        (split.cost > 4 * leaf_cost && refs.size() < 16)) {
+      make_leaf(refs);
+      return;
+    }
+    auto const &axis_edges = edges[static_cast<std::size_t>(split.axis)];
+    std::vector<std::uint32_t> below;
+    std::vector<std::uint32_t> above;
+    for (std::size_t i = 0; i < split.edge; ++i) {
+      if (axis_edges[i].is_start)
+        below.push_back(axis_edges[i].ref);
+    }
+    for (auto i = split.edge + 1; i < axis_edges.size(); ++i) {
+      if (!axis_edges[i].is_start)
+        above.push_back(axis_edges[i].ref);
+    }
+    auto const position = axis_edges[split.edge].position;
+    refs = {};
+
+    auto const index = nodes.size();
+    nodes.push_back({});
+    auto below_bounds = node_bounds;
+    auto above_bounds = node_bounds;
+    axis_range(below_bounds, split.axis).max = position;
+    axis_range(above_bounds, split.axis).min = position;
+    build(below_bounds, std::move(below), depth + 1, bad_refines);
+    nodes[index] = make_kd_interior(split.axis, position,
+                                    static_cast<std::uint32_t>(nodes.size()));
+    build(above_bounds, std::move(above), depth + 1, bad_refines);
+  }
+};
+} // namespace __kd_tree_details
+
+// kd-tree built by Surface Area Heuristic. Unlike bvh_t, it partitions space
+// instead of objects: children of a node never overlap and an object
+// crossing a split plane is referred from both children. So ray visits
+// leaves strictly front to back and stops at the first leaf whose closest
+// hit lies before its exit.
+template <typename Object> class kd_tree_t {
+public:
+  using object_type = Object;
+  using hit_object_type = hit_object_t<Object>;
+
+private:
+  std::vector<object_type> objects_;
+  std::vector<kd_node_t> nodes_;
+  std::vector<std::uint32_t> object_indices_;
+  bound_t bounds_;
+
+  void build(kd_tree_options const &options) {
+    if (objects_.empty())
+      return;
+    std::vector<bound_t> object_bounds;
+    object_bounds.reserve(objects_.size());
+    bound_t bounds;
+    for (auto const &obj : objects_) {
+      object_bounds.push_back(get_bounds(obj));
+      bounds = union_bounds(bounds, object_bounds.back());
+    }
+    bounds_ = pad_bounds(bounds);
+    auto const max_depth = std::min(
+        kd_tree_max_depth,
+        static_cast<std::size_t>(
+            8 + 1.3 * std::log2(static_cast<double>(objects_.size()))));
+    __kd_tree_details::builder builder{
+        object_bounds, options, max_depth, {}, {}, {}};
+    std::vector<std::uint32_t> refs(objects_.size());
+    for (std::size_t i = 0; i < refs.size(); ++i) {
+      refs[i] = static_cast<std::uint32_t>(i);
+    }
+    builder.build(bounds_, std::move(refs), 0, 0);
+    nodes_ = std::move(builder.nodes);
+    object_indices_ = std::move(builder.object_indices);
+  }
+
+  // Calls visit(leaf, exit_distance) for leaves pierced by r within interval
+  // in order until it returns true.
+  template <typename Visit>
+  void walk_leaves(ray_t const &r, interval_t const &interval,
+                   Visit &&visit) const {
+    struct pending_node {
+      std::uint32_t index;
+      double min;
+      double max;
+    };
+
+    if (nodes_.empty())
+      return;
+    auto const ray = prepare(r);
+    auto clipped = clip_interval(ray, to_minmax_bound(bounds_), interval);
+    if (clipped.min > clipped.max)
+      return;
+    std::array<pending_node, kd_tree_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    std::uint32_t cur = 0;
+    while (true) {
+      auto const &node = nodes_[cur];
+      if (!is_leaf(node)) {
+        auto const axis = split_axis(node);
+        auto const o = component(ray.origin, axis);
+        auto const plane_distance =
+            (node.split - o) * component(ray.inv_direction, axis);
+        auto const below_first =
+            o < node.split || (o == node.split &&
+                                ray.sign[static_cast<std::size_t>(axis)] == 1);
+        auto const first = below_first ? cur + 1 : node.offset;
+        auto const second = below_first ? node.offset : cur + 1;
+        if (plane_distance > clipped.max || plane_distance <= 0) {
+          cur = first;
+        } else if (plane_distance < clipped.min) {
+          cur = second;
+        } else {
+          to_visit[num_to_visit++] = {second, plane_distance, clipped.max};
+          cur = first;
+          clipped.max = plane_distance;
+        }
+        continue;
+      }
+      if (visit(node, clipped.max) || num_to_visit == 0)
+        return;
+      auto const pending = to_visit[--num_to_visit];
+      cur = pending.index;
+      clipped = {pending.min, pending.max};
+    }
+  }
+
+public:
+  template <std::ranges::random_access_range Range>
+  explicit kd_tree_t(Range &&rng, kd_tree_options const &options = {})
+      : objects_(to_object_vector<object_type>(std::forward<Range>(rng))) {
+    build(options);
+  }
+
+  // Postcondition:
+  //   - returns empty bound for kd-tree with no objects
+  bound_t bounds() const { return bounds_; }
+
+  std::vector<kd_node_t> const &nodes() const { return nodes_; }
+
+  std::vector<object_type> const &objects() const { return objects_; }
+
+  std::vector<std::uint32_t> const &object_indices() const {
+    return object_indices_;
+  }
+
+  auto hit_ray(ray_t const &r, interval_t interval) const {
+    std::optional<hit_info_t<hit_object_type>> res;
+    walk_leaves(r, interval, [&](kd_node_t const &leaf, double exit) {
+      auto const end = leaf.offset + leaf_count(leaf);
+      for (auto i = leaf.offset; i < end; ++i) {
+        auto hit_rec = hit(objects_[object_indices_[i]], r, interval);
+        if (hit_rec && (!res || hit_rec->hit_distance < res->hit_distance)) {
+          interval.max = hit_rec->hit_distance;
+          res = std::move(hit_rec);
+        }
+      }
+      return interval.max <= exit;
+    });
+    return res;
+  }
+
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    auto res = false;
+    walk_leaves(r, interval, [&](kd_node_t const &leaf, double exit) {
+      auto const end = leaf.offset + leaf_count(leaf);
+      for (auto i = leaf.offset; i < end && !res; ++i) {
+        res = is_occluded(objects_[object_indices_[i]], r, interval);
+      }
+      return res || interval.max <= exit;
+    });
+    return res;
+  }
+};
+
+template <std::ranges::random_access_range Range>
+kd_tree_t(Range &&rng) -> kd_tree_t<std::ranges::range_value_t<Range>>;
+
+template <std::ranges::random_access_range Range>
+kd_tree_t(Range &&rng, kd_tree_options const &)
+    -> kd_tree_t<std::ranges::range_value_t<Range>>;
+
+template <BoundedObject Object>
+inline bound_t get_bounds(kd_tree_t<Object> const &tree) {
+  return tree.bounds();
+}
+
+template <SceneObject Object>
+inline auto hit(kd_tree_t<Object> const &tree, ray_t const &r,
+                interval_t const &interval) {
+  return tree.hit_ray(r, interval);
+}
+
+template <SceneObject Object>
+inline bool occluded(kd_tree_t<Object> const &tree, ray_t const &r,
+                     interval_t const &interval) {
+  return tree.occluded_ray(r, interval);
+}
+} // namespace mrl
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "bound.hpp"
+#include "interval.hpp"
+#include "prepared_ray.hpp"
+#include "ray.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/layout.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/concepts.hpp"
+#include "traits.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace mrl {
+// Bvh with its nodes stored in order given by a BvhLayout, e.g. van Emde
+// Boas or profiled frequency order, instead of depth first order of bvh_t.
+// Nodes are of same size as those of bvh_t and traversed the same way, so it
+// differs from bvh_t only in which nodes share cache lines and pages.
+template <typename Object> class laid_out_bvh_t {
+public:
+  using object_type = Object;
+  using hit_object_type = hit_object_t<Object>;
+
+private:
+  std::vector<object_type> objects_;
+  std::vector<bvh_layout_node_t> nodes_;
+
+public:
+  // Precondition:
+  //   - nodes form a bvh over objects as described by bvh_node_t
+  template <BvhLayout Layout = van_emde_boas_layout>
+  laid_out_bvh_t(std::vector<object_type> objects,
+                 std::vector<bvh_node_t> const &nodes,
+                 Layout const &layout = {})
+      : objects_(std::move(objects)),
+        nodes_(lay_out_bvh_nodes(nodes, layout)) {}
+
+  template <BvhLayout Layout = van_emde_boas_layout>
+  explicit laid_out_bvh_t(bvh_t<object_type> const &bvh,
+                          Layout const &layout = {})
+      : laid_out_bvh_t(bvh.objects(), bvh.nodes(), layout) {}
+
+  // Postcondition:
+  //   - returns empty bound for bvh with no objects
+  bound_t bounds() const {
+    if (nodes_.empty())
+      return bound_t{};
+    return to_bound(nodes_.front().bounds);
+  }
+
+  std::vector<bvh_layout_node_t> const &nodes() const { return nodes_; }
+
+  std::vector<object_type> const &objects() const { return objects_; }
+
+  // Same as bvh_t::hit_ray.
+  auto hit_ray(ray_t const &r, interval_t interval) const {
+    struct pending_node {
+      std::uint32_t index;
+      double entry_distance;
+    };
+
+    std::optional<hit_info_t<hit_object_type>> res;
+    auto const ray = prepare(r);
+    if (nodes_.empty() || !hit_bounds(ray, nodes_.front().bounds, interval))
+      return res;
+    std::array<pending_node, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    std::uint32_t cur = 0;
+    while (true) {
+      auto const &node = nodes_[cur];
+      if (is_leaf(node)) {
+        for (auto i = node.left; i < node.left + node.count; ++i) {
+          auto hit_rec = hit(objects_[i], r, interval);
+          if (hit_rec && (!res || hit_rec->hit_distance < res->hit_distance)) {
+            interval.max = hit_rec->hit_distance;
+            res = std::move(hit_rec);
+          }
+        }
+      } else {
+        auto const left = node.left;
+        auto const right = node.right;
+        auto const left_clip =
+            clip_interval(ray, nodes_[left].bounds, interval);
+        auto const right_clip =
+            clip_interval(ray, nodes_[right].bounds, interval);
+        auto const hit_left = left_clip.min <= left_clip.max;
+        auto const hit_right = right_clip.min <= right_clip.max;
+        if (hit_left && hit_right) {
+          auto const left_first = left_clip.min <= right_clip.min;
+          cur = left_first ? left : right;
+          to_visit[num_to_visit++] =
+              left_first ? pending_node{right, right_clip.min}
+                         : pending_node{left, left_clip.min};
+          continue;
+        }
+        if (hit_left || hit_right) {
+          cur = hit_left ? left : right;
+          continue;
+        }
+      }
+      auto found = false;
+      while (num_to_visit > 0 && !found) {
+        auto const pending = to_visit[--num_to_visit];
+        found = pending.entry_distance <= interval.max;
+        cur = pending.index;
+      }
+      if (!found)
+        break;
+    }
+    return res;
+  }
+
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    auto const ray = prepare(r);
+    if (nodes_.empty() || !hit_bounds(ray, nodes_.front().bounds, interval))
+      return false;
+    std::array<std::uint32_t, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    to_visit[num_to_visit++] = 0;
+    while (num_to_visit > 0) {
+      auto const cur = to_visit[--num_to_visit];
+      auto const &node = nodes_[cur];
+      if (is_leaf(node)) {
+        for (auto i = node.left; i < node.left + node.count; ++i) {
+          if (is_occluded(objects_[i], r, interval))
+            return true;
+        }
+        continue;
+      }
+      if (hit_bounds(ray, nodes_[node.right].bounds, interval))
+        to_visit[num_to_visit++] = node.right;
+      if (hit_bounds(ray, nodes_[node.left].bounds, interval))
+        to_visit[num_to_visit++] = node.left;
+    }
+    return false;
+  }
+};
+
+template <typename Object>
+laid_out_bvh_t(bvh_t<Object> const &) -> laid_out_bvh_t<Object>;
+
+template <typename Object, BvhLayout Layout>
+laid_out_bvh_t(bvh_t<Object> const &, Layout const &)
+    -> laid_out_bvh_t<Object>;
+
+template <BoundedObject Object>
+inline bound_t get_bounds(laid_out_bvh_t<Object> const &bvh) {
+  return bvh.bounds();
+}
+
+template <SceneObject Object>
+inline auto hit(laid_out_bvh_t<Object> const &bvh, ray_t const &r,
+                interval_t const &interval) {
+  return bvh.hit_ray(r, interval);
+}
+
+template <SceneObject Object>
+inline bool occluded(laid_out_bvh_t<Object> const &bvh, ray_t const &r,
+                     interval_t const &interval) {
+  return bvh.occluded_ray(r, interval);
+}
+
+// SceneObject counting how many times rays visit every node of bvh while
+// hitting it. Rendering it instead of bvh with few samples per pixel before
+// the final render gives frequency_layout for that view. Counts are added
+// with relaxed atomics, so it may be rendered in parallel.
+//
+// Class Invariant:
+//   - bvh outlives profiler
+template <typename Object> class bvh_profiler_t {
+public:
+  using object_type = Object;
+  using hit_object_type = hit_object_t<Object>;
+
+private:
+  bvh_t<object_type> const *bvh_;
+  mutable std::vector<std::uint64_t> visits_;
+
+public:
+  explicit bvh_profiler_t(bvh_t<object_type> const &bvh)
+      : bvh_(&bvh), visits_(bvh.nodes().size()) {}
+
+  // Postcondition:
+  //   - returns number of times node i of bvh was visited at index i
+  std::vector<std::uint64_t> const &visits() const { return visits_; }
+
+  frequency_layout layout() const { return {visits_}; }
+
+  bound_t bounds() const { return bvh_->bounds(); }
+
+  auto hit_ray(ray_t const &r, interval_t const &interval) const {
+    return bvh_->hit_ray(r, interval, [this](std::uint32_t index) {
+      std::atomic_ref{visits_[index]}.fetch_add(1, std::memory_order_relaxed);
+    });
+  }
+
+  // Shadow rays are not counted.
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    return bvh_->occluded_ray(r, interval);
+  }
+};
+
+template <typename Object>
+bvh_profiler_t(bvh_t<Object> const &) -> bvh_profiler_t<Object>;
+
+template <BoundedObject Object>
+inline bound_t get_bounds(bvh_profiler_t<Object> const &profiler) {
+  return profiler.bounds();
+}
+
+template <SceneObject Object>
+inline auto hit(bvh_profiler_t<Object> const &profiler, ray_t const &r,
+                interval_t const &interval) {
+  return profiler.hit_ray(r, interval);
+}
+
+template <SceneObject Object>
+inline bool occluded(bvh_profiler_t<Object> const &profiler, ray_t const &r,
+                     interval_t const &interval) {
+  return profiler.occluded_ray(r, interval);
+}
+} // namespace mrl
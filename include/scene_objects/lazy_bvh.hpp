@@ -0,0 +1,317 @@
+#pragma once
+
+#include "bound.hpp"
+#include "interval.hpp"
+#include "prepared_ray.hpp"
+#include "ray.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/concepts.hpp"
+#include "traits.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+namespace mrl {
+struct lazy_bvh_options {
+  // Levels of bvh built up front. Every node at this depth is root of a
+  // subtree built on its first visit. Depth beyond max_split_depth of bvh
+  // builders is clamped to it.
+  std::size_t top_depth = 8;
+};
+
+// Bvh built on demand, for preview renders of huge scenes that should not
+// wait for whole bvh to be built. Top levels are built on construction and
+// subtrees below them on first visit of a ray, so parts of the scene no ray
+// reaches (off-screen or occluded) are never built.
+//
+// Rays may hit it concurrently. Every subtree has a once flag, a ray
+// visiting a subtree being built waits for it and other subtrees are built
+// in parallel. Building a subtree reorders objects of its range only.
+//
+// Class Invariant:
+//   - top_nodes_ form a bvh as described by bvh_node_t, except that a leaf
+//     stands for subtree at index offset over count objects
+//   - objects of subtree i are objects_[subtrees_[i].begin,
+//     subtrees_[i].end), in order of refs_ once it is built
+template <typename Object, typename Split = median_split> class lazy_bvh_t {
+public:
+  using object_type = Object;
+  using hit_object_type = hit_object_t<Object>;
+
+private:
+  struct subtree_t {
+    std::once_flag once;
+    std::atomic<bool> is_built{false};
+    std::uint32_t begin = 0;
+    std::uint32_t end = 0;
+    std::vector<bvh_node_t> nodes;
+  };
+
+  mutable std::vector<object_type> objects_;
+  mutable std::vector<bvh_primitive_ref_t> refs_;
+  Split split_;
+  std::size_t top_depth_;
+  std::vector<bvh_node_t> top_nodes_;
+  mutable std::vector<subtree_t> subtrees_;
+
+  // Postcondition:
+  //   - returns index of root node of built top tree
+  std::uint32_t
+  build_top(std::uint32_t begin, std::uint32_t end, std::size_t depth,
+            std::vector<std::array<std::uint32_t, 2>> &ranges) {
+    auto const index = static_cast<std::uint32_t>(top_nodes_.size());
+    top_nodes_.push_back({});
+    if (depth == top_depth_ || end - begin == 1) {
+      auto bounds = refs_[begin].bounds;
+      for (auto i = begin + 1; i < end; ++i) {
+        bounds = union_bounds(bounds, refs_[i].bounds);
+      }
+      top_nodes_[index] = bvh_node_t{
+          .bounds = to_minmax_bound(bounds),
+          .offset = static_cast<std::uint32_t>(ranges.size()),
+          .count = end - begin,
+      };
+      ranges.push_back({begin, end});
+      return index;
+    }
+    auto const first = refs_.begin();
+    auto const mid =
+        static_cast<std::uint32_t>(split_(first + begin, first + end) - first);
+    build_top(begin, mid, depth + 1, ranges);
+    auto const right = build_top(mid, end, depth + 1, ranges);
+    top_nodes_[index] = bvh_node_t{
+        .bounds = union_bounds(top_nodes_[index + 1].bounds,
+                               top_nodes_[right].bounds),
+        .offset = right,
+        .count = 0,
+    };
+    return index;
+  }
+
+  void build_subtree(subtree_t &subtree) const {
+    auto const first = refs_.begin();
+    auto const begin = first + subtree.begin;
+    auto const end = first + subtree.end;
+    __bvh_build_details::builder<bvh_primitive_iterator, Split> builder{
+        first, split_, {}};
+    builder.nodes.reserve(2 * std::size_t{subtree.end - subtree.begin} - 1);
+    builder.build(begin, end, top_depth_);
+    std::vector<object_type> reordered;
+    reordered.reserve(subtree.end - subtree.begin);
+    for (auto it = begin; it != end; ++it) {
+      reordered.push_back(std::move(objects_[it->index]));
+    }
+    std::ranges::move(reordered, objects_.begin() + subtree.begin);
+    subtree.nodes = std::move(builder.nodes);
+    subtree.is_built.store(true, std::memory_order_release);
+  }
+
+  std::vector<bvh_node_t> const &subtree_nodes(std::uint32_t i) const {
+    auto &subtree = subtrees_[i];
+    std::call_once(subtree.once, [this, &subtree] { build_subtree(subtree); });
+    return subtree.nodes;
+  }
+
+  // Same traversal as bvh_t::hit_ray over nodes, calling visit_leaf(leaf)
+  // for every leaf reached. visit_leaf narrows interval to hits it finds.
+  template <typename VisitLeaf>
+  static void traverse(std::vector<bvh_node_t> const &nodes,
+                       prepared_ray_t const &ray, interval_t &interval,
+                       VisitLeaf &&visit_leaf) {
+    struct pending_node {
+      std::uint32_t index;
+      double entry_distance;
+    };
+
+    std::array<pending_node, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    std::uint32_t cur = 0;
+    while (true) {
+      auto const &node = nodes[cur];
+      if (is_leaf(node)) {
+        visit_leaf(node);
+      } else {
+        auto const left = cur + 1;
+        auto const right = node.offset;
+        auto const left_clip = clip_interval(ray, nodes[left].bounds, interval);
+        auto const right_clip =
+            clip_interval(ray, nodes[right].bounds, interval);
+        auto const hit_left = left_clip.min <= left_clip.max;
+        auto const hit_right = right_clip.min <= right_clip.max;
+        if (hit_left && hit_right) {
+          auto const left_first = left_clip.min <= right_clip.min;
+          cur = left_first ? left : right;
+          to_visit[num_to_visit++] =
+              left_first ? pending_node{right, right_clip.min}
+                         : pending_node{left, left_clip.min};
+          continue;
+        }
+        if (hit_left || hit_right) {
+          cur = hit_left ? left : right;
+          continue;
+        }
+      }
+      auto found = false;
+      while (num_to_visit > 0 && !found) {
+        auto const pending = to_visit[--num_to_visit];
+        found = pending.entry_distance <= interval.max;
+        cur = pending.index;
+      }
+      if (!found)
+        break;
+    }
+  }
+
+  // Postcondition:
+  //   - returns true as soon as is_hit(leaf) is true for a leaf of nodes hit
+  //     by ray
+  template <typename IsHit>
+  static bool any_leaf(std::vector<bvh_node_t> const &nodes,
+                       prepared_ray_t const &ray, interval_t const &interval,
+                       IsHit &&is_hit) {
+    std::array<std::uint32_t, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    to_visit[num_to_visit++] = 0;
+    while (num_to_visit > 0) {
+      auto const cur = to_visit[--num_to_visit];
+      auto const &node = nodes[cur];
+      if (is_leaf(node)) {
+        if (is_hit(node))
+          return true;
+        continue;
+      }
+      auto const left = cur + 1;
+      if (hit_bounds(ray, nodes[node.offset].bounds, interval))
+        to_visit[num_to_visit++] = node.offset;
+      if (hit_bounds(ray, nodes[left].bounds, interval))
+        to_visit[num_to_visit++] = left;
+    }
+    return false;
+  }
+
+public:
+  // Computes bounds of all objects and splits top levels with split, which
+  // takes O(n * top_depth) time.
+  template <std::ranges::random_access_range Range>
+    requires BvhSplitStrategy<Split, bvh_primitive_iterator>
+  lazy_bvh_t(Range &&rng, Split split = {}, lazy_bvh_options options = {})
+      : objects_(to_object_vector<object_type>(std::forward<Range>(rng))),
+        refs_(make_primitive_refs(objects_)), split_(std::move(split)),
+        top_depth_(
+            std::min(options.top_depth, __bvh_build_details::max_split_depth)) {
+    if (objects_.empty())
+      return;
+    std::vector<std::array<std::uint32_t, 2>> ranges;
+    build_top(0, static_cast<std::uint32_t>(objects_.size()), 0, ranges);
+    reorder_objects(objects_, refs_);
+    for (std::size_t i = 0; i < refs_.size(); ++i) {
+      refs_[i].index = static_cast<std::uint32_t>(i);
+    }
+    subtrees_ = std::vector<subtree_t>(ranges.size());
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+      subtrees_[i].begin = ranges[i][0];
+      subtrees_[i].end = ranges[i][1];
+    }
+  }
+
+  // Postcondition:
+  //   - returns empty bound for bvh with no objects
+  bound_t bounds() const {
+    if (top_nodes_.empty())
+      return bound_t{};
+    return to_bound(top_nodes_.front().bounds);
+  }
+
+  std::size_t num_subtrees() const { return subtrees_.size(); }
+
+  std::size_t num_built_subtrees() const {
+    return static_cast<std::size_t>(
+        std::ranges::count_if(subtrees_, [](subtree_t const &subtree) {
+          return subtree.is_built.load(std::memory_order_acquire);
+        }));
+  }
+
+  // Builds subtrees no ray has visited yet, e.g. before a final render.
+  void build_all() const {
+    for (std::uint32_t i = 0; i < subtrees_.size(); ++i) {
+      subtree_nodes(i);
+    }
+  }
+
+  auto hit_ray(ray_t const &r, interval_t interval) const {
+    std::optional<hit_info_t<hit_object_type>> res;
+    auto const ray = prepare(r);
+    if (top_nodes_.empty() ||
+        !hit_bounds(ray, top_nodes_.front().bounds, interval))
+      return res;
+    auto hit_objects = [&](bvh_node_t const &leaf) {
+      for (auto i = leaf.offset; i < leaf.offset + leaf.count; ++i) {
+        auto hit_rec = hit(objects_[i], r, interval);
+        if (hit_rec && (!res || hit_rec->hit_distance < res->hit_distance)) {
+          interval.max = hit_rec->hit_distance;
+          res = std::move(hit_rec);
+        }
+      }
+    };
+    traverse(top_nodes_, ray, interval, [&](bvh_node_t const &top_leaf) {
+      traverse(subtree_nodes(top_leaf.offset), ray, interval, hit_objects);
+    });
+    return res;
+  }
+
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    auto const ray = prepare(r);
+    if (top_nodes_.empty() ||
+        !hit_bounds(ray, top_nodes_.front().bounds, interval))
+      return false;
+    auto occluded_by_objects = [&](bvh_node_t const &leaf) {
+      for (auto i = leaf.offset; i < leaf.offset + leaf.count; ++i) {
+        if (is_occluded(objects_[i], r, interval))
+          return true;
+      }
+      return false;
+    };
+    return any_leaf(top_nodes_, ray, interval, [&](bvh_node_t const &leaf) {
+      return any_leaf(subtree_nodes(leaf.offset), ray, interval,
+                      occluded_by_objects);
+    });
+  }
+};
+
+template <std::ranges::random_access_range Range>
+lazy_bvh_t(Range &&rng) -> lazy_bvh_t<std::ranges::range_value_t<Range>>;
+
+template <std::ranges::random_access_range Range, typename Split>
+lazy_bvh_t(Range &&rng, Split)
+    -> lazy_bvh_t<std::ranges::range_value_t<Range>, Split>;
+
+template <std::ranges::random_access_range Range, typename Split>
+lazy_bvh_t(Range &&rng, Split, lazy_bvh_options)
+    -> lazy_bvh_t<std::ranges::range_value_t<Range>, Split>;
+
+template <BoundedObject Object, typename Split>
+inline bound_t get_bounds(lazy_bvh_t<Object, Split> const &bvh) {
+  return bvh.bounds();
+}
+
+template <SceneObject Object, typename Split>
+inline auto hit(lazy_bvh_t<Object, Split> const &bvh, ray_t const &r,
+                interval_t const &interval) {
+  return bvh.hit_ray(r, interval);
+}
+
+template <SceneObject Object, typename Split>
+inline bool occluded(lazy_bvh_t<Object, Split> const &bvh, ray_t const &r,
+                     interval_t const &interval) {
+  return bvh.occluded_ray(r, interval);
+}
+} // namespace mrl
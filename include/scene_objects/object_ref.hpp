@@ -1,5 +1,6 @@
 #pragma once
 
+#include "interval.hpp"
 #include "ray.hpp"
 #include "scene_objects/concepts.hpp"
 
@@ -16,8 +17,15 @@ template <typename Object>
 object_ref_t(Object &obj_ref) -> object_ref_t<Object>;
 
 template <SceneObject Object>
-constexpr auto hit(object_ref_t<Object> const &obj, ray_t const &r) {
-  return hit(*(obj.object), r);
+constexpr auto hit(object_ref_t<Object> const &obj, ray_t const &r,
+                   interval_t const &interval) {
+  return hit(*(obj.object), r, interval);
+}
+
+template <SceneObject Object>
+constexpr bool occluded(object_ref_t<Object> const &obj, ray_t const &r,
+                        interval_t const &interval) {
+  return is_occluded(*(obj.object), r, interval);
 }
 
 template <BoundedObject Object>
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "bound.hpp"
+#include "interval.hpp"
+#include "prepared_ray.hpp"
+#include "ray.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/quantized_node.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/concepts.hpp"
+#include "traits.hpp"
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ranges>
+#include <vector>
+
+namespace mrl {
+// Bvh with child bounds quantized to Quant (8 or 16 bits per coordinate)
+// relative to their parent, see quantized_bvh_node_t. A node holds both of
+// its children, taking 28 bytes with 8 bits and 40 bytes with 16 bits per
+// two children instead of 128 bytes of two bvh_node_t. Decoded bounds are
+// slightly larger than exact ones, so rays visit a few more nodes.
+template <typename Object, std::unsigned_integral Quant = std::uint8_t>
+class quantized_bvh_t {
+public:
+  using object_type = Object;
+  using hit_object_type = hit_object_t<Object>;
+  using node_type = quantized_bvh_node_t<Quant>;
+
+private:
+  std::vector<object_type> objects_;
+  std::vector<node_type> nodes_;
+  minmax_bound_t bounds_;
+
+  struct pending_node {
+    std::uint32_t index;
+    double entry_distance;
+    minmax_bound_t bounds;
+  };
+
+public:
+  template <std::ranges::random_access_range Range,
+            typename Split = median_split>
+    requires BvhSplitStrategy<Split, bvh_primitive_iterator>
+  quantized_bvh_t(Range &&rng, Split split = {})
+      : objects_(to_object_vector<object_type>(std::forward<Range>(rng))),
+        bounds_(to_minmax_bound(bound_t{})) {
+    auto const binary_nodes = build_bvh_nodes(objects_, split);
+    nodes_ = quantize_bvh_nodes<Quant>(binary_nodes);
+    if (!binary_nodes.empty())
+      bounds_ = binary_nodes.front().bounds;
+  }
+
+  bound_t bounds() const { return to_bound(bounds_); }
+
+  std::vector<node_type> const &nodes() const { return nodes_; }
+
+  std::vector<object_type> const &objects() const { return objects_; }
+
+  // Same as bvh_t::hit_ray, with bounds of children decoded from bounds of
+  // current node.
+  auto hit_ray(ray_t const &r, interval_t interval) const {
+    std::optional<hit_info_t<hit_object_type>> res;
+    auto const ray = prepare(r);
+    if (nodes_.empty() || !hit_bounds(ray, bounds_, interval))
+      return res;
+    std::array<pending_node, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    std::uint32_t cur = 0;
+    auto cur_bounds = bounds_;
+    while (true) {
+      auto const &node = nodes_[cur];
+      auto const step = quantization_step<Quant>(cur_bounds);
+      std::array<minmax_bound_t, 2> const bounds{
+          child_bounds(node, 0, cur_bounds, step),
+          child_bounds(node, 1, cur_bounds, step),
+      };
+      std::array<interval_t, 2> const clip{
+          clip_interval(ray, bounds[0], interval),
+          clip_interval(ray, bounds[1], interval),
+      };
+      for (std::size_t i = 0; i < 2; ++i) {
+        if (node.count[i] == 0 || clip[i].min > clip[i].max)
+          continue;
+        for (auto j = node.child[i]; j < node.child[i] + node.count[i]; ++j) {
+          auto hit_rec = hit(objects_[j], r, interval);
+          if (hit_rec && (!res || hit_rec->hit_distance < res->hit_distance)) {
+            interval.max = hit_rec->hit_distance;
+            res = std::move(hit_rec);
+          }
+        }
+      }
+      auto descend = [&node, &clip, &interval](std::size_t i) {
+        return node.count[i] == 0 && clip[i].min <= clip[i].max &&
+               clip[i].min <= interval.max;
+      };
+      auto const hit_left = descend(0);
+      auto const hit_right = descend(1);
+      if (hit_left && hit_right) {
+        auto const first = clip[0].min <= clip[1].min ? 0uz : 1uz;
+        auto const second = 1 - first;
+        to_visit[num_to_visit++] = {node.child[second], clip[second].min,
+                                    bounds[second]};
+        cur = node.child[first];
+        cur_bounds = bounds[first];
+        continue;
+      }
+      if (hit_left || hit_right) {
+        auto const i = hit_left ? 0uz : 1uz;
+        cur = node.child[i];
+        cur_bounds = bounds[i];
+        continue;
+      }
+      auto found = false;
+      while (num_to_visit > 0 && !found) {
+        auto const &pending = to_visit[--num_to_visit];
+        found = pending.entry_distance <= interval.max;
+        cur = pending.index;
+        cur_bounds = pending.bounds;
+      }
+      if (!found)
+        break;
+    }
+    return res;
+  }
+
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    auto const ray = prepare(r);
+    if (nodes_.empty() || !hit_bounds(ray, bounds_, interval))
+      return false;
+    std::array<pending_node, bvh_max_depth> to_visit;
+    std::size_t num_to_visit = 0;
+    to_visit[num_to_visit++] = {0, 0, bounds_};
+    while (num_to_visit > 0) {
+      auto const pending = to_visit[--num_to_visit];
+      auto const &node = nodes_[pending.index];
+      auto const step = quantization_step<Quant>(pending.bounds);
+      for (std::size_t i = 0; i < 2; ++i) {
+        auto const bounds = child_bounds(node, i, pending.bounds, step);
+        if (!hit_bounds(ray, bounds, interval))
+          continue;
+        if (node.count[i] == 0) {
+          to_visit[num_to_visit++] = {node.child[i], 0, bounds};
+          continue;
+        }
+        for (auto j = node.child[i]; j < node.child[i] + node.count[i]; ++j) {
+          if (is_occluded(objects_[j], r, interval))
+            return true;
+        }
+      }
+    }
+    return false;
+  }
+};
+
+template <BoundedObject Object, std::unsigned_integral Quant>
+inline bound_t get_bounds(quantized_bvh_t<Object, Quant> const &bvh) {
+  return bvh.bounds();
+}
+
+template <SceneObject Object, std::unsigned_integral Quant>
+inline auto hit(quantized_bvh_t<Object, Quant> const &bvh, ray_t const &r,
+                interval_t const &interval) {
+  return bvh.hit_ray(r, interval);
+}
+
+template <SceneObject Object, std::unsigned_integral Quant>
+inline bool occluded(quantized_bvh_t<Object, Quant> const &bvh, ray_t const &r,
+                     interval_t const &interval) {
+  return bvh.occluded_ray(r, interval);
+}
+} // namespace mrl
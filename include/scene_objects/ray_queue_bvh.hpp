@@ -0,0 +1,240 @@
+#pragma once
+
+#include "bound.hpp"
+#include "interval.hpp"
+#include "prepared_ray.hpp"
+#include "ray.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/stats.hpp"
+#include "scene_objects/bvh/treelet_partition.hpp"
+#include "scene_objects/concepts.hpp"
+#include "traits.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace mrl {
+struct ray_queue_options {
+  // Bytes of nodes and objects of every treelet. A treelet should fit in
+  // cache of the core tracing rays through it, e.g. its L2 cache.
+  std::size_t treelet_bytes = 1024 * 1024;
+};
+
+// Bvh for streams of incoherent rays (e.g. bounce rays) through scenes much
+// larger than last level cache. Its nodes are partitioned into treelets
+// fitting in cache. hit_stream traces all rays of a stream waiting on a
+// treelet before moving to the next one: a ray reaching a node of another
+// treelet is queued on that treelet and resumes from that node when the
+// treelet is traced. So nodes and objects of a treelet are loaded in cache
+// once for all rays waiting on it, instead of once for each of them.
+//
+// Every ray keeps its own stack of pending nodes and waits on one treelet at
+// a time, so it visits nodes in same front to back order as with
+// bvh_t::hit_ray and its hit is same. Stacks of all rays of a stream share
+// one buffer, each as deep as the bvh.
+template <typename Object> class ray_queue_bvh_t {
+public:
+  using object_type = Object;
+  using hit_object_type = hit_object_t<Object>;
+
+private:
+  struct pending_node {
+    std::uint32_t index;
+    double entry_distance;
+  };
+
+  struct stream_t {
+    std::span<ray_t const> rays;
+    interval_t interval;
+    std::span<std::optional<hit_info_t<hit_object_type>>> hits;
+    // Stack of ray i is to_visit[i * stack_size, i * stack_size +
+    // num_to_visit[i]).
+    std::vector<pending_node> to_visit;
+    std::vector<std::uint32_t> num_to_visit;
+    std::vector<std::vector<std::uint32_t>> queues;
+  };
+
+  bvh_t<object_type> bvh_;
+  bvh_treelet_partition_t treelets_;
+  // A stack holds at most one sibling of every node on path to current node,
+  // and current node itself while ray waits on a treelet.
+  std::size_t stack_size_;
+
+  // Traverses ray from node on top of its stack, which is in treelet, till
+  // it is done or reaches a node of another treelet.
+  //
+  // Postcondition:
+  //   - returns true if ray was queued on another treelet
+  bool trace_queued(stream_t &stream, std::uint32_t treelet,
+                    std::uint32_t ray_index) const {
+    auto const &nodes = bvh_.nodes();
+    auto const &objects = bvh_.objects();
+    auto const &r = stream.rays[ray_index];
+    auto const ray = prepare(r);
+    auto const to_visit = std::span(stream.to_visit)
+                              .subspan(ray_index * stack_size_, stack_size_);
+    auto &num_to_visit = stream.num_to_visit[ray_index];
+    auto &res = stream.hits[ray_index];
+    auto interval = stream.interval;
+    if (res)
+      interval.max = res->hit_distance;
+    auto cur = to_visit[--num_to_visit];
+    while (true) {
+      auto const cur_treelet = treelets_.treelet_of[cur.index];
+      if (cur_treelet != treelet) {
+        to_visit[num_to_visit++] = cur;
+        stream.queues[cur_treelet].push_back(ray_index);
+        return true;
+      }
+      auto const &node = nodes[cur.index];
+      if (is_leaf(node)) {
+        for (auto i = node.offset; i < node.offset + node.count; ++i) {
+          auto hit_rec = hit(objects[i], r, interval);
+          if (hit_rec && (!res || hit_rec->hit_distance < res->hit_distance)) {
+            interval.max = hit_rec->hit_distance;
+            res = std::move(hit_rec);
+          }
+        }
+      } else {
+        auto const left = cur.index + 1;
+        auto const right = node.offset;
+        auto const left_clip = clip_interval(ray, nodes[left].bounds, interval);
+        auto const right_clip =
+            clip_interval(ray, nodes[right].bounds, interval);
+        auto const hit_left = left_clip.min <= left_clip.max;
+        auto const hit_right = right_clip.min <= right_clip.max;
+        if (hit_left && hit_right) {
+          auto const left_first = left_clip.min <= right_clip.min;
+          cur = left_first ? pending_node{left, left_clip.min}
+                           : pending_node{right, right_clip.min};
+          to_visit[num_to_visit++] =
+              left_first ? pending_node{right, right_clip.min}
+                         : pending_node{left, left_clip.min};
+          continue;
+        }
+        if (hit_left || hit_right) {
+          cur = hit_left ? pending_node{left, left_clip.min}
+                         : pending_node{right, right_clip.min};
+          continue;
+        }
+      }
+      auto found = false;
+      while (num_to_visit > 0 && !found) {
+        cur = to_visit[--num_to_visit];
+        found = cur.entry_distance <= interval.max;
+      }
+      if (!found)
+        return false;
+    }
+  }
+
+public:
+  explicit ray_queue_bvh_t(bvh_t<object_type> bvh,
+                           ray_queue_options options = {})
+      : bvh_(std::move(bvh)),
+        treelets_(partition_treelets(bvh_.nodes(), sizeof(object_type),
+                                     options.treelet_bytes)),
+        stack_size_(bvh_stats(bvh_.nodes()).max_depth + 1) {}
+
+  bvh_t<object_type> const &bvh() const { return bvh_; }
+
+  bvh_treelet_partition_t const &treelets() const { return treelets_; }
+
+  bound_t bounds() const { return bvh_.bounds(); }
+
+  auto hit_ray(ray_t const &r, interval_t const &interval) const {
+    return bvh_.hit_ray(r, interval);
+  }
+
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    return bvh_.occluded_ray(r, interval);
+  }
+
+  // Longer streams queue more rays on every treelet, which pays off more,
+  // but stack of pending nodes of every ray is kept while it waits on a
+  // treelet, taking rays.size() * (depth of bvh + 1) * 16 bytes. Streams of
+  // some 10^5 rays work well.
+  //
+  // Precondition:
+  //   - rays.size() == hits.size()
+  //   - rays.size() < 2^32
+  void
+  hit_stream(std::span<ray_t const> rays, interval_t const &interval,
+             std::span<std::optional<hit_info_t<hit_object_type>>> hits) const {
+    std::ranges::fill(hits, std::nullopt);
+    auto const &nodes = bvh_.nodes();
+    if (nodes.empty())
+      return;
+    stream_t stream{
+        .rays = rays,
+        .interval = interval,
+        .hits = hits,
+        .to_visit = std::vector<pending_node>(rays.size() * stack_size_),
+        .num_to_visit = std::vector<std::uint32_t>(rays.size()),
+        .queues = std::vector<std::vector<std::uint32_t>>(
+            treelets_.num_treelets),
+    };
+    std::size_t num_queued = 0;
+    for (std::size_t i = 0; i < rays.size(); ++i) {
+      auto const clip =
+          clip_interval(prepare(rays[i]), nodes.front().bounds, interval);
+      if (clip.min > clip.max)
+        continue;
+      stream.to_visit[i * stack_size_] = {0, clip.min};
+      stream.num_to_visit[i] = 1;
+      stream.queues.front().push_back(static_cast<std::uint32_t>(i));
+      ++num_queued;
+    }
+    // Rays mostly move to treelets below, so treelets are swept in depth
+    // first order of their roots till no ray waits on any.
+    while (num_queued > 0) {
+      for (std::uint32_t treelet = 0; treelet < treelets_.num_treelets;
+           ++treelet) {
+        if (stream.queues[treelet].empty())
+          continue;
+        auto const queue = std::move(stream.queues[treelet]);
+        stream.queues[treelet].clear();
+        for (auto ray_index : queue) {
+          if (!trace_queued(stream, treelet, ray_index))
+            --num_queued;
+        }
+      }
+    }
+  }
+};
+
+template <typename Object>
+ray_queue_bvh_t(bvh_t<Object>) -> ray_queue_bvh_t<Object>;
+
+template <typename Object>
+ray_queue_bvh_t(bvh_t<Object>, ray_queue_options) -> ray_queue_bvh_t<Object>;
+
+template <BoundedObject Object>
+inline bound_t get_bounds(ray_queue_bvh_t<Object> const &bvh) {
+  return bvh.bounds();
+}
+
+template <SceneObject Object>
+inline auto hit(ray_queue_bvh_t<Object> const &bvh, ray_t const &r,
+                interval_t const &interval) {
+  return bvh.hit_ray(r, interval);
+}
+
+template <SceneObject Object>
+inline bool occluded(ray_queue_bvh_t<Object> const &bvh, ray_t const &r,
+                     interval_t const &interval) {
+  return bvh.occluded_ray(r, interval);
+}
+
+template <SceneObject Object>
+inline void hit_stream(ray_queue_bvh_t<Object> const &bvh,
+                       std::span<ray_t const> rays, interval_t const &interval,
+                       std::span<std::optional<hit_info_of<Object>>> hits) {
+  bvh.hit_stream(rays, interval, hits);
+}
+} // namespace mrl
@@ -37,8 +37,8 @@ rotate_object(Object, ray_t, angle_t) -> rotate_object<Object>;
 template <typename Object>
 constexpr auto scaling_2d_at(rotate_hit_object<Object> const &o,
                              point3 const &p) {
-  return scaling_2d_at(o.hit_obj,
-                       rotate(p, o.axis_of_rotation, -o.angle_of_rotation));
+  return scaling_2d_at(
+      o.hit_obj, rotate_point(p, o.axis_of_rotation, -o.angle_of_rotation));
 }
 
 template <DoubleGenerator Generator, SceneObject Object>
@@ -53,15 +53,16 @@ constexpr auto scattering_for(rotate_hit_object<Object> const &o,
 template <DoubleGenerator Generator, SceneObject Object>
 constexpr auto emission_at(rotate_hit_object<Object> const &o, point3 const &p,
                            generator_view<Generator> rand) {
-  return emission_at(o.hit_obj,
-                     rotate(p, o.axis_of_rotation, -o.angle_of_rotation), rand);
+  return emission_at(
+      o.hit_obj, rotate_point(p, o.axis_of_rotation, -o.angle_of_rotation),
+      rand);
 }
 
 template <SceneObject Object>
 constexpr auto normal_at(rotate_hit_object<Object> const &o, point3 const &p) {
-  auto n =
-      normal_at(o.hit_obj, rotate(p, o.axis_of_rotation, -o.angle_of_rotation))
-          .val();
+  auto n = normal_at(o.hit_obj,
+                     rotate_point(p, o.axis_of_rotation, -o.angle_of_rotation))
+               .val();
   n = rotate(n, o.axis_of_rotation, o.angle_of_rotation);
   return direction_t{n.x, n.y, n.z};
 }
@@ -79,6 +80,38 @@ hit(rotate_object<Object> const &obj, ray_t r, interval_t const &interval) {
        obj.angle_of_rotation}};
 }
 
+template <DeferredHittable Object>
+constexpr std::optional<double> intersect(rotate_object<Object> const &obj,
+                                          ray_t const &r,
+                                          interval_t const &interval) {
+  return intersect(obj.internal_obj,
+                   rotate(r, obj.axis_of_rotation, -obj.angle_of_rotation),
+                   interval);
+}
+
+template <DeferredHittable Object>
+constexpr rotate_hit_object<Object>
+hit_object_at(rotate_object<Object> const &obj, ray_t const &r,
+              interval_t const &interval, double t) {
+  return {hit_object_at(obj.internal_obj,
+                        rotate(r, obj.axis_of_rotation, -obj.angle_of_rotation),
+                        interval, t),
+          obj.axis_of_rotation, obj.angle_of_rotation};
+}
+
+template <ConditionallyDeferredHittable Object>
+constexpr bool is_deferred(rotate_object<Object> const &obj) {
+  return is_deferred(obj.internal_obj);
+}
+
+template <SceneObject Object>
+constexpr bool occluded(rotate_object<Object> const &obj, ray_t const &r,
+                        interval_t const &interval) {
+  return is_occluded(obj.internal_obj,
+                     rotate(r, obj.axis_of_rotation, -obj.angle_of_rotation),
+                     interval);
+}
+
 template <BoundedObject Object>
 constexpr bound_t get_bounds(rotate_object<Object> const &obj) {
   return rotate(get_bounds(obj.internal_obj), obj.axis_of_rotation,
@@ -3,6 +3,7 @@
 #include "hit_info.hpp"
 #include "scene_objects/concepts.hpp"
 #include "traits.hpp"
+#include <algorithm>
 #include <ranges>
 
 namespace mrl {
@@ -12,21 +13,30 @@ struct hit_object<SceneObjectRange> {
   using type = hit_object_t<std::ranges::range_value_t<SceneObjectRange>>;
 };
 
+// Postcondition:
+//   - interval is narrowed to the closest hit found so far, so objects
+//     entirely behind it are not considered
 template <std::ranges::input_range SceneObjectRange>
   requires SceneObject<std::ranges::range_value_t<SceneObjectRange>>
 constexpr std::optional<hit_info_t<hit_object_t<SceneObjectRange>>>
-hit(SceneObjectRange const &obj, ray_t const &ray, interval_t const &i) {
-  namespace rv = std::views;
-  auto hit_results =
-      obj                                                                   //
-      | rv::transform([&ray, &i](auto const &e) { return hit(e, ray, i); }) //
-      | rv::filter([](auto const &res) { return res.has_value(); });
-  auto dist = [](auto const &hit_info) { return hit_info->hit_distance; };
-  auto min_iter = std::ranges::min_element(hit_results, std::less<>(), dist);
-  if (min_iter == std::ranges::end(hit_results))
-    return std::nullopt;
-  else
-    return *min_iter;
+hit(SceneObjectRange const &obj, ray_t const &ray, interval_t i) {
+  std::optional<hit_info_t<hit_object_t<SceneObjectRange>>> res;
+  for (auto const &e : obj) {
+    auto hit_rec = hit(e, ray, i);
+    if (hit_rec && (!res || hit_rec->hit_distance < res->hit_distance)) {
+      i.max = hit_rec->hit_distance;
+      res = std::move(hit_rec);
+    }
+  }
+  return res;
+}
+
+template <std::ranges::input_range SceneObjectRange>
+  requires SceneObject<std::ranges::range_value_t<SceneObjectRange>>
+constexpr bool occluded(SceneObjectRange const &obj, ray_t const &ray,
+                        interval_t const &i) {
+  return std::ranges::any_of(
+      obj, [&ray, &i](auto const &e) { return is_occluded(e, ray, i); });
 }
 
 template <std::ranges::input_range BoundedObjectRange>
@@ -3,7 +3,10 @@
 #include "interval.hpp"
 #include "point.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
 #include "scale_2d.hpp"
+#include <array>
+#include <cstddef>
 #include <optional>
 
 namespace mrl {
@@ -18,4 +21,21 @@ concept Shape = requires(shape_t const &shape, ray_t const &r, point3 const &p,
   { scaling_2d_at(shape, p) } -> std::same_as<scale_2d_t>;
   { ray_hit_distance(shape, r, i) } -> std::same_as<std::optional<double>>;
 };
+
+// Shape intersecting packets of N rays at once.
+//
+// Postcondition:
+//   - ray_hit_distances(shape, packet, t_min, distance, active) returns lanes
+//     in active hitting shape and sets distance[i] of them as
+//     ray_hit_distance does for lane i with interval from t_min to
+//     distance[i]
+template <typename shape_t, std::size_t N>
+concept PacketShape =
+    Shape<shape_t> &&
+    requires(shape_t const &shape, ray_packet_t<N> const &packet, double t_min,
+             std::array<double, N> &distance, packet_mask_t active) {
+      {
+        ray_hit_distances(shape, packet, t_min, distance, active)
+      } -> std::same_as<packet_mask_t>;
+    };
 }
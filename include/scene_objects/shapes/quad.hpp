@@ -5,8 +5,13 @@
 #include "interval.hpp"
 #include "point.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
 #include "scale_2d.hpp"
 #include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
 
 namespace mrl {
 struct quad {
@@ -61,9 +66,118 @@ constexpr std::optional<double> ray_hit_distance(quad const &q, ray_t const &r,
   return t;
 }
 
+// Same test as ray_hit_distance, but normal is not normalized.
+//
+// Postcondition:
+//   - Returns true iff ray_hit_distance(q, r, interval) has a value
+constexpr bool ray_intersects(quad const &q, ray_t const &r,
+                              interval_t const &interval) {
+  auto const n = calc_normal(q);
+  auto const denom = dot(n, r.direction.val());
+  if (denom * denom < 1e-16 * dot(n, n)) {
+    return false;
+  }
+  auto const t = dot(n, q.corner - r.origin) / denom;
+  if (!interval.contains(t)) {
+    return false;
+  }
+  auto const scaling = scaling_2d_at(q, r.at(t));
+  auto const alpha = scaling.x_scale();
+  auto const beta = scaling.y_scale();
+  return 0 <= alpha && alpha <= 1 && 0 <= beta && beta <= 1;
+}
+
+// ray_hit_distance for every lane i in active with interval
+// [t_min, distance[i]]. Plane and barycentric axes of q are computed once for
+// all lanes, and all lanes are computed without branches and masked at the
+// end.
+//
+// Postcondition:
+//   - returns lanes in active whose rays hit q
+//   - distance[i] is hit distance for returned lanes, unchanged otherwise
+template <std::size_t N>
+constexpr packet_mask_t ray_hit_distances(quad const &q,
+                                          ray_packet_t<N> const &packet,
+                                          double t_min,
+                                          std::array<double, N> &distance,
+                                          packet_mask_t active) {
+  auto const n = calc_normal(q);
+  auto const normal = direction_t{n}.val();
+  auto const plane_distance = dot(normal, q.corner);
+  auto const w = n / dot(n, n);
+  auto const &[ox, oy, oz] = packet.origin;
+  auto const &[dx, dy, dz] = packet.direction;
+  std::array<double, N> t;
+  packet_mask_t res = 0;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    auto const denom =
+        normal.x * dx[lane] + normal.y * dy[lane] + normal.z * dz[lane];
+    t[lane] = (plane_distance - (normal.x * ox[lane] + normal.y * oy[lane] +
+                                 normal.z * oz[lane])) /
+              denom;
+    auto const planar = vec3{ox[lane] + t[lane] * dx[lane],
+                             oy[lane] + t[lane] * dy[lane],
+                             oz[lane] + t[lane] * dz[lane]} -
+                        q.corner;
+    auto const alpha = dot(w, cross(planar, q.corner_side_v));
+    auto const beta = dot(w, cross(q.corner_side_u, planar));
+    res |= packet_mask_t{std::fabs(denom) >= 1e-8 && t_min <= t[lane] &&
+                         t[lane] <= distance[lane] && 0 <= alpha &&
+                         alpha <= 1 && 0 <= beta && beta <= 1}
+           << lane;
+  }
+  res &= active;
+  for_each_lane(res, [&](std::size_t lane) { distance[lane] = t[lane]; });
+  return res;
+}
+
+// Postcondition:
+//   - returns bounds of parts of q inside bounds on either side of plane where
+//     axis'th coordinate is position, either of them may be empty
+constexpr std::array<bound_t, 2> split_bounds(quad const &q,
+                                              bound_t const &bounds, int axis,
+                                              double position) {
+  auto const u = q.corner_side_u;
+  auto const v = q.corner_side_v;
+  std::array<point3, 4> const corners{q.corner, q.corner + u,
+                                      q.corner + u + v, q.corner + v};
+  auto point_bounds = [](point3 const &p) {
+    return bound_from_diagonal_points(p, p);
+  };
+  std::array<bound_t, 2> res;
+  for (std::size_t i = 0; i < corners.size(); ++i) {
+    auto const &a = corners[i];
+    auto const &b = corners[(i + 1) % corners.size()];
+    auto const da = component(a, axis) - position;
+    auto const db = component(b, axis) - position;
+    if (da <= 0)
+      res[0] = union_bounds(res[0], point_bounds(a));
+    if (da >= 0)
+      res[1] = union_bounds(res[1], point_bounds(a));
+    if ((da < 0 && db > 0) || (da > 0 && db < 0)) {
+      auto const p = a + (b - a) * (da / (da - db));
+      res[0] = union_bounds(res[0], point_bounds(p));
+      res[1] = union_bounds(res[1], point_bounds(p));
+    }
+  }
+  for (auto &part : res) {
+    part = intersect_bounds(pad_bounds(part), bounds);
+  }
+  auto &left = axis_range(res[0], axis);
+  auto &right = axis_range(res[1], axis);
+  left.max = std::min(left.max, position);
+  right.min = std::max(right.min, position);
+  return res;
+}
+
+// Sides of quad may point in any direction, so all corners are considered.
 constexpr bound_t get_bounds(quad const &quad) {
-  return pad_bounds(bound_from_diagonal_points(
-      quad.corner, quad.corner + quad.corner_side_u + quad.corner_side_v));
+  auto const u = quad.corner_side_u;
+  auto const v = quad.corner_side_v;
+  return pad_bounds(
+      union_bounds(bound_from_diagonal_points(quad.corner, quad.corner + u + v),
+                   bound_from_diagonal_points(quad.corner + u,
+                                              quad.corner + v)));
 }
 
 } // namespace mrl
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "direction.hpp"
+#include "interval.hpp"
+#include "point.hpp"
+#include "ray.hpp"
+#include "scene_objects/shapes/quad.hpp"
+#include "scene_objects/shapes/sphere.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <utility>
+
+namespace mrl {
+// Shapes are packed in blocks of 4 or 8, matching lanes of 256 and 512 bit
+// SIMD registers of doubles.
+template <std::size_t N>
+concept BlockWidth = N == 4 || N == 8;
+
+// Closest hit of a ray among shapes of a block.
+struct block_hit_t {
+  double hit_distance;
+  std::size_t lane;
+};
+
+namespace __shape_block_details {
+constexpr static double no_hit = std::numeric_limits<double>::infinity();
+
+// Precondition:
+//   - t[i] is hit distance of lane i or no_hit
+//
+// Postcondition:
+//   - returns closest hit, the first lane of those at same distance
+template <std::size_t N>
+constexpr std::optional<block_hit_t>
+closest_lane(std::array<double, N> const &t) {
+  auto closest = no_hit;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    closest = std::min(closest, t[lane]);
+  }
+  if (closest == no_hit)
+    return std::nullopt;
+  std::size_t lane = 0;
+  while (t[lane] != closest)
+    ++lane;
+  return block_hit_t{closest, lane};
+}
+} // namespace __shape_block_details
+
+// N spheres in structure of arrays layout, tested against a ray at once.
+//
+// Class Invariant:
+//   - lane i holds center and square of radius of i'th sphere packed
+template <std::size_t N> struct sphere_block_t {
+  std::array<std::array<double, N>, 3> center;
+  std::array<double, N> radius_square;
+};
+
+template <std::size_t N>
+constexpr void set_lane(sphere_block_t<N> &block, std::size_t lane,
+                        sphere const &s) {
+  block.center[0][lane] = s.center.x;
+  block.center[1][lane] = s.center.y;
+  block.center[2][lane] = s.center.z;
+  block.radius_square[lane] = s.radius * s.radius;
+}
+
+// ray_hit_distance for every sphere of block. All lanes are computed without
+// branches, square roots in a loop of their own as in ray_hit_distances, so
+// every loop compiles to SIMD instructions.
+//
+// Postcondition:
+//   - returns closest hit among spheres of block within t_range, if any
+template <std::size_t N>
+constexpr std::optional<block_hit_t>
+block_hit_distance(sphere_block_t<N> const &block, ray_t const &r,
+                   interval_t const &t_range) {
+  auto const &o = r.origin;
+  auto const d = r.direction.val();
+  auto const &[cx, cy, cz] = block.center;
+  auto const a = d.length_square();
+  std::array<double, N> half_b;
+  std::array<double, N> discriminant;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    auto const ocx = o.x - cx[lane];
+    auto const ocy = o.y - cy[lane];
+    auto const ocz = o.z - cz[lane];
+    half_b[lane] = ocx * d.x + ocy * d.y + ocz * d.z;
+    auto const c =
+        ocx * ocx + ocy * ocy + ocz * ocz - block.radius_square[lane];
+    discriminant[lane] = half_b[lane] * half_b[lane] - a * c;
+  }
+  std::array<double, N> discriminant_sqrt;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    discriminant_sqrt[lane] = std::sqrt(std::max(discriminant[lane], 0.0));
+  }
+  std::array<double, N> t;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    auto const t1 = (-half_b[lane] - discriminant_sqrt[lane]) / a;
+    auto const t2 = (-half_b[lane] + discriminant_sqrt[lane]) / a;
+    auto const t1_inside = t_range.surrounds(t1);
+    auto const t2_inside = t_range.surrounds(t2);
+    auto const is_hit = discriminant[lane] >= 0 && (t1_inside || t2_inside);
+    t[lane] = is_hit ? (t1_inside ? t1 : t2) : __shape_block_details::no_hit;
+  }
+  return __shape_block_details::closest_lane(t);
+}
+
+// N quads in structure of arrays layout, tested against a ray at once.
+// Unit normal, plane distance and barycentric axes of every quad are
+// computed once while packing instead of for every ray.
+//
+// Class Invariant:
+//   - lane i holds plane of i'th quad q packed, as normal . p ==
+//     plane_distance, and alpha_axis . (p - corner) and
+//     beta_axis . (p - corner) are scaling_2d_at(q, p) for p on that plane
+template <std::size_t N> struct quad_block_t {
+  std::array<std::array<double, N>, 3> corner;
+  std::array<std::array<double, N>, 3> normal;
+  std::array<double, N> plane_distance;
+  std::array<std::array<double, N>, 3> alpha_axis;
+  std::array<std::array<double, N>, 3> beta_axis;
+};
+
+template <std::size_t N>
+constexpr void set_lane(quad_block_t<N> &block, std::size_t lane,
+                        quad const &q) {
+  auto const n = calc_normal(q);
+  auto const normal = direction_t{n}.val();
+  auto const w = n / dot(n, n);
+  auto const alpha_axis = cross(q.corner_side_v, w);
+  auto const beta_axis = cross(w, q.corner_side_u);
+  for (int axis = 0; axis < 3; ++axis) {
+    auto const i = static_cast<std::size_t>(axis);
+    block.corner[i][lane] = component(q.corner, axis);
+    block.normal[i][lane] = component(normal, axis);
+    block.alpha_axis[i][lane] = component(alpha_axis, axis);
+    block.beta_axis[i][lane] = component(beta_axis, axis);
+  }
+  block.plane_distance[lane] = dot(normal, q.corner);
+}
+
+// ray_hit_distance for every quad of block, all lanes computed without
+// branches.
+//
+// Postcondition:
+//   - returns closest hit among quads of block within interval, if any
+template <std::size_t N>
+constexpr std::optional<block_hit_t>
+block_hit_distance(quad_block_t<N> const &block, ray_t const &r,
+                   interval_t const &interval) {
+  auto const &o = r.origin;
+  auto const d = r.direction.val();
+  auto const &[nx, ny, nz] = block.normal;
+  auto const &[qx, qy, qz] = block.corner;
+  auto const &[ax, ay, az] = block.alpha_axis;
+  auto const &[bx, by, bz] = block.beta_axis;
+  std::array<double, N> t;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    auto const denom = nx[lane] * d.x + ny[lane] * d.y + nz[lane] * d.z;
+    auto const dist =
+        (block.plane_distance[lane] -
+         (nx[lane] * o.x + ny[lane] * o.y + nz[lane] * o.z)) /
+        denom;
+    auto const px = o.x + dist * d.x - qx[lane];
+    auto const py = o.y + dist * d.y - qy[lane];
+    auto const pz = o.z + dist * d.z - qz[lane];
+    auto const alpha = ax[lane] * px + ay[lane] * py + az[lane] * pz;
+    auto const beta = bx[lane] * px + by[lane] * py + bz[lane] * pz;
+    auto const is_hit = std::fabs(denom) >= 1e-8 && interval.contains(dist) &&
+                        0 <= alpha && alpha <= 1 && 0 <= beta && beta <= 1;
+    t[lane] = is_hit ? dist : __shape_block_details::no_hit;
+  }
+  return __shape_block_details::closest_lane(t);
+}
+
+// Block type shapes of type shape_t are packed in.
+template <typename shape_t, std::size_t N> struct shape_block;
+
+template <std::size_t N> struct shape_block<sphere, N> {
+  using type = sphere_block_t<N>;
+};
+
+template <std::size_t N> struct shape_block<quad, N> {
+  using type = quad_block_t<N>;
+};
+
+template <typename shape_t, std::size_t N>
+using shape_block_t = typename shape_block<shape_t, N>::type;
+
+// Shape packed N at a time in a block of type shape_block_t<shape_t, N>.
+//
+// Postcondition:
+//   - set_lane(block, i, shape) packs shape in lane i of block
+//   - block_hit_distance(block, r, interval) returns closest hit among
+//     shapes of block, at distance ray_hit_distance(shape, r, interval)
+//     returns for it
+template <typename shape_t, std::size_t N>
+concept BlockShape =
+    BlockWidth<N> &&
+    requires(shape_block_t<shape_t, N> &block, shape_t const &shape,
+             std::size_t lane, ray_t const &r, interval_t const &interval) {
+      set_lane(block, lane, shape);
+      {
+        block_hit_distance(std::as_const(block), r, interval)
+      } -> std::same_as<std::optional<block_hit_t>>;
+    };
+} // namespace mrl
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "bound.hpp"
 #include "generator/concepts.hpp"
 #include "generator/generator_view.hpp"
 #include "hit_info.hpp"
@@ -10,7 +11,11 @@
 #include "materials/scatter_info.hpp"
 #include "point.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
+#include "scene_objects/concepts.hpp"
 #include "scene_objects/shapes/concepts.hpp"
+#include <array>
+#include <cstddef>
 
 namespace mrl {
 template <Shape shape_t, typename material_t> struct shape_object;
@@ -83,8 +88,56 @@ hit(shape_object<shape_t, material_t> const &obj, ray_t const &ray,
       *hit_dist_opt, shape_hit_object<shape_t, material_t>{&obj}};
 }
 
+template <Shape shape_t, typename material_t>
+constexpr std::optional<double>
+intersect(shape_object<shape_t, material_t> const &obj, ray_t const &ray,
+          interval_t const &interval) {
+  return ray_hit_distance(obj.shape, ray, interval);
+}
+
+template <Shape shape_t, typename material_t>
+constexpr shape_hit_object<shape_t, material_t>
+hit_object_at(shape_object<shape_t, material_t> const &obj, ray_t const &,
+              interval_t const &, double) {
+  return shape_hit_object<shape_t, material_t>{&obj};
+}
+
+template <Shape shape_t, typename material_t, std::size_t N>
+  requires PacketShape<shape_t, N>
+constexpr packet_mask_t
+hit_packet(shape_object<shape_t, material_t> const &obj,
+           ray_packet_t<N> const &packet, double t_min,
+           packet_hits_t<shape_hit_object<shape_t, material_t>, N> &hits,
+           packet_mask_t active) {
+  auto const res =
+      ray_hit_distances(obj.shape, packet, t_min, hits.closest, active);
+  for_each_lane(res, [&](std::size_t lane) {
+    hits.hits[lane] = hit_info_t<shape_hit_object<shape_t, material_t>>{
+        hits.closest[lane], shape_hit_object<shape_t, material_t>{&obj}};
+  });
+  return res;
+}
+
+// Uses ray_intersects of shape if it has one.
+template <Shape shape_t, typename material_t>
+constexpr bool occluded(shape_object<shape_t, material_t> const &obj,
+                        ray_t const &ray, interval_t const &interval) {
+  if constexpr (requires { ray_intersects(obj.shape, ray, interval); }) {
+    return ray_intersects(obj.shape, ray, interval);
+  } else {
+    return ray_hit_distance(obj.shape, ray, interval).has_value();
+  }
+}
+
 template <Shape shape, typename material_t>
 constexpr bound_t get_bounds(shape_object<shape, material_t> const &obj) {
   return get_bounds(obj.shape);
 }
+
+template <Shape shape, typename material_t>
+constexpr std::array<bound_t, 2>
+split_bounds(shape_object<shape, material_t> const &obj, bound_t const &bounds,
+             int axis, double position) {
+  return split_object_bounds(obj.shape, bounds, axis, position);
+}
 } // namespace mrl
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "bound.hpp"
+#include "hit_info.hpp"
+#include "interval.hpp"
+#include "ray.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/shapes/concepts.hpp"
+#include "scene_objects/shapes/shape_block.hpp"
+#include "scene_objects/shapes/shape_object.hpp"
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace mrl {
+// Up to N shape objects of same type whose shapes are packed in a block, so
+// that a ray is tested against all of them by one block_hit_distance. A bvh
+// over blocks has leaves of up to N objects, and a range of blocks, e.g. a
+// small scene hit by brute force, tests N objects at a time. Objects are
+// stored inside the block next to their shapes, so a vector of blocks holds
+// all of them in one allocation.
+//
+// Class Invariant:
+//   - 0 < size_ <= N
+//   - objects_[i] and lane i of shapes_ are objects()[i] and its shape, those
+//     past size_ repeat objects()[0]
+template <Shape shape_t, typename material_t, std::size_t N>
+  requires BlockShape<shape_t, N>
+class shape_object_block {
+public:
+  using object_type = shape_object<shape_t, material_t>;
+  using hit_object_type = hit_object_t<object_type>;
+
+private:
+  shape_block_t<shape_t, N> shapes_{};
+  std::array<object_type, N> objects_;
+  std::size_t size_;
+  bound_t bounds_;
+
+  static std::array<object_type, N>
+  padded_objects(std::span<object_type const> objects) {
+    return [&]<std::size_t... lane>(std::index_sequence<lane...>) {
+      return std::array<object_type, N>{
+          objects[lane < objects.size() ? lane : 0]...};
+    }(std::make_index_sequence<N>{});
+  }
+
+public:
+  // Precondition:
+  //   - 0 < objects.size() <= N
+  explicit shape_object_block(std::span<object_type const> objects)
+      : objects_(padded_objects(objects)), size_(objects.size()),
+        bounds_(get_bounds(objects_.front())) {
+    for (std::size_t lane = 0; lane < N; ++lane) {
+      set_lane(shapes_, lane, objects_[lane].shape);
+      bounds_ = union_bounds(bounds_, get_bounds(objects_[lane]));
+    }
+  }
+
+  std::span<object_type const> objects() const {
+    return std::span(objects_).first(size_);
+  }
+
+  bound_t bounds() const { return bounds_; }
+
+  std::optional<hit_info_t<hit_object_type>>
+  hit_ray(ray_t const &r, interval_t const &interval) const {
+    auto const closest = block_hit_distance(shapes_, r, interval);
+    if (!closest)
+      return std::nullopt;
+    return hit_info_t<hit_object_type>{
+        closest->hit_distance, hit_object_type{&objects_[closest->lane]}};
+  }
+
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    return block_hit_distance(shapes_, r, interval).has_value();
+  }
+};
+
+template <Shape shape_t, typename material_t, std::size_t N>
+inline bound_t
+get_bounds(shape_object_block<shape_t, material_t, N> const &block) {
+  return block.bounds();
+}
+
+template <Shape shape_t, typename material_t, std::size_t N>
+inline auto hit(shape_object_block<shape_t, material_t, N> const &block,
+                ray_t const &r, interval_t const &interval) {
+  return block.hit_ray(r, interval);
+}
+
+template <Shape shape_t, typename material_t, std::size_t N>
+inline bool occluded(shape_object_block<shape_t, material_t, N> const &block,
+                     ray_t const &r, interval_t const &interval) {
+  return block.occluded_ray(r, interval);
+}
+
+// Packs objects in blocks of up to N objects close to each other: objects of
+// every leaf of a bvh built over them with split and leaves of up to N
+// objects make a block.
+//
+// Precondition:
+//   - std::ranges::size(rng) < 2^32
+template <std::size_t N, std::ranges::random_access_range Range,
+          typename Split = median_split>
+  requires BvhSplitStrategy<Split, bvh_primitive_iterator>
+auto make_shape_object_blocks(Range &&rng, Split split = {}) {
+  using object_type = std::ranges::range_value_t<Range>;
+  using block_type =
+      shape_object_block<typename object_type::shape_type,
+                         typename object_type::material_type, N>;
+  auto objects = to_object_vector<object_type>(std::forward<Range>(rng));
+  std::vector<block_type> res;
+  if (objects.empty())
+    return res;
+  auto refs = make_primitive_refs(objects);
+  auto const nodes = build_bvh_nodes(refs.begin(), refs.end(), split, N);
+  reorder_objects(objects, refs);
+  for (auto const &node : nodes) {
+    if (!is_leaf(node))
+      continue;
+    res.emplace_back(std::span<object_type const>(objects).subspan(
+        node.offset, node.count));
+  }
+  return res;
+}
+} // namespace mrl
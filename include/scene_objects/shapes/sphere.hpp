@@ -5,9 +5,13 @@
 #include "interval.hpp"
 #include "point.hpp"
 #include "ray.hpp"
+#include "ray_packet.hpp"
 #include "scale_2d.hpp"
 #include "vector.hpp"
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstddef>
 #include <optional>
 
 namespace mrl {
@@ -56,6 +60,71 @@ ray_hit_distance(sphere const &obj, ray_t const &r, interval_t const &t_range) {
   return std::nullopt;
 }
 
+// Postcondition:
+//   - Returns true iff ray_hit_distance(obj, r, t_range) has a value
+constexpr bool ray_intersects(sphere const &obj, ray_t const &r,
+                              interval_t const &t_range) {
+  auto oc = r.origin - obj.center;
+  auto a = r.direction.val().length_square();
+  auto half_b = dot(oc, r.direction.val());
+  auto c = oc.length_square() - obj.radius * obj.radius;
+  auto discriminant = half_b * half_b - a * c;
+  if (discriminant < 0)
+    return false;
+  auto discriminant_sqrt = std::sqrt(discriminant);
+  return t_range.surrounds((-half_b - discriminant_sqrt) / a) ||
+         t_range.surrounds((-half_b + discriminant_sqrt) / a);
+}
+
+// ray_hit_distance for every lane i in active with interval
+// (t_min, distance[i]). All lanes are computed without branches and masked at
+// the end. Square roots are taken in a loop of their own, as std::sqrt may
+// set errno and keeps a loop from being vectorized.
+//
+// Postcondition:
+//   - returns lanes in active whose rays hit obj
+//   - distance[i] is hit distance for returned lanes, unchanged otherwise
+template <std::size_t N>
+constexpr packet_mask_t ray_hit_distances(sphere const &obj,
+                                          ray_packet_t<N> const &packet,
+                                          double t_min,
+                                          std::array<double, N> &distance,
+                                          packet_mask_t active) {
+  auto const &[ox, oy, oz] = packet.origin;
+  auto const &[dx, dy, dz] = packet.direction;
+  auto const radius_square = obj.radius * obj.radius;
+  std::array<double, N> a;
+  std::array<double, N> half_b;
+  std::array<double, N> discriminant;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    auto const ocx = ox[lane] - obj.center.x;
+    auto const ocy = oy[lane] - obj.center.y;
+    auto const ocz = oz[lane] - obj.center.z;
+    a[lane] = dx[lane] * dx[lane] + dy[lane] * dy[lane] + dz[lane] * dz[lane];
+    half_b[lane] = ocx * dx[lane] + ocy * dy[lane] + ocz * dz[lane];
+    auto const c = ocx * ocx + ocy * ocy + ocz * ocz - radius_square;
+    discriminant[lane] = half_b[lane] * half_b[lane] - a[lane] * c;
+  }
+  std::array<double, N> discriminant_sqrt;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    discriminant_sqrt[lane] = std::sqrt(std::max(discriminant[lane], 0.0));
+  }
+  std::array<double, N> t;
+  packet_mask_t res = 0;
+  for (std::size_t lane = 0; lane < N; ++lane) {
+    auto const t1 = (-half_b[lane] - discriminant_sqrt[lane]) / a[lane];
+    auto const t2 = (-half_b[lane] + discriminant_sqrt[lane]) / a[lane];
+    auto const t1_inside = t_min < t1 && t1 < distance[lane];
+    auto const t2_inside = t_min < t2 && t2 < distance[lane];
+    t[lane] = t1_inside ? t1 : t2;
+    res |= packet_mask_t{discriminant[lane] >= 0 && (t1_inside || t2_inside)}
+           << lane;
+  }
+  res &= active;
+  for_each_lane(res, [&](std::size_t lane) { distance[lane] = t[lane]; });
+  return res;
+}
+
 constexpr bound_t get_bounds(sphere const &sphere) {
   return {
       .x_range = interval_t{sphere.center.x - sphere.radius,
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "bound.hpp"
+#include "hit_info.hpp"
+#include "interval.hpp"
+#include "ray.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/instance.hpp"
+#include "scene_objects/rotate_object.hpp"
+#include "scene_objects/traits.hpp"
+#include "scene_objects/translate_object.hpp"
+#include "transform.hpp"
+#include <optional>
+#include <utility>
+
+namespace mrl {
+// Object placed in world with an affine transform, whose matrix and inverse
+// are computed once at construction. So unlike rotate_object, which takes
+// sine and cosine of its angle for every ray and every query of its hit
+// object, a ray costs one matrix multiply. Normals are mapped by inverse
+// transpose, applied as transpose of the cached inverse. Unlike instance_t
+// object is held by value.
+template <typename Object> struct transform_object {
+  using object_type = Object;
+  using hit_object_type = instance_hit_object<Object>;
+
+  object_type internal_object;
+  transform_t transform;
+
+  constexpr transform_object(object_type internal_object_,
+                             transform_t const &transform_)
+      : internal_object(std::move(internal_object_)), transform(transform_) {}
+};
+
+template <typename Object>
+transform_object(Object, transform_t const &) -> transform_object<Object>;
+
+namespace __transform_object_details {
+// Ray transformed to object space with interval scaled along with it.
+struct local_ray_t {
+  ray_t ray;
+  interval_t interval;
+  double distance_scale;
+};
+
+constexpr local_ray_t to_local(transform_t const &transform, ray_t const &r,
+                               interval_t const &interval) {
+  auto const local = transform_ray(transform.inverse, r);
+  auto const scale = local.distance_scale;
+  return {local.ray, interval_t{interval.min * scale, interval.max * scale},
+          scale};
+}
+} // namespace __transform_object_details
+
+template <SceneObject Object>
+constexpr std::optional<hit_info_t<instance_hit_object<Object>>>
+hit(transform_object<Object> const &obj, ray_t const &r,
+    interval_t const &interval) {
+  auto const local =
+      __transform_object_details::to_local(obj.transform, r, interval);
+  auto internal_hit = hit(obj.internal_object, local.ray, local.interval);
+  if (!internal_hit)
+    return std::nullopt;
+  return hit_info_t<instance_hit_object<Object>>{
+      internal_hit->hit_distance / local.distance_scale,
+      {std::move(internal_hit->hit_object), &obj.transform}};
+}
+
+template <DeferredHittable Object>
+constexpr std::optional<double> intersect(transform_object<Object> const &obj,
+                                          ray_t const &r,
+                                          interval_t const &interval) {
+  auto const local =
+      __transform_object_details::to_local(obj.transform, r, interval);
+  auto const t = intersect(obj.internal_object, local.ray, local.interval);
+  if (!t)
+    return std::nullopt;
+  return *t / local.distance_scale;
+}
+
+template <DeferredHittable Object>
+constexpr instance_hit_object<Object>
+hit_object_at(transform_object<Object> const &obj, ray_t const &r,
+              interval_t const &interval, double t) {
+  auto const local =
+      __transform_object_details::to_local(obj.transform, r, interval);
+  return {hit_object_at(obj.internal_object, local.ray, local.interval,
+                        t * local.distance_scale),
+          &obj.transform};
+}
+
+template <ConditionallyDeferredHittable Object>
+constexpr bool is_deferred(transform_object<Object> const &obj) {
+  return is_deferred(obj.internal_object);
+}
+
+template <SceneObject Object>
+constexpr bool occluded(transform_object<Object> const &obj, ray_t const &r,
+                        interval_t const &interval) {
+  auto const local =
+      __transform_object_details::to_local(obj.transform, r, interval);
+  return is_occluded(obj.internal_object, local.ray, local.interval);
+}
+
+template <BoundedObject Object>
+constexpr bound_t get_bounds(transform_object<Object> const &obj) {
+  return transform_bounds(obj.transform.matrix,
+                          get_bounds(obj.internal_object));
+}
+
+// Collapses a chain of translate_object, rotate_object and transform_object
+// wrappers into one transform_object of innermost object, composing their
+// transforms once, so that a ray costs one matrix multiply however long the
+// chain is. Rotations are around axis of rotation through its origin.
+//
+// Postcondition:
+//   - returns transform_object of innermost object that is not one of these
+//     wrappers, with transform of the whole chain
+template <typename Object>
+constexpr auto make_transform_object(Object obj) {
+  return transform_object<Object>{std::move(obj), identity_transform()};
+}
+
+template <typename Object>
+constexpr auto make_transform_object(transform_object<Object> obj);
+
+template <typename Object>
+constexpr auto make_transform_object(translate_object<Object> obj);
+
+template <typename Object>
+constexpr auto make_transform_object(rotate_object<Object> obj);
+
+template <typename Object>
+constexpr auto make_transform_object(transform_object<Object> obj) {
+  auto res = make_transform_object(std::move(obj.internal_object));
+  res.transform = obj.transform * res.transform;
+  return res;
+}
+
+template <typename Object>
+constexpr auto make_transform_object(translate_object<Object> obj) {
+  auto res = make_transform_object(std::move(obj.internal_object));
+  res.transform = translation(obj.offset) * res.transform;
+  return res;
+}
+
+template <typename Object>
+constexpr auto make_transform_object(rotate_object<Object> obj) {
+  auto res = make_transform_object(std::move(obj.internal_obj));
+  res.transform =
+      rotation(obj.axis_of_rotation, obj.angle_of_rotation) * res.transform;
+  return res;
+}
+} // namespace mrl
@@ -10,6 +10,7 @@
 #include "scene_objects/concepts.hpp"
 #include "scene_objects/traits.hpp"
 #include "vector.hpp"
+#include <array>
 
 namespace mrl {
 template <typename Object> struct translate_hit_object {
@@ -68,8 +69,46 @@ hit(translate_object<Object> const &obj, ray_t r, interval_t const &interval) {
       {std::move(internal_hit->hit_object), obj.offset}};
 }
 
+template <DeferredHittable Object>
+constexpr std::optional<double> intersect(translate_object<Object> const &obj,
+                                          ray_t r,
+                                          interval_t const &interval) {
+  r.origin -= obj.offset;
+  return intersect(obj.internal_object, r, interval);
+}
+
+template <DeferredHittable Object>
+constexpr translate_hit_object<Object>
+hit_object_at(translate_object<Object> const &obj, ray_t r,
+              interval_t const &interval, double t) {
+  r.origin -= obj.offset;
+  return {hit_object_at(obj.internal_object, r, interval, t), obj.offset};
+}
+
+template <ConditionallyDeferredHittable Object>
+constexpr bool is_deferred(translate_object<Object> const &obj) {
+  return is_deferred(obj.internal_object);
+}
+
+template <SceneObject Object>
+constexpr bool occluded(translate_object<Object> const &obj, ray_t r,
+                        interval_t const &interval) {
+  r.origin -= obj.offset;
+  return is_occluded(obj.internal_object, r, interval);
+}
+
 template <BoundedObject Object>
 constexpr bound_t get_bounds(translate_object<Object> const &obj) {
   return shift(get_bounds(obj.internal_object), obj.offset);
 }
+
+template <BoundedObject Object>
+constexpr std::array<bound_t, 2>
+split_bounds(translate_object<Object> const &obj, bound_t const &bounds,
+             int axis, double position) {
+  auto res = split_object_bounds(obj.internal_object,
+                                 shift(bounds, -obj.offset), axis,
+                                 position - component(obj.offset, axis));
+  return {shift(res[0], obj.offset), shift(res[1], obj.offset)};
+}
 } // namespace mrl
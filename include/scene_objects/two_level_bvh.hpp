@@ -0,0 +1,103 @@
+#pragma once
+
+#include "bound.hpp"
+#include "interval.hpp"
+#include "ray.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/instance.hpp"
+#include "scene_objects/object_ref.hpp"
+#include "transform.hpp"
+#include <cstddef>
+#include <vector>
+
+namespace mrl {
+// Two level acceleration structure: a top level bvh over instances of shared
+// bottom level objects (usually bvh_t). Memory scales with unique geometry
+// instead of number of placements, and moving instances only requires
+// rebuilding the top level.
+//
+// Class Invariant:
+//   - top level bvh refers to instances in instances_, so two_level_bvh_t is
+//     move only
+template <BoundedObject Object> class two_level_bvh_t {
+public:
+  using instance_type = instance_t<Object>;
+  using hit_object_type = hit_object_t<instance_type>;
+
+private:
+  using instance_ref = object_ref_t<instance_type const>;
+
+  std::vector<instance_type> instances_;
+  bvh_t<instance_ref> top_level_;
+
+  template <typename Split>
+  static bvh_t<instance_ref>
+  build_top_level(std::vector<instance_type> const &instances, Split split) {
+    std::vector<instance_ref> refs(instances.begin(), instances.end());
+    return bvh_t<instance_ref>(std::move(refs), split);
+  }
+
+public:
+  template <typename Split = sah_split>
+    requires BvhSplitStrategy<Split, bvh_primitive_iterator>
+  explicit two_level_bvh_t(std::vector<instance_type> instances,
+                           Split split = {})
+      : instances_(std::move(instances)),
+        top_level_(build_top_level(instances_, split)) {}
+
+  two_level_bvh_t(two_level_bvh_t const &) = delete;
+  two_level_bvh_t &operator=(two_level_bvh_t const &) = delete;
+  two_level_bvh_t(two_level_bvh_t &&) = default;
+  two_level_bvh_t &operator=(two_level_bvh_t &&) = default;
+
+  std::vector<instance_type> const &instances() const { return instances_; }
+
+  // Postcondition:
+  //   - hits do not reflect new transform until top level is refitted or
+  //     rebuilt
+  void set_transform(std::size_t i, transform_t const &transform) {
+    instances_[i].transform = transform;
+  }
+
+  // Bottom level objects are left untouched.
+  template <typename Split = sah_split>
+    requires BvhSplitStrategy<Split, bvh_primitive_iterator>
+  void rebuild_top_level(Split split = {}) {
+    top_level_ = build_top_level(instances_, split);
+  }
+
+  // Keeps topology of top level, cheaper than rebuilding it for small
+  // movements.
+  void refit_top_level() { top_level_.refit(); }
+
+  bound_t bounds() const { return top_level_.bounds(); }
+
+  auto hit_ray(ray_t const &r, interval_t const &interval) const {
+    return top_level_.hit_ray(r, interval);
+  }
+
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    return top_level_.occluded_ray(r, interval);
+  }
+};
+
+template <BoundedObject Object>
+inline bound_t get_bounds(two_level_bvh_t<Object> const &bvh) {
+  return bvh.bounds();
+}
+
+template <BoundedObject Object>
+inline auto hit(two_level_bvh_t<Object> const &bvh, ray_t const &r,
+                interval_t const &interval) {
+  return bvh.hit_ray(r, interval);
+}
+
+template <BoundedObject Object>
+inline bool occluded(two_level_bvh_t<Object> const &bvh, ray_t const &r,
+                     interval_t const &interval) {
+  return bvh.occluded_ray(r, interval);
+}
+} // namespace mrl
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "bound.hpp"
+#include "generator/concepts.hpp"
+#include "generator/generator_view.hpp"
+#include "hit_info.hpp"
+#include "interval.hpp"
+#include "point.hpp"
+#include "ray.hpp"
+#include "ray_packet.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/traits.hpp"
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <variant>
+
+namespace mrl {
+namespace __variant_object_details {
+// Postcondition:
+//   - returns index of first of Ts that is T
+template <typename T, typename... Ts> constexpr std::size_t index_of() {
+  std::size_t res = 0;
+  (void)((std::same_as<T, Ts> ? false : (++res, true)) && ...);
+  return res;
+}
+} // namespace __variant_object_details
+
+// HitObject of a variant_scene_object<Ts...>, holding hit object of the
+// alternative that was hit. Alternatives may have same hit object type, so
+// it is always constructed by index.
+template <SceneObject... Ts> struct variant_hit_object {
+  std::variant<hit_object_t<Ts>...> hit_object;
+};
+
+template <typename... Ts>
+auto normal_at(variant_hit_object<Ts...> const &o, point3 const &p) {
+  return std::visit([&](auto const &h) { return normal_at(h, p); },
+                    o.hit_object);
+}
+template <typename... Ts>
+auto scaling_2d_at(variant_hit_object<Ts...> const &o, point3 const &p) {
+  return std::visit([&](auto const &h) { return scaling_2d_at(h, p); },
+                    o.hit_object);
+}
+template <DoubleGenerator Generator, typename... Ts>
+auto scattering_for(variant_hit_object<Ts...> const &o, ray_t const &r,
+                    double hit_distance, generator_view<Generator> rand) {
+  return std::visit(
+      [&](auto const &h) { return scattering_for(h, r, hit_distance, rand); },
+      o.hit_object);
+}
+template <DoubleGenerator Generator, typename... Ts>
+auto emission_at(variant_hit_object<Ts...> const &o, point3 const &p,
+                 generator_view<Generator> rand) {
+  return std::visit([&](auto const &h) { return emission_at(h, p, rand); },
+                    o.hit_object);
+}
+
+// Scene object that is one of a closed set of scene object types Ts, known
+// at compile time. Unlike any_scene_object it is a value stored inline, so a
+// bvh_t<variant_scene_object<Ts...>> keeps all its objects contiguously in
+// its object array, and it dispatches by a switch over index of its
+// alternative (std::visit over few alternatives compiles to one) instead of
+// a virtual call through a shared pointer, which lets hit of every
+// alternative be inlined. So is its hit object, that needs no type erasure.
+//
+// Precondition:
+//   - Ts are distinct
+template <SceneObject... Ts> struct variant_scene_object {
+  using hit_object_type = variant_hit_object<Ts...>;
+
+  std::variant<Ts...> object;
+
+  template <typename T>
+    requires(std::same_as<T, Ts> || ...)
+  variant_scene_object(T x) : object(std::move(x)) {}
+
+  // Postcondition:
+  //   - converts hit info of alternative T of this to hit info of this
+  template <typename T>
+  static hit_info_t<hit_object_type> from_hit_of(hit_info_of<T> hit_rec) {
+    constexpr auto index = __variant_object_details::index_of<T, Ts...>();
+    return hit_info_t<hit_object_type>{
+        .hit_distance = hit_rec.hit_distance,
+        .hit_object = hit_object_type{std::variant<hit_object_t<Ts>...>(
+            std::in_place_index<index>, std::move(hit_rec.hit_object))},
+    };
+  }
+};
+
+template <typename... Ts>
+std::optional<hit_info_of<variant_scene_object<Ts...>>>
+hit(variant_scene_object<Ts...> const &o, ray_t const &r,
+    interval_t const &i) {
+  return std::visit(
+      [&]<typename T>(T const &obj)
+          -> std::optional<hit_info_of<variant_scene_object<Ts...>>> {
+        auto res = hit(obj, r, i);
+        if (!res)
+          return std::nullopt;
+        return variant_scene_object<Ts...>::template from_hit_of<T>(
+            std::move(*res));
+      },
+      o.object);
+}
+
+template <std::size_t N, typename... Ts>
+  requires PacketWidth<N>
+packet_mask_t
+hit_packet(variant_scene_object<Ts...> const &o, ray_packet_t<N> const &packet,
+           double t_min, packet_hits_t<variant_hit_object<Ts...>, N> &hits,
+           packet_mask_t active) {
+  return std::visit(
+      [&]<typename T>(T const &obj) {
+        packet_hits_t<hit_object_t<T>, N> own;
+        own.closest = hits.closest;
+        auto const res = hit_lanes(obj, packet, t_min, own, active);
+        for_each_lane(res, [&](std::size_t lane) {
+          hits.closest[lane] = own.closest[lane];
+          hits.hits[lane] =
+              variant_scene_object<Ts...>::template from_hit_of<T>(
+                  std::move(*own.hits[lane]));
+        });
+        return res;
+      },
+      o.object);
+}
+
+template <typename... Ts>
+  requires(DeferredHittable<Ts> && ...)
+std::optional<double> intersect(variant_scene_object<Ts...> const &o,
+                                ray_t const &r, interval_t const &i) {
+  return std::visit([&](auto const &obj) { return intersect(obj, r, i); },
+                    o.object);
+}
+
+template <typename... Ts>
+  requires(DeferredHittable<Ts> && ...)
+variant_hit_object<Ts...> hit_object_at(variant_scene_object<Ts...> const &o,
+                                        ray_t const &r, interval_t const &i,
+                                        double t) {
+  return std::visit(
+      [&]<typename T>(T const &obj) {
+        return variant_scene_object<Ts...>::template from_hit_of<T>(
+                   hit_info_of<T>{t, hit_object_at(obj, r, i, t)})
+            .hit_object;
+      },
+      o.object);
+}
+
+template <typename... Ts>
+  requires(DeferredHittable<Ts> && ...) &&
+          (ConditionallyDeferredHittable<Ts> || ...)
+bool is_deferred(variant_scene_object<Ts...> const &o) {
+  return std::visit([](auto const &obj) { return defers_hit_object(obj); },
+                    o.object);
+}
+
+template <typename... Ts>
+bool occluded(variant_scene_object<Ts...> const &o, ray_t const &r,
+              interval_t const &i) {
+  return std::visit([&](auto const &obj) { return is_occluded(obj, r, i); },
+                    o.object);
+}
+
+template <typename... Ts>
+  requires(Bounded<Ts> && ...)
+bound_t get_bounds(variant_scene_object<Ts...> const &o) {
+  return std::visit([](auto const &obj) { return get_bounds(obj); },
+                    o.object);
+}
+
+template <typename... Ts>
+std::array<bound_t, 2> split_bounds(variant_scene_object<Ts...> const &o,
+                                    bound_t const &bounds, int axis,
+                                    double position) {
+  return std::visit(
+      [&](auto const &obj) {
+        return split_object_bounds(obj, bounds, axis, position);
+      },
+      o.object);
+}
+} // namespace mrl
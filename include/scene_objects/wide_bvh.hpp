@@ -0,0 +1,132 @@
+#pragma once
+
+#include "bound.hpp"
+#include "interval.hpp"
+#include "prepared_ray.hpp"
+#include "ray.hpp"
+#include "scene_objects/bvh/build.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/bvh/wide_node.hpp"
+#include "scene_objects/concepts.hpp"
+#include "traits.hpp"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <ranges>
+#include <vector>
+
+namespace mrl {
+// Bvh whose nodes have up to Width children. It is built by collapsing a
+// binary bvh, so it is about log2(Width) times shallower. Bounds of all
+// children of a node are tested against a ray at once.
+template <typename Object, std::size_t Width> class wide_bvh_t {
+public:
+  using object_type = Object;
+  using hit_object_type = hit_object_t<Object>;
+  using node_type = wide_bvh_node_t<Width>;
+
+private:
+  std::vector<object_type> objects_;
+  std::vector<node_type> nodes_;
+  bound_t bounds_;
+
+public:
+  template <std::ranges::random_access_range Range,
+            typename Split = median_split>
+    requires BvhSplitStrategy<Split, bvh_primitive_iterator>
+  wide_bvh_t(Range &&rng, Split split = {})
+      : objects_(to_object_vector<object_type>(std::forward<Range>(rng))) {
+    auto const binary_nodes = build_bvh_nodes(objects_, split);
+    nodes_ = collapse_bvh_nodes<Width>(binary_nodes);
+    if (!binary_nodes.empty())
+      bounds_ = to_bound(binary_nodes.front().bounds);
+  }
+
+  bound_t bounds() const { return bounds_; }
+
+  std::vector<node_type> const &nodes() const { return nodes_; }
+
+  std::vector<object_type> const &objects() const { return objects_; }
+
+  // interval is narrowed to the closest hit found so far, so children
+  // entirely behind it are never descended.
+  auto hit_ray(ray_t const &r, interval_t interval) const {
+    std::optional<hit_info_t<hit_object_type>> res;
+    if (nodes_.empty())
+      return res;
+    auto const ray = prepare(r);
+    std::array<std::uint32_t, bvh_max_depth *(Width - 1) + 1> to_visit;
+    std::size_t num_to_visit = 0;
+    to_visit[num_to_visit++] = 0;
+    while (num_to_visit > 0) {
+      auto const &node = nodes_[to_visit[--num_to_visit]];
+      auto mask = hit_children(node, ray, interval);
+      while (mask != 0) {
+        auto const i = static_cast<std::size_t>(std::countr_zero(mask));
+        mask &= mask - 1;
+        if (node.count[i] == 0) {
+          to_visit[num_to_visit++] = node.child[i];
+          continue;
+        }
+        for (auto j = node.child[i]; j < node.child[i] + node.count[i]; ++j) {
+          auto hit_rec = hit(objects_[j], r, interval);
+          if (hit_rec && (!res || hit_rec->hit_distance < res->hit_distance)) {
+            interval.max = hit_rec->hit_distance;
+            res = std::move(hit_rec);
+          }
+        }
+      }
+    }
+    return res;
+  }
+
+  bool occluded_ray(ray_t const &r, interval_t const &interval) const {
+    if (nodes_.empty())
+      return false;
+    auto const ray = prepare(r);
+    std::array<std::uint32_t, bvh_max_depth *(Width - 1) + 1> to_visit;
+    std::size_t num_to_visit = 0;
+    to_visit[num_to_visit++] = 0;
+    while (num_to_visit > 0) {
+      auto const &node = nodes_[to_visit[--num_to_visit]];
+      auto mask = hit_children(node, ray, interval);
+      while (mask != 0) {
+        auto const i = static_cast<std::size_t>(std::countr_zero(mask));
+        mask &= mask - 1;
+        if (node.count[i] == 0) {
+          to_visit[num_to_visit++] = node.child[i];
+          continue;
+        }
+        for (auto j = node.child[i]; j < node.child[i] + node.count[i]; ++j) {
+          if (is_occluded(objects_[j], r, interval))
+            return true;
+        }
+      }
+    }
+    return false;
+  }
+};
+
+template <typename Object> using bvh4_t = wide_bvh_t<Object, 4>;
+
+template <typename Object> using bvh8_t = wide_bvh_t<Object, 8>;
+
+template <BoundedObject Object, std::size_t Width>
+inline bound_t get_bounds(wide_bvh_t<Object, Width> const &bvh) {
+  return bvh.bounds();
+}
+
+template <SceneObject Object, std::size_t Width>
+inline auto hit(wide_bvh_t<Object, Width> const &bvh, ray_t const &r,
+                interval_t const &interval) {
+  return bvh.hit_ray(r, interval);
+}
+
+template <SceneObject Object, std::size_t Width>
+inline bool occluded(wide_bvh_t<Object, Width> const &bvh, ray_t const &r,
+                     interval_t const &interval) {
+  return bvh.occluded_ray(r, interval);
+}
+} // namespace mrl
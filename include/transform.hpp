@@ -0,0 +1,187 @@
+#pragma once
+
+#include "angle.hpp"
+#include "bound.hpp"
+#include "interval.hpp"
+#include "point.hpp"
+#include "ray.hpp"
+#include "vector.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace mrl {
+// Affine map p -> L * p + t, stored as 3x4 row major matrix [L | t].
+struct matrix3x4_t {
+  std::array<std::array<double, 4>, 3> rows;
+};
+
+constexpr matrix3x4_t identity_matrix() {
+  return {{{
+      {1, 0, 0, 0},
+      {0, 1, 0, 0},
+      {0, 0, 1, 0},
+  }}};
+}
+
+// Postcondition:
+//   - returns matrix applying b first and then a
+constexpr matrix3x4_t operator*(matrix3x4_t const &a, matrix3x4_t const &b) {
+  matrix3x4_t res{};
+  for (std::size_t i = 0; i < 3; ++i) {
+    for (std::size_t j = 0; j < 4; ++j) {
+      auto sum = j == 3 ? a.rows[i][3] : 0.0;
+      for (std::size_t k = 0; k < 3; ++k) {
+        sum += a.rows[i][k] * b.rows[k][j];
+      }
+      res.rows[i][j] = sum;
+    }
+  }
+  return res;
+}
+
+constexpr vec3 transform_vector(matrix3x4_t const &m, vec3 const &v) {
+  auto const &r = m.rows;
+  return {
+      r[0][0] * v.x + r[0][1] * v.y + r[0][2] * v.z,
+      r[1][0] * v.x + r[1][1] * v.y + r[1][2] * v.z,
+      r[2][0] * v.x + r[2][1] * v.y + r[2][2] * v.z,
+  };
+}
+
+constexpr point3 transform_point(matrix3x4_t const &m, point3 const &p) {
+  auto const &r = m.rows;
+  return transform_vector(m, p) + vec3{r[0][3], r[1][3], r[2][3]};
+}
+
+// Postcondition:
+//   - returns L^T * v, where L is linear part of m
+constexpr vec3 transpose_transform_vector(matrix3x4_t const &m,
+                                          vec3 const &v) {
+  auto const &r = m.rows;
+  return {
+      r[0][0] * v.x + r[1][0] * v.y + r[2][0] * v.z,
+      r[0][1] * v.x + r[1][1] * v.y + r[2][1] * v.z,
+      r[0][2] * v.x + r[1][2] * v.y + r[2][2] * v.z,
+  };
+}
+
+// Postcondition:
+//   - returns bound of image of bound under m
+constexpr bound_t transform_bounds(matrix3x4_t const &m, bound_t const &bound) {
+  std::array<interval_t, 3> const ranges{bound.x_range, bound.y_range,
+                                         bound.z_range};
+  for (auto const &range : ranges) {
+    if (range.min > range.max)
+      return bound_t{};
+  }
+  std::array<interval_t, 3> res;
+  for (std::size_t i = 0; i < 3; ++i) {
+    res[i] = {m.rows[i][3], m.rows[i][3]};
+    for (std::size_t j = 0; j < 3; ++j) {
+      auto const coeff = m.rows[i][j];
+      if (coeff == 0)
+        continue;
+      auto const a = coeff * ranges[j].min;
+      auto const b = coeff * ranges[j].max;
+      res[i].min += std::min(a, b);
+      res[i].max += std::max(a, b);
+    }
+  }
+  return {res[0], res[1], res[2]};
+}
+
+// Invertible affine transform with its inverse.
+//
+// Class Invariant:
+//   - matrix * inverse is identity
+struct transform_t {
+  matrix3x4_t matrix;
+  matrix3x4_t inverse;
+};
+
+constexpr transform_t identity_transform() {
+  return {identity_matrix(), identity_matrix()};
+}
+
+// Postcondition:
+//   - returns transform applying b first and then a
+constexpr transform_t operator*(transform_t const &a, transform_t const &b) {
+  return {a.matrix * b.matrix, b.inverse * a.inverse};
+}
+
+constexpr transform_t inverse(transform_t const &t) {
+  return {t.inverse, t.matrix};
+}
+
+constexpr transform_t translation(vec3 const &offset) {
+  auto matrix = identity_matrix();
+  auto inverse = identity_matrix();
+  for (std::size_t i = 0; i < 3; ++i) {
+    matrix.rows[i][3] = component(offset, static_cast<int>(i));
+    inverse.rows[i][3] = -matrix.rows[i][3];
+  }
+  return {matrix, inverse};
+}
+
+// Precondition:
+//   - no component of factor is 0
+constexpr transform_t scaling(vec3 const &factor) {
+  auto matrix = identity_matrix();
+  auto inverse = identity_matrix();
+  for (std::size_t i = 0; i < 3; ++i) {
+    matrix.rows[i][i] = component(factor, static_cast<int>(i));
+    inverse.rows[i][i] = 1 / matrix.rows[i][i];
+  }
+  return {matrix, inverse};
+}
+
+// Postcondition:
+//   - returns rotation by angle around axis, through axis.origin, mapping
+//     rays as rotate(r, axis, angle) does
+//   - maps points as rotate(p, axis, angle) does only if axis.origin is 0, as
+//     that rotates vectors around a parallel axis through origin of world
+constexpr transform_t rotation(ray_t const &axis, angle_t const &angle) {
+  auto rotation_about_origin = [&axis](double angle_rad) {
+    auto const a = axis.direction.val();
+    auto const c = std::cos(angle_rad);
+    auto const s = std::sin(angle_rad);
+    auto const t = 1 - c;
+    return matrix3x4_t{{{
+        {c + a.x * a.x * t, a.x * a.y * t - a.z * s, a.x * a.z * t + a.y * s,
+         0},
+        {a.y * a.x * t + a.z * s, c + a.y * a.y * t, a.y * a.z * t - a.x * s,
+         0},
+        {a.z * a.x * t - a.y * s, a.z * a.y * t + a.x * s, c + a.z * a.z * t,
+         0},
+    }}};
+  };
+  auto const angle_rad = radians(angle);
+  auto const to_axis = translation(axis.origin);
+  auto const rotated = transform_t{rotation_about_origin(angle_rad),
+                                   rotation_about_origin(-angle_rad)};
+  return to_axis * rotated * inverse(to_axis);
+}
+
+// Ray mapped by a transform. As direction of ray_t is always normalized,
+// distances along it are scaled by distance_scale.
+//
+// Class Invariant:
+//   - point at distance t on original ray is at distance t * distance_scale on
+//     ray
+struct transformed_ray_t {
+  ray_t ray;
+  double distance_scale;
+};
+
+constexpr transformed_ray_t transform_ray(matrix3x4_t const &m,
+                                          ray_t const &r) {
+  auto const direction = transform_vector(m, r.direction.val());
+  auto const scale = direction.length();
+  return {
+      ray_t{transform_point(m, r.origin), dir_from_unit(direction / scale)},
+      scale,
+  };
+}
+} // namespace mrl
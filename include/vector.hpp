@@ -83,6 +83,12 @@ constexpr vec3 cross(vec3 const &a, vec3 const &b) {
   return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
 }
 
+// Precondition:
+//   - axis is one of 0, 1, 2 (x, y, z)
+constexpr double component(vec3 const &v, int axis) {
+  return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
 constexpr vec3 unit_vector(vec3 const &v) { return v / v.length(); }
 
 constexpr vec3 normalize(vec3 const &v) { return unit_vector(v); }
@@ -0,0 +1,46 @@
+#include "scene_objects/grid.hpp"
+#include "scene_objects/kd_tree.hpp"
+#include "test_utils.hpp"
+#include <doctest/doctest.h>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+TEST_CASE("grid hits same as brute force") {
+  random_t rand{17};
+  auto const rays = random_rays(rand, 2000);
+  for (int n : {0, 1, 2, 3, 17, 100, 1000}) {
+    auto const spheres = random_spheres(rand, n);
+    CHECK(count_mismatches(grid_t(spheres), spheres, rays) == 0);
+    auto const coarse_grid =
+        grid_t(spheres, {.density = 0.5, .max_resolution = 4});
+    CHECK(count_mismatches(coarse_grid, spheres, rays) == 0);
+
+    auto const quads = random_quads(rand, n);
+    CHECK(count_mismatches(grid_t(quads), quads, rays) == 0);
+  }
+}
+
+TEST_CASE("kd_tree hits same as brute force") {
+  random_t rand{19};
+  auto const rays = random_rays(rand, 2000);
+  for (int n : {0, 1, 2, 3, 17, 100, 1000}) {
+    auto const spheres = random_spheres(rand, n);
+    CHECK(count_mismatches(kd_tree_t(spheres), spheres, rays) == 0);
+    CHECK(count_mismatches(kd_tree_t(spheres, {.max_leaf_objects = 8}),
+                           spheres, rays) == 0);
+
+    auto const quads = random_quads(rand, n);
+    CHECK(count_mismatches(kd_tree_t(quads), quads, rays) == 0);
+  }
+}
+
+TEST_CASE("grid and kd_tree hit same as brute force on equal objects") {
+  random_t rand{23};
+  auto const rays = random_rays(rand, 2000);
+  auto spheres = random_spheres(rand, 50);
+  spheres.insert(spheres.end(), 20, spheres.front());
+  CHECK(count_mismatches(grid_t(spheres), spheres, rays) == 0);
+  CHECK(count_mismatches(kd_tree_t(spheres), spheres, rays) == 0);
+}
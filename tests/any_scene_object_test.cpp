@@ -0,0 +1,158 @@
+#include "angle.hpp"
+#include "bound.hpp"
+#include "scene_objects/any_scene_object.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/rotate_object.hpp"
+#include "scene_objects/translate_object.hpp"
+#include "test_utils.hpp"
+#include <doctest/doctest.h>
+#include <optional>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+using any_object = any_scene_object<random_t>;
+
+// Sphere counting how many times it is hit, not DeferredHittable.
+struct counting_sphere {
+  using hit_object_type = hit_object_t<sphere_object>;
+
+  sphere_object obj;
+  int *num_hits;
+};
+
+std::optional<hit_info_of<counting_sphere>>
+hit(counting_sphere const &o, ray_t const &r, interval_t const &interval) {
+  ++*o.num_hits;
+  return hit(o.obj, r, interval);
+}
+
+bound_t get_bounds(counting_sphere const &o) { return get_bounds(o.obj); }
+
+// Holds hit objects of objects wrapping an any_object.
+using any_nested_object = any_scene_object<random_t, 192>;
+
+// Spheres and quads, some of them moved or rotated and moved, so that hit
+// objects of several types and sizes are erased.
+std::vector<any_object> random_mixed_objects(random_t &rand, int n) {
+  auto const spheres = random_spheres(rand, n);
+  auto const quads = random_quads(rand, n);
+  std::vector<any_object> res;
+  for (int i = 0; i < n; ++i) {
+    auto const offset = vec3{rand(-1.0, 1.0), rand(-1.0, 1.0), 0};
+    auto const axis = ray_t{point3{0, 0, 0}, direction_t{0, 1, 0}};
+    switch (i % 4) {
+    case 0:
+      res.emplace_back(spheres[static_cast<std::size_t>(i)]);
+      break;
+    case 1:
+      res.emplace_back(quads[static_cast<std::size_t>(i)]);
+      break;
+    case 2:
+      res.emplace_back(
+          translate_object{spheres[static_cast<std::size_t>(i)], offset});
+      break;
+    default:
+      res.emplace_back(rotate_object{
+          translate_object{quads[static_cast<std::size_t>(i)], offset}, axis,
+          degrees(rand(0.0, 90.0))});
+    }
+  }
+  return res;
+}
+} // namespace
+
+TEST_CASE("bvh of any_scene_object hits same as brute force") {
+  random_t rand{47};
+  auto const rays = random_rays(rand, 2000);
+  for (int n : {1, 2, 17, 500}) {
+    auto const objects = random_mixed_objects(rand, n);
+    CHECK(count_mismatches(bvh_t<any_object>(objects), objects, rays) == 0);
+  }
+}
+
+TEST_CASE("any_scene_object with larger buffer holds nested any objects") {
+  random_t rand{53};
+  auto const rays = random_rays(rand, 2000);
+  std::vector<any_nested_object> objects;
+  for (auto const &obj : random_mixed_objects(rand, 100)) {
+    objects.emplace_back(translate_object{obj, vec3{0, 0.5, 0}});
+  }
+  CHECK(count_mismatches(bvh_t<any_nested_object>(objects), objects, rays) ==
+        0);
+}
+
+TEST_CASE("any_scene_object stores large hit objects out of line on request") {
+  random_t rand{73};
+  auto const rays = random_rays(rand, 2000);
+  auto const axis = ray_t{point3{1, 0, 0}, direction_t{0, 0, 1}};
+  std::vector<any_object> objects;
+  for (auto const &obj : random_mixed_objects(rand, 50)) {
+    objects.emplace_back(out_of_line_hit_objects,
+                         translate_object{obj, vec3{0, 0.5, 0}});
+  }
+  for (auto const &quad : random_quads(rand, 50)) {
+    objects.emplace_back(
+        out_of_line_hit_objects,
+        rotate_object{rotate_object{translate_object{quad, vec3{1, 0, 0}}, axis,
+                                    degrees(30)},
+                      axis, degrees(-20)});
+  }
+  CHECK(count_mismatches(bvh_t<any_object>(objects), objects, rays) == 0);
+
+  // Same hits and normals as the wrapped objects hit directly.
+  for (auto const &obj : objects) {
+    auto const wrapped = translate_object{
+        rotate_object{translate_object{obj, vec3{0, 1, 0}}, axis, degrees(10)},
+        vec3{0, 0, 2}};
+    any_object const erased{out_of_line_hit_objects, wrapped};
+    auto const origin = point3{rand(-20.0, 20.0), rand(-20.0, 20.0), -30};
+    auto const r = ray_t{origin, centroid(get_bounds(wrapped)) - origin};
+    auto const expected = hit(wrapped, r, hit_interval);
+    auto const hit_rec = hit(erased, r, hit_interval);
+    REQUIRE(expected.has_value());
+    REQUIRE(hit_rec.has_value());
+    CHECK(hit_rec->hit_distance == expected->hit_distance);
+    auto const p = r.at(hit_rec->hit_distance);
+    CHECK(normal_at(hit_rec->hit_object, p).val() ==
+          normal_at(expected->hit_object, p).val());
+  }
+}
+
+TEST_CASE("bvh hits any_scene_object of non deferred object once") {
+  int num_hits = 0;
+  std::vector<any_object> objects{
+      counting_sphere{sphere_object{sphere{1.0, point3{0, 0, 0}},
+                                    color_t{1, 1, 1}},
+                      &num_hits},
+      sphere_object{sphere{1.0, point3{0, 0, 5}}, color_t{1, 1, 1}},
+  };
+  CHECK_FALSE(is_deferred(objects[0]));
+  CHECK(is_deferred(objects[1]));
+  CHECK_FALSE(defers_hit_object(translate_object{objects[0], vec3{0, 1, 0}}));
+  CHECK(defers_hit_object(translate_object{objects[1], vec3{0, 1, 0}}));
+  bvh_t<any_object> const bvh(objects);
+  auto const r = ray_t{point3{0, 0, -5}, direction_t{0, 0, 1}};
+  auto const expected = brute_force_hit(objects, r, hit_interval);
+  num_hits = 0;
+  auto const hit_rec = hit(bvh, r, hit_interval);
+  REQUIRE(hit_rec.has_value());
+  CHECK(hit_rec->hit_distance == expected);
+  // Not hit again to build its hit object.
+  CHECK(num_hits == 1);
+}
+
+TEST_CASE("bvh of deferred and non deferred any_scene_object hits same as "
+          "brute force") {
+  random_t rand{67};
+  auto const rays = random_rays(rand, 2000);
+  int num_hits = 0;
+  std::vector<any_object> objects;
+  for (auto const &obj : random_mixed_objects(rand, 300)) {
+    objects.push_back(obj);
+    objects.emplace_back(counting_sphere{random_sphere(rand, 10), &num_hits});
+  }
+  CHECK(count_mismatches(bvh_t<any_object>(objects), objects, rays) == 0);
+}
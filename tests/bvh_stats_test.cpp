@@ -0,0 +1,73 @@
+#include "bound.hpp"
+#include "color.hpp"
+#include "materials/lambertian.hpp"
+#include "point.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/bvh/stats.hpp"
+#include "scene_objects/shapes/shape_object.hpp"
+#include "scene_objects/shapes/sphere.hpp"
+#include <doctest/doctest.h>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace mrl;
+
+namespace {
+using sphere_object = shape_object<sphere, lambertian_t<solid_color_texture>>;
+
+bool has_non_finite(std::string const &json) {
+  return json.find("nan") != std::string::npos ||
+         json.find("inf") != std::string::npos;
+}
+} // namespace
+
+TEST_CASE("bvh_stats of empty bvh") {
+  bvh_t<sphere_object> bvh{std::vector<sphere_object>{}};
+  auto const stats = bvh_stats(bvh);
+  CHECK(stats.num_nodes == 0);
+  CHECK(stats.num_leaves == 0);
+  CHECK(stats.num_objects == 0);
+  CHECK(stats.average_leaf_depth == 0);
+  CHECK(stats.sah_cost == 0);
+  auto const json = to_json(stats);
+  CHECK_FALSE(has_non_finite(json));
+  CHECK(json.find("\"leaf_size_histogram\":[]") != std::string::npos);
+}
+
+TEST_CASE("bvh_stats of single leaf") {
+  std::vector<sphere_object> objects{
+      sphere_object{sphere{1.0, point3{0, 0, 0}}, color_t{1, 1, 1}}};
+  bvh_t<sphere_object> bvh{objects};
+  auto const stats = bvh_stats(bvh);
+  CHECK(stats.num_nodes == 1);
+  CHECK(stats.num_leaves == 1);
+  CHECK(stats.num_objects == 1);
+  CHECK(stats.max_depth == 0);
+  CHECK(stats.average_leaf_depth == 0);
+  CHECK_FALSE(has_non_finite(to_json(stats)));
+}
+
+TEST_CASE("to_json writes non finite members as null") {
+  constexpr auto inf = std::numeric_limits<double>::infinity();
+  auto const unbounded =
+      to_minmax_bound(bound_t{{-inf, inf}, {-inf, inf}, {-inf, inf}});
+  std::vector<bvh_node_t> nodes{
+      bvh_node_t{.bounds = unbounded, .offset = 2, .count = 0},
+      bvh_node_t{.bounds = unbounded, .offset = 0, .count = 1},
+      bvh_node_t{.bounds = unbounded, .offset = 1, .count = 1},
+  };
+  auto const json = to_json(bvh_stats(nodes));
+  CHECK_FALSE(has_non_finite(json));
+  CHECK(json.find("\"sah_cost\":null") != std::string::npos);
+
+  bvh_stats_t stats;
+  stats.average_leaf_depth = std::numeric_limits<double>::quiet_NaN();
+  stats.sibling_overlap = inf;
+  auto const json_of_stats = to_json(stats);
+  CHECK_FALSE(has_non_finite(json_of_stats));
+  CHECK(json_of_stats.find("\"average_leaf_depth\":null") !=
+        std::string::npos);
+  CHECK(json_of_stats.find("\"sibling_overlap\":null") != std::string::npos);
+}
@@ -0,0 +1,103 @@
+#include "point.hpp"
+#include "scene_objects/bvh/node.hpp"
+#include "scene_objects/dynamic_bvh.hpp"
+#include "test_utils.hpp"
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <utility>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+using bvh_type = dynamic_bvh_t<sphere_object>;
+
+bool same_sphere(sphere_object const &a, sphere_object const &b) {
+  return a.shape.radius == b.shape.radius && a.shape.center == b.shape.center;
+}
+
+// Postcondition:
+//   - returns if every handle refers to its object and bvh holds no other
+//     objects
+bool handles_valid(
+    bvh_type const &bvh,
+    std::vector<std::pair<bvh_type::handle_t, sphere_object>> const &inserted) {
+  if (bvh.size() != inserted.size())
+    return false;
+  for (auto const &[handle, obj] : inserted) {
+    if (!same_sphere(bvh.object(handle), obj))
+      return false;
+  }
+  return true;
+}
+} // namespace
+
+TEST_CASE("dynamic_bvh hits same as brute force after random edits") {
+  random_t rand{37};
+  auto const rays = random_rays(rand, 500);
+  bvh_type bvh;
+  std::vector<std::pair<bvh_type::handle_t, sphere_object>> inserted;
+  std::vector<sphere_object> objects;
+  for (int step = 0; step < 3000; ++step) {
+    auto const choice = rand(0.0, 1.0);
+    if (inserted.empty() || choice < 0.5) {
+      auto obj = random_sphere(rand, 10);
+      inserted.emplace_back(bvh.insert(obj), obj);
+    } else {
+      auto const i = static_cast<std::size_t>(
+                         rand(0.0, static_cast<double>(inserted.size()))) %
+                     inserted.size();
+      if (choice < 0.8) {
+        bvh.remove(inserted[i].first);
+        inserted[i] = inserted.back();
+        inserted.pop_back();
+      } else {
+        auto obj = random_sphere(rand, 10);
+        bvh.update(inserted[i].first, obj);
+        inserted[i].second = obj;
+      }
+    }
+    CHECK(bvh.height() < bvh_max_depth);
+    if (step % 100 == 0) {
+      CHECK(handles_valid(bvh, inserted));
+      objects.clear();
+      for (auto const &entry : inserted) {
+        objects.push_back(entry.second);
+      }
+      CHECK(count_mismatches(bvh, objects, rays) == 0);
+    }
+  }
+  CHECK(handles_valid(bvh, inserted));
+
+  bvh.rebuild();
+  CHECK(handles_valid(bvh, inserted));
+  CHECK(count_mismatches(bvh, bvh.objects(), rays) == 0);
+
+  while (!inserted.empty()) {
+    bvh.remove(inserted.back().first);
+    inserted.pop_back();
+    CHECK(handles_valid(bvh, inserted));
+  }
+  CHECK(bvh.empty());
+  CHECK(bvh.height() == 0);
+  CHECK(count_mismatches(bvh, bvh.objects(), rays) == 0);
+}
+
+TEST_CASE("dynamic_bvh stays shallow when objects come in sorted order") {
+  // Inserting along a line without balancing would make a list of nodes.
+  random_t rand{41};
+  bvh_type bvh;
+  std::vector<sphere_object> objects;
+  for (int i = 0; i < 5000; ++i) {
+    objects.push_back(sphere_object{
+        sphere{0.4, point3{static_cast<double>(i), 0, 0}}, color_t{1, 1, 1}});
+    bvh.insert(objects.back());
+    CHECK(bvh.height() < bvh_max_depth);
+  }
+  auto rays = random_rays(rand, 500);
+  for (auto &r : rays) {
+    r.origin = point3{rand(0.0, 5000.0), rand(-3.0, 3.0), rand(-3.0, 3.0)};
+  }
+  CHECK(count_mismatches(bvh, objects, rays) == 0);
+}
@@ -0,0 +1,126 @@
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/layout.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/laid_out_bvh.hpp"
+#include "test_utils.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <doctest/doctest.h>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+// Postcondition:
+//   - returns if order is a permutation of indices of nodes starting with 0
+bool is_permutation(std::vector<std::uint32_t> const &order,
+                    std::vector<bvh_node_t> const &nodes) {
+  if (order.size() != nodes.size() || (!order.empty() && order[0] != 0))
+    return false;
+  std::vector<int> seen(nodes.size());
+  for (auto index : order) {
+    if (index >= nodes.size() || seen[index]++ > 0)
+      return false;
+  }
+  return true;
+}
+
+// Postcondition:
+//   - returns if laid out nodes are nodes stored in order, children of every
+//     interior node being stored next to each other if siblings_paired
+bool lays_out(std::vector<bvh_layout_node_t> const &laid_out,
+              std::vector<bvh_node_t> const &nodes,
+              std::vector<std::uint32_t> const &order, bool siblings_paired) {
+  if (laid_out.size() != nodes.size())
+    return false;
+  std::vector<std::uint32_t> position(nodes.size());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    position[order[i]] = static_cast<std::uint32_t>(i);
+  }
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    auto const &node = nodes[order[i]];
+    auto const &laid = laid_out[i];
+    if (laid.count != node.count)
+      return false;
+    if (is_leaf(node)) {
+      if (laid.left != node.offset)
+        return false;
+    } else if (laid.left != position[order[i] + 1] ||
+               laid.right != position[node.offset] ||
+               (siblings_paired && laid.right != laid.left + 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Object, BvhLayout Layout>
+void check_layout(bvh_t<Object> const &bvh, std::vector<Object> const &objects,
+                  std::vector<ray_t> const &rays, Layout const &layout,
+                  bool siblings_paired) {
+  auto const order = layout(bvh.nodes());
+  CHECK(is_permutation(order, bvh.nodes()));
+  laid_out_bvh_t const laid_out(bvh, layout);
+  CHECK(lays_out(laid_out.nodes(), bvh.nodes(), order, siblings_paired));
+  CHECK(count_mismatches(laid_out, objects, rays) == 0);
+}
+
+template <typename Object>
+void check_layouts(std::vector<Object> const &objects,
+                   std::vector<ray_t> const &rays) {
+  bvh_t const bvh(objects, sah_split{});
+  check_layout(bvh, objects, rays, depth_first_layout{}, false);
+  check_layout(bvh, objects, rays, van_emde_boas_layout{}, true);
+
+  bvh_profiler_t const profiler(bvh);
+  CHECK(count_mismatches(profiler, objects, rays) == 0);
+  auto const &visits = profiler.visits();
+  REQUIRE(visits.size() == bvh.nodes().size());
+  // A ray visits children of a node only after visiting it.
+  int unvisited_parents = 0;
+  for (std::size_t i = 0; i < bvh.nodes().size(); ++i) {
+    auto const &node = bvh.nodes()[i];
+    if (!is_leaf(node) &&
+        (visits[i + 1] > visits[i] || visits[node.offset] > visits[i]))
+      ++unvisited_parents;
+  }
+  CHECK(unvisited_parents == 0);
+  if (!objects.empty())
+    CHECK(visits[0] > 0);
+  check_layout(bvh, objects, rays, profiler.layout(), true);
+}
+} // namespace
+
+TEST_CASE("laid out bvh hits same as brute force for every layout") {
+  random_t rand{179};
+  auto const rays = random_rays(rand, 2000);
+  for (int n : {0, 1, 2, 3, 17, 1000}) {
+    check_layouts(random_spheres(rand, n), rays);
+    check_layouts(random_quads(rand, n), rays);
+  }
+}
+
+TEST_CASE("frequency_layout stores most visited nodes first") {
+  random_t rand{181};
+  bvh_t const bvh(random_spheres(rand, 1000), sah_split{});
+  bvh_profiler_t const profiler(bvh);
+  for (auto const &r : random_rays(rand, 2000)) {
+    hit(profiler, r, hit_interval);
+  }
+  auto const &visits = profiler.visits();
+  auto const order = profiler.layout()(bvh.nodes());
+  // Interior nodes are placed by visits, each placing its children as a
+  // pair, so children of hotter nodes come first.
+  std::vector<std::uint64_t> interior_visits;
+  for (std::size_t i = 1; i < order.size(); i += 2) {
+    auto const parent = order[i] - 1;
+    interior_visits.push_back(visits[parent]);
+  }
+  int out_of_order = 0;
+  for (std::size_t i = 1; i < interior_visits.size(); ++i) {
+    if (interior_visits[i] > interior_visits[i - 1])
+      ++out_of_order;
+  }
+  CHECK(out_of_order == 0);
+}
@@ -0,0 +1,118 @@
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/lazy_bvh.hpp"
+#include "test_utils.hpp"
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+template <typename Object, typename Split>
+void check_lazy_bvh(std::vector<Object> const &objects,
+                    std::vector<ray_t> const &rays, Split split,
+                    std::size_t top_depth) {
+  lazy_bvh_t const bvh(objects, split,
+                       lazy_bvh_options{.top_depth = top_depth});
+  CHECK(bvh.num_built_subtrees() == 0);
+  if (objects.empty()) {
+    CHECK(bvh.num_subtrees() == 0);
+  } else {
+    CHECK(bvh.num_subtrees() >= 1);
+    CHECK(bvh.num_subtrees() <= objects.size());
+  }
+  if (top_depth == 0)
+    CHECK(bvh.num_subtrees() == (objects.empty() ? 0 : 1));
+  CHECK(count_mismatches(bvh, objects, rays) == 0);
+  bvh.build_all();
+  CHECK(bvh.num_built_subtrees() == bvh.num_subtrees());
+  CHECK(count_mismatches(bvh, objects, rays) == 0);
+}
+
+template <typename Object>
+void check_lazy_bvhs(std::vector<Object> const &objects,
+                     std::vector<ray_t> const &rays) {
+  // Depth beyond max_split_depth is clamped to it.
+  for (auto top_depth : {std::size_t{0}, std::size_t{1}, std::size_t{8},
+                         std::size_t{100}}) {
+    check_lazy_bvh(objects, rays, median_split{}, top_depth);
+    check_lazy_bvh(objects, rays, sah_split{}, top_depth);
+  }
+}
+
+// Rays from around origin heading away from positive x.
+std::vector<ray_t> rays_heading_back(random_t &rand, int n) {
+  std::vector<ray_t> res;
+  for (auto const &r : random_rays(rand, n)) {
+    auto direction = r.direction.val();
+    direction.x = -std::abs(direction.x) - 0.01;
+    res.push_back(ray_t{r.origin, direction});
+  }
+  return res;
+}
+} // namespace
+
+TEST_CASE("lazy_bvh hits same as brute force for every top depth") {
+  random_t rand{191};
+  auto const rays = random_rays(rand, 1000);
+  for (int n : {0, 1, 2, 17, 1000}) {
+    check_lazy_bvhs(random_spheres(rand, n), rays);
+    check_lazy_bvhs(random_quads(rand, n), rays);
+  }
+}
+
+TEST_CASE("lazy_bvh builds only subtrees rays reach") {
+  random_t rand{193};
+  // Half of objects are far along positive x, where no ray heads.
+  auto objects = random_spheres(rand, 2000);
+  for (std::size_t i = 0; i < objects.size(); i += 2) {
+    objects[i].shape.center = objects[i].shape.center + vec3{100, 0, 0};
+  }
+  auto const rays = rays_heading_back(rand, 1000);
+  lazy_bvh_t const bvh(objects, sah_split{}, lazy_bvh_options{.top_depth = 4});
+  CHECK(count_mismatches(bvh, objects, rays) == 0);
+  CHECK(bvh.num_built_subtrees() > 0);
+  CHECK(bvh.num_built_subtrees() < bvh.num_subtrees());
+}
+
+TEST_CASE("lazy_bvh hits same as brute force from concurrent rays") {
+  random_t rand{197};
+  auto const objects = random_spheres(rand, 2000);
+  auto const rays = random_rays(rand, 1000);
+  std::vector<std::optional<double>> expected;
+  for (auto const &r : rays) {
+    expected.push_back(brute_force_hit(objects, r, hit_interval));
+  }
+  // Every thread traces all rays with its own stride, so that threads reach
+  // unbuilt subtrees together.
+  constexpr static std::array<std::size_t, 4> strides{1, 3, 7, 11};
+  for (int round = 0; round < 5; ++round) {
+    lazy_bvh_t const bvh(objects, median_split{},
+                         lazy_bvh_options{.top_depth = 6});
+    std::atomic<int> mismatches = 0;
+    std::vector<std::thread> threads;
+    for (auto stride : strides) {
+      threads.emplace_back([&, stride] {
+        for (std::size_t k = 0; k < rays.size(); ++k) {
+          auto const i = k * stride % rays.size();
+          auto const hit_rec = hit(bvh, rays[i], hit_interval);
+          if (hit_rec.has_value() != expected[i].has_value() ||
+              (hit_rec && hit_rec->hit_distance != *expected[i]))
+            ++mismatches;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    CHECK(mismatches == 0);
+    CHECK(bvh.num_built_subtrees() > 0);
+    CHECK(count_mismatches(bvh, objects, rays) == 0);
+  }
+}
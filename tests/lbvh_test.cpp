@@ -0,0 +1,46 @@
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/lbvh.hpp"
+#include "scene_objects/concepts.hpp"
+#include "schedulers/inline_scheduler.hpp"
+#include "stdexec/execution.hpp"
+#include "test_utils.hpp"
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+void check_lbvh(lbvh_options options) {
+  random_t rand{7};
+  auto const rays = random_rays(rand, 2000);
+  for (int n : {0, 1, 2, 3, 17, 100, 3000}) {
+    auto objects = random_spheres(rand, n);
+    // Objects with equal Morton codes.
+    if (n > 10) {
+      objects.insert(objects.end(), 5, objects.front());
+    }
+    auto const bvh = build_lbvh(objects, options);
+    CHECK(bvh.objects().size() == objects.size());
+    CHECK(count_mismatches(bvh, objects, rays) == 0);
+
+    auto [parallel_bvh] =
+        stdexec::sync_wait(build_lbvh(inline_scheduler{}, objects, options))
+            .value();
+    REQUIRE(parallel_bvh.nodes().size() == bvh.nodes().size());
+    for (std::size_t i = 0; i < bvh.nodes().size(); ++i) {
+      CHECK(parallel_bvh.nodes()[i].offset == bvh.nodes()[i].offset);
+      CHECK(parallel_bvh.nodes()[i].count == bvh.nodes()[i].count);
+    }
+    CHECK(count_mismatches(parallel_bvh, objects, rays) == 0);
+  }
+}
+} // namespace
+
+TEST_CASE("lbvh hits same as brute force") { check_lbvh({.ploc = false}); }
+
+TEST_CASE("ploc lbvh hits same as brute force") {
+  check_lbvh({.ploc = true});
+  check_lbvh({.ploc = true, .ploc_search_radius = 1});
+}
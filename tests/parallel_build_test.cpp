@@ -0,0 +1,56 @@
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/parallel_build.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "schedulers/inline_scheduler.hpp"
+#include "stdexec/execution.hpp"
+#include "test_utils.hpp"
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+bool same_bounds(bound_t const &a, bound_t const &b) {
+  auto const same = [](interval_t const &x, interval_t const &y) {
+    return x.min == y.min && x.max == y.max;
+  };
+  return same(a.x_range, b.x_range) && same(a.y_range, b.y_range) &&
+         same(a.z_range, b.z_range);
+}
+
+template <typename Split> void check_parallel_build(Split split) {
+  random_t rand{71};
+  for (int n : {0, 1, 2, 3, 17, 1000, 40000}) {
+    auto const spheres = random_spheres(rand, n);
+    bvh_t<sphere_object> const bvh(spheres, split);
+    auto [parallel_bvh] =
+        stdexec::sync_wait(build_bvh(inline_scheduler{}, spheres, split))
+            .value();
+    REQUIRE(parallel_bvh.nodes().size() == bvh.nodes().size());
+    int node_mismatches = 0;
+    for (std::size_t i = 0; i < bvh.nodes().size(); ++i) {
+      auto const &a = parallel_bvh.nodes()[i];
+      auto const &b = bvh.nodes()[i];
+      if (a.offset != b.offset || a.count != b.count ||
+          !same_bounds(to_bound(a.bounds), to_bound(b.bounds)))
+        ++node_mismatches;
+    }
+    CHECK(node_mismatches == 0);
+    REQUIRE(parallel_bvh.objects().size() == bvh.objects().size());
+    int object_mismatches = 0;
+    for (std::size_t i = 0; i < bvh.objects().size(); ++i) {
+      if (parallel_bvh.objects()[i].shape.center !=
+          bvh.objects()[i].shape.center)
+        ++object_mismatches;
+    }
+    CHECK(object_mismatches == 0);
+  }
+}
+} // namespace
+
+TEST_CASE("parallel bvh build gives same bvh as serial build") {
+  check_parallel_build(median_split{});
+  check_parallel_build(sah_split{});
+}
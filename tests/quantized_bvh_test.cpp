@@ -0,0 +1,51 @@
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/quantized_bvh.hpp"
+#include "test_utils.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <doctest/doctest.h>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+TEST_CASE("quantized_bvh hits same as brute force") {
+  random_t rand{29};
+  auto const rays = random_rays(rand, 2000);
+  for (int n : {0, 1, 2, 3, 17, 100, 1000}) {
+    auto const spheres = random_spheres(rand, n);
+    CHECK(count_mismatches(quantized_bvh_t<sphere_object>(spheres), spheres,
+                           rays) == 0);
+    CHECK(count_mismatches(
+              quantized_bvh_t<sphere_object>(spheres, sah_split{}), spheres,
+              rays) == 0);
+    CHECK(count_mismatches(
+              quantized_bvh_t<sphere_object, std::uint16_t>(spheres), spheres,
+              rays) == 0);
+
+    auto const quads = random_quads(rand, n);
+    CHECK(count_mismatches(quantized_bvh_t<quad_object>(quads, sah_split{}),
+                           quads, rays) == 0);
+  }
+}
+
+TEST_CASE("quantized_bvh hits same as brute force on far apart objects") {
+  // Small objects far from each other make child bounds tiny relative to
+  // their parent, where rounding bounds outwards matters most.
+  random_t rand{31};
+  auto spheres = random_spheres(rand, 200, 1000);
+  spheres.insert(spheres.end(), 5, spheres.front());
+  // Rays aimed at spheres, as random ones would miss nearly all of them.
+  auto rays = random_rays(rand, 2000, 1000);
+  for (std::size_t i = 0; i < rays.size(); ++i) {
+    auto const &target = spheres[i % spheres.size()].shape.center;
+    rays[i].direction = target - rays[i].origin;
+  }
+  int num_hits = 0;
+  for (auto const &r : rays) {
+    num_hits += brute_force_hit(spheres, r, hit_interval).has_value();
+  }
+  CHECK(num_hits == static_cast<int>(rays.size()));
+  CHECK(count_mismatches(quantized_bvh_t<sphere_object>(spheres, sah_split{}),
+                         spheres, rays) == 0);
+}
@@ -0,0 +1,199 @@
+#include "angle.hpp"
+#include "bound.hpp"
+#include "camera/camera.hpp"
+#include "camera/camera_orientation.hpp"
+#include "image/in_memory_image.hpp"
+#include "image_renderer.hpp"
+#include "pixel_sampler/identity_sampler.hpp"
+#include "ray_packet.hpp"
+#include "scene_objects/any_scene_object.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/translate_object.hpp"
+#include "schedulers/inline_scheduler.hpp"
+#include "stdexec/execution.hpp"
+#include "test_utils.hpp"
+#include <cmath>
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <limits>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+using any_object = any_scene_object<random_t>;
+
+// Rays from around bounds aimed at random points in it.
+std::vector<ray_t> aimed_rays(random_t &rand, bound_t const &bounds, int n) {
+  auto const in = [&](interval_t const &range) {
+    return rand(range.min, range.max);
+  };
+  std::vector<ray_t> res;
+  for (int i = 0; i < n; ++i) {
+    auto const target =
+        point3{in(bounds.x_range), in(bounds.y_range), in(bounds.z_range)};
+    auto const origin = target + vec3{rand(-20.0, 20.0), rand(-20.0, 20.0),
+                                      rand(-20.0, 20.0)};
+    res.push_back(ray_t{origin, target - origin});
+  }
+  return res;
+}
+
+// Checks hit_lanes does for every lane in a random mask what hit does for ray
+// of that lane, and leaves other lanes alone. Some lanes look for hits
+// closer than a hit found before.
+template <std::size_t N, typename Object>
+void check_lanes(random_t &rand, Object const &obj,
+                 std::vector<ray_t> const &rays) {
+  constexpr auto infinity = std::numeric_limits<double>::infinity();
+  int mismatches = 0;
+  for (std::size_t first = 0; first + N <= rays.size(); first += N) {
+    ray_packet_t<N> packet{};
+    for (std::size_t lane = 0; lane < N; ++lane) {
+      set_lane(packet, lane, rays[first + lane]);
+    }
+    packet_mask_t active = 0;
+    packet_hits_t<hit_object_t<Object>, N> hits;
+    for (std::size_t lane = 0; lane < N; ++lane) {
+      if (first % (4 * N) == 0 || rand(0.0, 1.0) < 0.6)
+        active |= packet_mask_t{1} << lane;
+      hits.closest[lane] = rand(0.0, 1.0) < 0.3 ? rand(1.0, 30.0) : infinity;
+    }
+    auto const closest = hits.closest;
+    auto const res = hit_lanes(obj, packet, hit_interval.min, hits, active);
+    for (std::size_t lane = 0; lane < N; ++lane) {
+      auto const in_res = (res >> lane & 1) != 0;
+      auto const &hit_rec = hits.hits[lane];
+      if ((active >> lane & 1) == 0) {
+        if (in_res || hit_rec || hits.closest[lane] != closest[lane])
+          ++mismatches;
+        continue;
+      }
+      auto const expected = hit(obj, lane_ray(packet, lane),
+                                interval_t{hit_interval.min, closest[lane]});
+      if (in_res != expected.has_value() ||
+          hit_rec.has_value() != expected.has_value()) {
+        ++mismatches;
+      } else if (expected) {
+        if (std::abs(hit_rec->hit_distance - expected->hit_distance) > 1e-9 ||
+            hits.closest[lane] != hit_rec->hit_distance)
+          ++mismatches;
+      } else if (hits.closest[lane] != closest[lane]) {
+        ++mismatches;
+      }
+    }
+  }
+  CHECK(mismatches == 0);
+}
+
+template <typename Object>
+void check_packets(random_t &rand, Object const &obj,
+                   std::vector<ray_t> const &rays) {
+  check_lanes<4>(rand, obj, rays);
+  check_lanes<8>(rand, obj, rays);
+  check_lanes<16>(rand, obj, rays);
+}
+
+// Spheres and quads, some of them moved, so that both packet kernels and
+// fallback to hit are erased.
+std::vector<any_object> random_any_objects(random_t &rand, int n) {
+  auto const spheres = random_spheres(rand, n);
+  auto const quads = random_quads(rand, n);
+  std::vector<any_object> res;
+  for (std::size_t i = 0; i < spheres.size(); ++i) {
+    auto const offset = vec3{rand(-1.0, 1.0), rand(-1.0, 1.0), 0};
+    switch (i % 3) {
+    case 0:
+      res.emplace_back(spheres[i]);
+      break;
+    case 1:
+      res.emplace_back(quads[i]);
+      break;
+    default:
+      res.emplace_back(translate_object{spheres[i], offset});
+    }
+  }
+  return res;
+}
+} // namespace
+
+TEST_CASE("hit_lanes of spheres and quads hits same as hit for every lane") {
+  random_t rand{157};
+  for (auto const &sphere : random_spheres(rand, 50)) {
+    check_packets(rand, sphere, aimed_rays(rand, get_bounds(sphere), 64));
+  }
+  for (auto const &quad : random_quads(rand, 50)) {
+    check_packets(rand, quad, aimed_rays(rand, get_bounds(quad), 64));
+  }
+  for (auto const &sphere : random_spheres(rand, 20)) {
+    translate_object const moved{sphere, vec3{1, 2, 3}};
+    check_packets(rand, moved, aimed_rays(rand, get_bounds(moved), 64));
+  }
+}
+
+TEST_CASE("hit_lanes of any_scene_object hits same as hit for every lane") {
+  random_t rand{163};
+  for (auto const &obj : random_any_objects(rand, 60)) {
+    check_packets(rand, obj, aimed_rays(rand, get_bounds(obj), 64));
+  }
+}
+
+TEST_CASE("hit_lanes of bvh hits same as hit for every lane") {
+  random_t rand{167};
+  auto const scene = bound_from_diagonal_points({-10, -10, -10}, {10, 10, 10});
+  auto rays = aimed_rays(rand, scene, 1024);
+  for (auto const &r : random_rays(rand, 1024)) {
+    rays.push_back(r);
+  }
+  for (int n : {0, 1, 17, 1000}) {
+    check_packets(rand, bvh_t(random_spheres(rand, n), sah_split{}), rays);
+    check_packets(rand, bvh_t(random_quads(rand, n), sah_split{}), rays);
+    check_packets(rand, bvh_t(random_any_objects(rand, n), sah_split{}),
+                  rays);
+  }
+}
+
+TEST_CASE("packet render modes hit same pixels as single rays") {
+  random_t rand{173};
+  bvh_t const world(random_any_objects(rand, 300), sah_split{});
+  // Camera rays are not scattered at depth 1, so that pixels are background
+  // color where they miss and black where they hit, whatever random numbers
+  // modes draw. Size of image is not a multiple of any tile size.
+  auto const render = [&](render_mode_t mode) {
+    img_renderer_t<camera_t, inline_scheduler, identity_sampler> renderer(
+        camera_t{.focus_distance = 10,
+                 .vertical_fov = degrees(60),
+                 .defocus_angle = degrees(0)},
+        camera_orientation_t{.look_from = point3{0, 0, 25},
+                             .look_at = point3{0, 0, 0},
+                             .up_dir = direction_t{0, 1, 0}},
+        color_t{1, 1, 1}, inline_scheduler{}, 0, 1, identity_sampler{});
+    renderer.render_mode = mode;
+    in_memory_image img(37, 23);
+    stdexec::sync_wait(renderer.render(world, img));
+    return img;
+  };
+  auto const expected = render(render_mode_t::single_ray);
+  int num_hits = 0;
+  for (int y = 0; y < height(expected); ++y) {
+    for (int x = 0; x < width(expected); ++x) {
+      num_hits += pixel_at(expected, x, y).r == 0;
+    }
+  }
+  CHECK(num_hits > 0);
+  CHECK(num_hits < width(expected) * height(expected));
+  for (auto mode : {render_mode_t::packet_4, render_mode_t::packet_8,
+                    render_mode_t::packet_16}) {
+    auto const img = render(mode);
+    int mismatches = 0;
+    for (int y = 0; y < height(img); ++y) {
+      for (int x = 0; x < width(img); ++x) {
+        if (pixel_at(img, x, y).r != pixel_at(expected, x, y).r)
+          ++mismatches;
+      }
+    }
+    CHECK(mismatches == 0);
+  }
+}
@@ -0,0 +1,38 @@
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/ray_queue_bvh.hpp"
+#include "scene_objects/traits.hpp"
+#include "test_utils.hpp"
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <optional>
+#include <span>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+TEST_CASE("ray_queue_bvh hit_stream hits same as brute force") {
+  random_t rand{43};
+  auto const rays = random_rays(rand, 3000);
+  for (int n : {0, 1, 2, 17, 1000}) {
+    auto const spheres = random_spheres(rand, n);
+    // Treelets of a few nodes, so that rays are queued on many of them.
+    for (std::size_t treelet_bytes : {std::size_t{1}, std::size_t{1024},
+                                      std::size_t{1024 * 1024}}) {
+      ray_queue_bvh_t const bvh(bvh_t(spheres, sah_split{}),
+                                {.treelet_bytes = treelet_bytes});
+      std::vector<std::optional<hit_info_of<sphere_object>>> hits(
+          rays.size());
+      bvh.hit_stream(rays, hit_interval, hits);
+      int mismatches = 0;
+      for (std::size_t i = 0; i < rays.size(); ++i) {
+        auto const expected = brute_force_hit(spheres, rays[i], hit_interval);
+        if (hits[i].has_value() != expected.has_value() ||
+            (hits[i] && hits[i]->hit_distance != *expected))
+          ++mismatches;
+      }
+      CHECK(mismatches == 0);
+    }
+  }
+}
@@ -0,0 +1,125 @@
+#include "angle.hpp"
+#include "bound.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/instance.hpp"
+#include "scene_objects/two_level_bvh.hpp"
+#include "schedulers/inline_scheduler.hpp"
+#include "stdexec/execution.hpp"
+#include "test_utils.hpp"
+#include "transform.hpp"
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <memory>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+bool same_bounds(bound_t const &a, bound_t const &b) {
+  auto const same = [](interval_t const &x, interval_t const &y) {
+    return x.min == y.min && x.max == y.max;
+  };
+  return same(a.x_range, b.x_range) && same(a.y_range, b.y_range) &&
+         same(a.z_range, b.z_range);
+}
+
+// Postcondition:
+//   - returns if bounds of every node are union of bounds of its children,
+//     or of its objects for leaves
+template <typename Object> bool tight(bvh_t<Object> const &bvh) {
+  auto const &nodes = bvh.nodes();
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    auto const &node = nodes[i];
+    bound_t expected;
+    if (is_leaf(node)) {
+      for (auto j = node.offset; j < node.offset + node.count; ++j) {
+        expected = union_bounds(expected, get_bounds(bvh.objects()[j]));
+      }
+    } else {
+      expected = union_bounds(to_bound(nodes[i + 1].bounds),
+                              to_bound(nodes[node.offset].bounds));
+    }
+    if (!same_bounds(to_bound(node.bounds), expected))
+      return false;
+  }
+  return true;
+}
+
+// Moves every object by up to max_offset along each axis.
+void move_objects(bvh_t<sphere_object> &bvh, random_t &rand,
+                  double max_offset) {
+  for (auto &obj : bvh.objects()) {
+    obj.shape.center =
+        obj.shape.center + vec3{rand(-max_offset, max_offset),
+                                rand(-max_offset, max_offset),
+                                rand(-max_offset, max_offset)};
+  }
+}
+} // namespace
+
+TEST_CASE("bvh hits moved objects after refit") {
+  random_t rand{127};
+  auto const rays = random_rays(rand, 2000);
+  // 5000 objects give more subtrees than a refit plan splits into.
+  for (int n : {0, 1, 2, 17, 1000, 5000}) {
+    bvh_t bvh(random_spheres(rand, n), sah_split{});
+    move_objects(bvh, rand, 2);
+    auto parallel_bvh = bvh;
+    bvh.refit();
+    CHECK(tight(bvh));
+    CHECK(count_mismatches(bvh, bvh.objects(), rays) == 0);
+
+    stdexec::sync_wait(parallel_bvh.refit(inline_scheduler{}));
+    REQUIRE(parallel_bvh.nodes().size() == bvh.nodes().size());
+    int mismatches = 0;
+    for (std::size_t i = 0; i < bvh.nodes().size(); ++i) {
+      if (!same_bounds(to_bound(parallel_bvh.nodes()[i].bounds),
+                       to_bound(bvh.nodes()[i].bounds)))
+        ++mismatches;
+    }
+    CHECK(mismatches == 0);
+  }
+}
+
+TEST_CASE("bvh needs rebuild after objects move far") {
+  random_t rand{131};
+  auto const rays = random_rays(rand, 2000);
+  bvh_t bvh(random_spheres(rand, 1000), sah_split{});
+  CHECK_FALSE(bvh.needs_rebuild());
+  move_objects(bvh, rand, 0.01);
+  bvh.refit();
+  CHECK_FALSE(bvh.needs_rebuild());
+  // Scattering objects makes every node span most of the scene.
+  move_objects(bvh, rand, 10);
+  bvh.refit();
+  CHECK(bvh.needs_rebuild());
+  auto const refitted_cost = bvh.sah_cost();
+  bvh.rebuild(sah_split{});
+  CHECK(bvh.sah_cost() < refitted_cost);
+  CHECK_FALSE(bvh.needs_rebuild());
+  CHECK(tight(bvh));
+  CHECK(count_mismatches(bvh, bvh.objects(), rays) == 0);
+}
+
+TEST_CASE("two_level_bvh hits moved instances after refit_top_level") {
+  random_t rand{137};
+  auto const rays = random_rays(rand, 2000, 20);
+  auto const bottom = std::make_shared<bvh_t<sphere_object> const>(
+      random_spheres(rand, 30, 2), sah_split{});
+  std::vector<instance_t<bvh_t<sphere_object>>> instances;
+  for (int i = 0; i < 100; ++i) {
+    instances.emplace_back(
+        bottom, translation(vec3{rand(-15.0, 15.0), rand(-15.0, 15.0),
+                                 rand(-15.0, 15.0)}));
+  }
+  two_level_bvh_t bvh(std::move(instances));
+  auto const axis = ray_t{point3{0, 0, 0}, direction_t{0, 1, 0}};
+  for (std::size_t i = 0; i < bvh.instances().size(); i += 3) {
+    bvh.set_transform(i, rotation(axis, degrees(rand(-10.0, 10.0))) *
+                             bvh.instances()[i].transform);
+  }
+  bvh.refit_top_level();
+  CHECK(count_mismatches(bvh, bvh.instances(), rays) == 0);
+}
@@ -0,0 +1,38 @@
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/sbvh.hpp"
+#include "test_utils.hpp"
+#include <doctest/doctest.h>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+TEST_CASE("sbvh hits same as brute force") {
+  random_t rand{11};
+  auto const rays = random_rays(rand, 2000);
+  for (int n : {0, 1, 2, 3, 17, 100, 1000}) {
+    auto const spheres = random_spheres(rand, n);
+    CHECK(count_mismatches(build_sbvh(spheres), spheres, rays) == 0);
+
+    auto const quads = random_quads(rand, n);
+    auto const bvh = build_sbvh(quads);
+    CHECK(bvh.objects().size() >= quads.size());
+    CHECK(count_mismatches(bvh, quads, rays) == 0);
+  }
+}
+
+TEST_CASE("sbvh duplicates no more references than allowed") {
+  random_t rand{13};
+  auto const rays = random_rays(rand, 2000);
+  auto const quads = random_quads(rand, 500, 10, 20);
+  for (double max_duplication : {0.0, 0.25, 1.0}) {
+    auto const bvh = build_sbvh(quads, {.max_duplication = max_duplication});
+    CHECK(static_cast<double>(bvh.objects().size()) <=
+          (1 + max_duplication) * static_cast<double>(quads.size()));
+    CHECK(count_mismatches(bvh, quads, rays) == 0);
+  }
+  // Long quads overlap enough that some of them are clipped into more than
+  // one leaf.
+  CHECK(build_sbvh(quads, {.max_duplication = 1.0}).objects().size() >
+        quads.size());
+}
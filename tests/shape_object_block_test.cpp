@@ -0,0 +1,60 @@
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/shapes/shape_object_block.hpp"
+#include "test_utils.hpp"
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+template <std::size_t N, typename Object>
+void check_blocks(std::vector<Object> const &objects,
+                  std::vector<ray_t> const &rays) {
+  auto const blocks = make_shape_object_blocks<N>(objects, sah_split{});
+  std::size_t num_objects = 0;
+  for (auto const &block : blocks) {
+    CHECK(block.objects().size() > 0);
+    CHECK(block.objects().size() <= N);
+    num_objects += block.objects().size();
+  }
+  CHECK(num_objects == objects.size());
+  CHECK(count_mismatches(blocks, objects, rays) == 0);
+  CHECK(count_mismatches(bvh_t(blocks, sah_split{}), objects, rays) == 0);
+}
+} // namespace
+
+TEST_CASE("shape_object_block hits same as brute force") {
+  random_t rand{59};
+  auto const rays = random_rays(rand, 2000);
+  for (int n : {0, 1, 3, 5, 17, 500}) {
+    auto const spheres = random_spheres(rand, n);
+    check_blocks<4>(spheres, rays);
+    check_blocks<8>(spheres, rays);
+
+    auto const quads = random_quads(rand, n);
+    check_blocks<4>(quads, rays);
+    check_blocks<8>(quads, rays);
+  }
+}
+
+TEST_CASE("shape_object_block hit object refers to object hit") {
+  random_t rand{61};
+  auto const spheres = random_spheres(rand, 7);
+  auto const blocks = make_shape_object_blocks<8>(spheres);
+  REQUIRE(blocks.size() == 1);
+  auto const &block = blocks.front();
+  for (auto const &obj : block.objects()) {
+    auto const center = obj.shape.center;
+    auto const r = ray_t{center + vec3{0, 0, -50}, direction_t{0, 0, 1}};
+    auto const hit_rec = hit(block, r, hit_interval);
+    REQUIRE(hit_rec.has_value());
+    auto const expected = brute_force_hit(block.objects(), r, hit_interval);
+    CHECK(hit_rec->hit_distance == *expected);
+    CHECK(hit_rec->hit_object.obj >= block.objects().data());
+    CHECK(hit_rec->hit_object.obj <
+          block.objects().data() + block.objects().size());
+  }
+}
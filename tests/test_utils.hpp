@@ -0,0 +1,113 @@
+#pragma once
+
+#include "color.hpp"
+#include "generator/random_double_generator.hpp"
+#include "hit_info.hpp"
+#include "interval.hpp"
+#include "materials/lambertian.hpp"
+#include "point.hpp"
+#include "ray.hpp"
+#include "scene_objects/concepts.hpp"
+#include "scene_objects/shapes/quad.hpp"
+#include "scene_objects/shapes/shape_object.hpp"
+#include "scene_objects/shapes/sphere.hpp"
+#include "vector.hpp"
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <vector>
+
+namespace mrl::test {
+using random_t = random_double_generator;
+using sphere_object = shape_object<sphere, lambertian_t<solid_color_texture>>;
+using quad_object = shape_object<quad, lambertian_t<solid_color_texture>>;
+
+constexpr static interval_t hit_interval{
+    0.001, std::numeric_limits<double>::infinity()};
+
+// Sphere with center in [-extent, extent]^3.
+inline sphere_object random_sphere(random_t &rand, double extent) {
+  auto center = point3{rand(-extent, extent), rand(-extent, extent),
+                       rand(-extent, extent)};
+  return sphere_object{sphere{rand(0.05, 1.0), center}, color_t{1, 1, 1}};
+}
+
+inline std::vector<sphere_object> random_spheres(random_t &rand, int n,
+                                                 double extent = 10) {
+  std::vector<sphere_object> res;
+  for (int i = 0; i < n; ++i) {
+    res.push_back(random_sphere(rand, extent));
+  }
+  return res;
+}
+
+// Quads with corner in [-extent, extent]^3 and sides up to side_length long,
+// so that long ones overlap many others.
+inline std::vector<quad_object> random_quads(random_t &rand, int n,
+                                             double extent = 10,
+                                             double side_length = 8) {
+  auto random_side = [&] {
+    return vec3{rand(-side_length, side_length) / 2,
+                rand(-side_length, side_length) / 2,
+                rand(-side_length, side_length) / 2};
+  };
+  std::vector<quad_object> res;
+  for (int i = 0; i < n; ++i) {
+    auto corner = point3{rand(-extent, extent), rand(-extent, extent),
+                         rand(-extent, extent)};
+    res.push_back(quad_object{quad{corner, random_side(), random_side()},
+                              color_t{1, 1, 1}});
+  }
+  return res;
+}
+
+// Rays from [-extent, extent]^3 in random directions, so that some of them
+// start inside objects and some miss all of them.
+inline std::vector<ray_t> random_rays(random_t &rand, int n,
+                                      double extent = 12) {
+  std::vector<ray_t> res;
+  for (int i = 0; i < n; ++i) {
+    auto origin = point3{rand(-extent, extent), rand(-extent, extent),
+                         rand(-extent, extent)};
+    auto direction = vec3{rand(-1.0, 1.0), rand(-1.0, 1.0), rand(-1.0, 1.0)};
+    res.push_back(ray_t{origin, direction});
+  }
+  return res;
+}
+
+// Postcondition:
+//   - returns distance of closest hit of r among objects, by hitting every
+//     one of them
+template <std::ranges::input_range Range>
+  requires SceneObject<std::ranges::range_value_t<Range>>
+std::optional<double> brute_force_hit(Range const &objects, ray_t const &r,
+                                      interval_t const &interval) {
+  std::optional<double> res;
+  for (auto const &obj : objects) {
+    auto const hit_rec = hit(obj, r, interval);
+    if (hit_rec && (!res || hit_rec->hit_distance < *res))
+      res = hit_rec->hit_distance;
+  }
+  return res;
+}
+
+// Postcondition:
+//   - returns number of rays whose hit or occlusion of accelerator differs
+//     from brute force over objects
+template <SceneObject Accelerator, std::ranges::input_range Range>
+  requires SceneObject<std::ranges::range_value_t<Range>>
+int count_mismatches(Accelerator const &accelerator, Range const &objects,
+                     std::vector<ray_t> const &rays) {
+  int res = 0;
+  for (auto const &r : rays) {
+    auto const hit_rec = hit(accelerator, r, hit_interval);
+    auto const expected = brute_force_hit(objects, r, hit_interval);
+    if (hit_rec.has_value() != expected.has_value() ||
+        (hit_rec && hit_rec->hit_distance != *expected) ||
+        is_occluded(accelerator, r, hit_interval) != expected.has_value()) {
+      ++res;
+    }
+  }
+  return res;
+}
+} // namespace mrl::test
@@ -0,0 +1,110 @@
+#include "angle.hpp"
+#include "bound.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/rotate_object.hpp"
+#include "scene_objects/transform_object.hpp"
+#include "scene_objects/translate_object.hpp"
+#include "test_utils.hpp"
+#include <cmath>
+#include <concepts>
+#include <doctest/doctest.h>
+#include <utility>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+constexpr double tolerance = 1e-9;
+
+bool contains(bound_t const &bounds, point3 const &p) {
+  auto inside = [](interval_t const &range, double x) {
+    return range.min - tolerance <= x && x <= range.max + tolerance;
+  };
+  return inside(bounds.x_range, p.x) && inside(bounds.y_range, p.y) &&
+         inside(bounds.z_range, p.z);
+}
+
+// Axis through a random point off origin of world.
+ray_t random_axis(random_t &rand) {
+  return ray_t{point3{rand(-5.0, 5.0), rand(-5.0, 5.0), rand(-5.0, 5.0)},
+               vec3{rand(-1.0, 1.0), rand(-1.0, 1.0), rand(-1.0, 1.0)}};
+}
+
+// Translate of rotate of rotate of obj, rotating around axes off origin.
+template <typename Object> auto random_chain(random_t &rand, Object obj) {
+  return translate_object{
+      rotate_object{rotate_object{std::move(obj), random_axis(rand),
+                                  degrees(rand(-180.0, 180.0))},
+                    random_axis(rand), degrees(rand(-180.0, 180.0))},
+      vec3{rand(-3.0, 3.0), rand(-3.0, 3.0), rand(-3.0, 3.0)}};
+}
+
+// Checks collapsed hits the same points as chain with same normals, for rays
+// aimed at its center and for random rays.
+template <typename Chain>
+void check_collapsed(random_t &rand, Chain const &chain,
+                     std::vector<ray_t> const &random_rays) {
+  auto const collapsed = make_transform_object(chain);
+  auto const chain_bounds = get_bounds(chain);
+  auto const collapsed_bounds = get_bounds(collapsed);
+  auto const origin = point3{rand(-20.0, 20.0), rand(-20.0, 20.0), -30};
+  auto rays = random_rays;
+  rays.push_back(ray_t{origin, centroid(collapsed_bounds) - origin});
+  for (auto const &r : rays) {
+    auto const expected = hit(chain, r, hit_interval);
+    auto const hit_rec = hit(collapsed, r, hit_interval);
+    REQUIRE(hit_rec.has_value() == expected.has_value());
+    if (!hit_rec)
+      continue;
+    CHECK(std::abs(hit_rec->hit_distance - expected->hit_distance) <
+          tolerance);
+    auto const p = r.at(expected->hit_distance);
+    CHECK(contains(chain_bounds, p));
+    CHECK(contains(collapsed_bounds, p));
+    auto const normal = normal_at(hit_rec->hit_object, p).val();
+    auto const expected_normal = normal_at(expected->hit_object, p).val();
+    CHECK((normal - expected_normal).length() < tolerance);
+  }
+  CHECK(hit(collapsed, rays.back(), hit_interval).has_value());
+}
+} // namespace
+
+TEST_CASE("make_transform_object hits same as translate and rotate chain") {
+  random_t rand{79};
+  auto const rays = random_rays(rand, 200);
+  for (auto const &sphere : random_spheres(rand, 100)) {
+    check_collapsed(rand, random_chain(rand, sphere), rays);
+  }
+  for (auto const &quad : random_quads(rand, 100)) {
+    check_collapsed(rand, random_chain(rand, quad), rays);
+  }
+}
+
+TEST_CASE("make_transform_object collapses nested transform objects") {
+  random_t rand{83};
+  auto const rays = random_rays(rand, 200);
+  for (auto const &sphere : random_spheres(rand, 50)) {
+    auto const inner = make_transform_object(random_chain(rand, sphere));
+    auto const chain = random_chain(rand, inner);
+    auto const collapsed = make_transform_object(chain);
+    static_assert(std::same_as<decltype(collapsed),
+                               transform_object<sphere_object> const>);
+    check_collapsed(rand, chain, rays);
+  }
+}
+
+TEST_CASE("bvh of translate and rotate chains hits same as brute force") {
+  random_t rand{89};
+  auto const rays = random_rays(rand, 2000);
+  using chain_type =
+      decltype(random_chain(rand, std::declval<sphere_object>()));
+  std::vector<chain_type> chains;
+  std::vector<transform_object<sphere_object>> collapsed;
+  for (auto const &sphere : random_spheres(rand, 300)) {
+    chains.push_back(random_chain(rand, sphere));
+    collapsed.push_back(make_transform_object(chains.back()));
+  }
+  CHECK(count_mismatches(bvh_t(chains), chains, rays) == 0);
+  CHECK(count_mismatches(bvh_t(collapsed), collapsed, rays) == 0);
+}
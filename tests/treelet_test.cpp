@@ -0,0 +1,123 @@
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/lbvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "schedulers/inline_scheduler.hpp"
+#include "stdexec/execution.hpp"
+#include "test_utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <utility>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+bool same_bounds(bound_t const &a, bound_t const &b) {
+  auto const same = [](interval_t const &x, interval_t const &y) {
+    return x.min == y.min && x.max == y.max;
+  };
+  return same(a.x_range, b.x_range) && same(a.y_range, b.y_range) &&
+         same(a.z_range, b.z_range);
+}
+
+// Postcondition:
+//   - returns number of nodes on longest path from root to a leaf, 0 for an
+//     empty bvh
+std::size_t height(std::vector<bvh_node_t> const &nodes) {
+  if (nodes.empty())
+    return 0;
+  std::vector<std::size_t> res(nodes.size(), 1);
+  // Children follow their parent, so visiting backwards sees them first.
+  for (auto i = nodes.size(); i-- > 0;) {
+    if (!is_leaf(nodes[i]))
+      res[i] = 1 + std::max(res[i + 1], res[nodes[i].offset]);
+  }
+  return res[0];
+}
+
+// Postcondition:
+//   - returns offset and count of every leaf, sorted
+std::vector<std::pair<std::uint32_t, std::uint32_t>>
+leaves(std::vector<bvh_node_t> const &nodes) {
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> res;
+  for (auto const &node : nodes) {
+    if (is_leaf(node))
+      res.emplace_back(node.offset, node.count);
+  }
+  std::ranges::sort(res);
+  return res;
+}
+
+template <typename Object>
+void check_restructure(bvh_t<Object> bvh, std::vector<Object> const &objects,
+                       std::vector<ray_t> const &rays) {
+  auto const original_leaves = leaves(bvh.nodes());
+  auto parallel_bvh = bvh;
+  auto const report = bvh.restructure_treelets();
+  CHECK(report.sah_cost_after <= report.sah_cost_before);
+  CHECK(report.sah_cost_after == bvh.sah_cost());
+  CHECK(height(bvh.nodes()) < bvh_max_depth);
+  CHECK(leaves(bvh.nodes()) == original_leaves);
+  CHECK(count_mismatches(bvh, objects, rays) == 0);
+
+  auto [parallel_report] =
+      stdexec::sync_wait(parallel_bvh.restructure_treelets(inline_scheduler{}))
+          .value();
+  CHECK(parallel_report.sah_cost_before == report.sah_cost_before);
+  CHECK(parallel_report.sah_cost_after == report.sah_cost_after);
+  REQUIRE(parallel_bvh.nodes().size() == bvh.nodes().size());
+  int mismatches = 0;
+  for (std::size_t i = 0; i < bvh.nodes().size(); ++i) {
+    auto const &a = parallel_bvh.nodes()[i];
+    auto const &b = bvh.nodes()[i];
+    if (a.offset != b.offset || a.count != b.count ||
+        !same_bounds(to_bound(a.bounds), to_bound(b.bounds)))
+      ++mismatches;
+  }
+  CHECK(mismatches == 0);
+}
+
+template <typename Object>
+void check_restructures(std::vector<Object> const &objects,
+                        std::vector<ray_t> const &rays) {
+  check_restructure(bvh_t(objects, median_split{}), objects, rays);
+  check_restructure(bvh_t(objects, sah_split{}), objects, rays);
+  check_restructure(build_lbvh(objects), objects, rays);
+}
+} // namespace
+
+TEST_CASE("bvh hits same as brute force after restructuring treelets") {
+  random_t rand{139};
+  auto const rays = random_rays(rand, 2000);
+  for (int n : {0, 1, 2, 3, 8, 17, 1000, 5000}) {
+    check_restructures(random_spheres(rand, n), rays);
+    check_restructures(random_quads(rand, n), rays);
+  }
+}
+
+TEST_CASE("restructuring treelets lowers SAH cost of a poor bvh") {
+  random_t rand{149};
+  auto const rays = random_rays(rand, 2000);
+  auto const spheres = random_spheres(rand, 2000);
+  bvh_t bvh(spheres, median_split{});
+  auto const report = bvh.restructure_treelets();
+  CHECK(report.sah_cost_after < report.sah_cost_before);
+  CHECK(count_mismatches(bvh, spheres, rays) == 0);
+}
+
+TEST_CASE("restructuring treelets keeps a deep bvh within bvh_max_depth") {
+  random_t rand{151};
+  auto const rays = random_rays(rand, 2000);
+  // Spheres at exponentially growing distances give bvhs far deeper than
+  // balanced ones.
+  std::vector<sphere_object> spheres;
+  for (int i = 0; i < 200; ++i) {
+    auto const x = std::exp2(i * 0.25);
+    spheres.push_back(
+        sphere_object{sphere{0.1 * x, point3{x, 0, 0}}, color_t{1, 1, 1}});
+  }
+  check_restructures(spheres, rays);
+}
@@ -0,0 +1,125 @@
+#include "angle.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/instance.hpp"
+#include "scene_objects/two_level_bvh.hpp"
+#include "test_utils.hpp"
+#include "transform.hpp"
+#include <cmath>
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+using bottom_type = bvh_t<sphere_object>;
+using instance_type = instance_t<bottom_type>;
+using two_level_type = two_level_bvh_t<bottom_type>;
+
+// Instances are spread over [-20, 20]^3, rays start around it and half of
+// them aim inside it.
+std::vector<ray_t> scene_rays(random_t &rand, int n) {
+  auto res = random_rays(rand, n / 2, 30);
+  for (auto const &r : random_rays(rand, n - n / 2, 20)) {
+    auto const origin =
+        point3{rand(-30.0, 30.0), rand(-30.0, 30.0), rand(-30.0, 30.0)};
+    res.push_back(ray_t{origin, r.origin - origin});
+  }
+  return res;
+}
+
+transform_t random_transform(random_t &rand) {
+  auto const axis =
+      ray_t{point3{rand(-5.0, 5.0), rand(-5.0, 5.0), rand(-5.0, 5.0)},
+            vec3{rand(-1.0, 1.0), rand(-1.0, 1.0), rand(-1.0, 1.0)}};
+  return translation(
+             vec3{rand(-20.0, 20.0), rand(-20.0, 20.0), rand(-20.0, 20.0)}) *
+         rotation(axis, degrees(rand(-180.0, 180.0))) *
+         scaling(vec3{rand(0.5, 2.0), rand(0.5, 2.0), rand(0.5, 2.0)});
+}
+
+// Instances of two shared bottom level bvhs.
+std::vector<instance_type> random_instances(random_t &rand, int n) {
+  auto const a = std::make_shared<bottom_type const>(
+      random_spheres(rand, 50, 3), sah_split{});
+  auto const b = std::make_shared<bottom_type const>(
+      random_spheres(rand, 5, 2), sah_split{});
+  std::vector<instance_type> res;
+  for (int i = 0; i < n; ++i) {
+    res.emplace_back(i % 2 == 0 ? a : b, random_transform(rand));
+  }
+  return res;
+}
+} // namespace
+
+TEST_CASE("two_level_bvh hits same as brute force over instances") {
+  random_t rand{103};
+  auto const rays = scene_rays(rand, 2000);
+  for (int n : {0, 1, 2, 17, 200}) {
+    auto const instances = random_instances(rand, n);
+    two_level_type const bvh(instances);
+    CHECK(bvh.instances().size() == instances.size());
+    CHECK(count_mismatches(bvh, instances, rays) == 0);
+    CHECK(count_mismatches(two_level_type(instances, median_split{}),
+                           instances, rays) == 0);
+  }
+}
+
+TEST_CASE("translated instances hit same as translated objects") {
+  random_t rand{107};
+  auto const rays = scene_rays(rand, 2000);
+  auto const spheres = random_spheres(rand, 30, 3);
+  auto const bottom = std::make_shared<bottom_type const>(spheres);
+  std::vector<instance_type> instances;
+  std::vector<sphere_object> moved;
+  for (int i = 0; i < 20; ++i) {
+    auto const offset =
+        vec3{rand(-20.0, 20.0), rand(-20.0, 20.0), rand(-20.0, 20.0)};
+    instances.emplace_back(bottom, translation(offset));
+    for (auto obj : spheres) {
+      obj.shape.center = obj.shape.center + offset;
+      moved.push_back(obj);
+    }
+  }
+  two_level_type const bvh(std::move(instances));
+  for (auto const &r : rays) {
+    auto const hit_rec = hit(bvh, r, hit_interval);
+    auto const expected = brute_force_hit(moved, r, hit_interval);
+    REQUIRE(hit_rec.has_value() == expected.has_value());
+    if (hit_rec)
+      CHECK(std::abs(hit_rec->hit_distance - *expected) < 1e-9);
+  }
+}
+
+TEST_CASE("two_level_bvh hits same after being moved") {
+  random_t rand{109};
+  auto const rays = scene_rays(rand, 2000);
+  auto const instances = random_instances(rand, 100);
+  // Top level refers to instances, which must move along. Sources are
+  // destroyed, so that references left to them would be caught.
+  auto bvh = std::make_unique<two_level_type>(instances);
+  auto moved = std::make_unique<two_level_type>(std::move(*bvh));
+  bvh.reset();
+  CHECK(count_mismatches(*moved, instances, rays) == 0);
+  two_level_type assigned(random_instances(rand, 3));
+  assigned = std::move(*moved);
+  moved.reset();
+  CHECK(count_mismatches(assigned, instances, rays) == 0);
+}
+
+TEST_CASE("two_level_bvh hits new transforms after rebuild_top_level") {
+  random_t rand{113};
+  auto const rays = scene_rays(rand, 2000);
+  two_level_type bvh(random_instances(rand, 100));
+  for (std::size_t i = 0; i < bvh.instances().size(); i += 2) {
+    bvh.set_transform(i, random_transform(rand));
+  }
+  bvh.rebuild_top_level();
+  CHECK(count_mismatches(bvh, bvh.instances(), rays) == 0);
+  bvh.rebuild_top_level(median_split{});
+  CHECK(count_mismatches(bvh, bvh.instances(), rays) == 0);
+}
@@ -0,0 +1,159 @@
+#include "ray_packet.hpp"
+#include "scene_objects/any_scene_object.hpp"
+#include "scene_objects/bvh.hpp"
+#include "scene_objects/bvh/sbvh.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/translate_object.hpp"
+#include "scene_objects/variant_scene_object.hpp"
+#include "test_utils.hpp"
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <limits>
+#include <variant>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+using moved_sphere = translate_object<sphere_object>;
+// Alternatives deferring their hit objects and one that does not.
+using mixed_object =
+    variant_scene_object<sphere_object, quad_object, moved_sphere>;
+using shape_variant = variant_scene_object<sphere_object, quad_object>;
+
+// Quads and spheres, and moved spheres if Variant holds them.
+template <typename Variant>
+std::vector<Variant> random_variants(random_t &rand, int n) {
+  auto const spheres = random_spheres(rand, n);
+  auto const quads = random_quads(rand, n);
+  std::vector<Variant> res;
+  for (std::size_t i = 0; i < spheres.size(); ++i) {
+    if (i % 3 == 0) {
+      res.emplace_back(quads[i]);
+    } else if constexpr (std::same_as<Variant, mixed_object>) {
+      if (i % 3 == 1) {
+        res.emplace_back(moved_sphere{spheres[i], vec3{0, 0, 1}});
+      } else {
+        res.emplace_back(spheres[i]);
+      }
+    } else {
+      res.emplace_back(spheres[i]);
+    }
+  }
+  return res;
+}
+
+// Checks hit of every alternative is hit of variant, with normal of hit
+// object of that alternative.
+template <typename Variant>
+void check_variant_hits(std::vector<Variant> const &objects,
+                        std::vector<ray_t> const &rays) {
+  int mismatches = 0;
+  for (auto const &obj : objects) {
+    for (auto const &r : rays) {
+      auto const hit_rec = hit(obj, r, hit_interval);
+      auto const same = std::visit(
+          [&](auto const &alt) {
+            auto const expected = hit(alt, r, hit_interval);
+            if (hit_rec.has_value() != expected.has_value() ||
+                is_occluded(obj, r, hit_interval) != expected.has_value())
+              return false;
+            if (!hit_rec)
+              return true;
+            auto const p = r.at(hit_rec->hit_distance);
+            return hit_rec->hit_distance == expected->hit_distance &&
+                   hit_rec->hit_object.hit_object.index() ==
+                       obj.object.index() &&
+                   normal_at(hit_rec->hit_object, p).val() ==
+                       normal_at(expected->hit_object, p).val();
+          },
+          obj.object);
+      if (!same)
+        ++mismatches;
+    }
+  }
+  CHECK(mismatches == 0);
+}
+
+// Checks hit_lanes of 8 lanes does for every active lane what hit does.
+template <typename Variant>
+void check_variant_packets(random_t &rand, std::vector<Variant> const &objects,
+                           std::vector<ray_t> const &rays) {
+  constexpr static std::size_t N = 8;
+  int mismatches = 0;
+  for (auto const &obj : objects) {
+    for (std::size_t first = 0; first + N <= rays.size(); first += N) {
+      ray_packet_t<N> packet{};
+      packet_mask_t active = 0;
+      packet_hits_t<hit_object_t<Variant>, N> hits;
+      for (std::size_t lane = 0; lane < N; ++lane) {
+        set_lane(packet, lane, rays[first + lane]);
+        if (rand(0.0, 1.0) < 0.7)
+          active |= packet_mask_t{1} << lane;
+        hits.closest[lane] = std::numeric_limits<double>::infinity();
+      }
+      auto const res = hit_lanes(obj, packet, hit_interval.min, hits, active);
+      for (std::size_t lane = 0; lane < N; ++lane) {
+        auto const expected =
+            (active >> lane & 1) != 0
+                ? hit(obj, lane_ray(packet, lane), hit_interval)
+                : std::nullopt;
+        if (((res >> lane & 1) != 0) != expected.has_value() ||
+            hits.hits[lane].has_value() != expected.has_value() ||
+            (expected && (std::abs(hits.hits[lane]->hit_distance -
+                                   expected->hit_distance) > 1e-9 ||
+                          hits.closest[lane] != hits.hits[lane]->hit_distance)))
+          ++mismatches;
+      }
+    }
+  }
+  CHECK(mismatches == 0);
+}
+} // namespace
+
+TEST_CASE("variant_scene_object hits same as its alternative") {
+  random_t rand{199};
+  auto const rays = random_rays(rand, 200);
+  check_variant_hits(random_variants<mixed_object>(rand, 100), rays);
+  check_variant_hits(random_variants<shape_variant>(rand, 100), rays);
+  check_variant_packets(rand, random_variants<mixed_object>(rand, 100), rays);
+}
+
+TEST_CASE("bvh of mixed variant_scene_objects hits same as brute force") {
+  random_t rand{211};
+  auto const rays = random_rays(rand, 2000);
+  for (int n : {0, 1, 2, 17, 1000}) {
+    auto const mixed = random_variants<mixed_object>(rand, n);
+    CHECK(count_mismatches(bvh_t(mixed, sah_split{}), mixed, rays) == 0);
+    CHECK(count_mismatches(bvh_t(mixed, median_split{}), mixed, rays) == 0);
+    CHECK(count_mismatches(build_sbvh(mixed), mixed, rays) == 0);
+
+    auto const shapes = random_variants<shape_variant>(rand, n);
+    CHECK(count_mismatches(bvh_t(shapes, sah_split{}), shapes, rays) == 0);
+    CHECK(count_mismatches(build_sbvh(shapes), shapes, rays) == 0);
+  }
+}
+
+TEST_CASE("bvh of variant_scene_objects hits same as bvh of any_objects") {
+  random_t rand{223};
+  auto const rays = random_rays(rand, 2000);
+  auto const mixed = random_variants<mixed_object>(rand, 1000);
+  std::vector<any_scene_object<random_t>> erased;
+  for (auto const &obj : mixed) {
+    std::visit([&](auto const &alt) { erased.emplace_back(alt); }, obj.object);
+  }
+  bvh_t const variant_bvh(mixed, sah_split{});
+  bvh_t const any_bvh(erased, sah_split{});
+  int mismatches = 0;
+  for (auto const &r : rays) {
+    auto const hit_rec = hit(variant_bvh, r, hit_interval);
+    auto const expected = hit(any_bvh, r, hit_interval);
+    if (hit_rec.has_value() != expected.has_value() ||
+        (hit_rec && hit_rec->hit_distance != expected->hit_distance))
+      ++mismatches;
+  }
+  CHECK(mismatches == 0);
+}
@@ -0,0 +1,112 @@
+#include "bound.hpp"
+#include "scene_objects/bvh/split.hpp"
+#include "scene_objects/wide_bvh.hpp"
+#include "test_utils.hpp"
+#include <cstddef>
+#include <doctest/doctest.h>
+#include <vector>
+
+using namespace mrl;
+using namespace mrl::test;
+
+namespace {
+bool contains(bound_t const &outer, bound_t const &inner) {
+  auto inside = [](interval_t const &a, interval_t const &b) {
+    return a.min <= b.min && b.max <= a.max;
+  };
+  return inside(outer.x_range, inner.x_range) &&
+         inside(outer.y_range, inner.y_range) &&
+         inside(outer.z_range, inner.z_range);
+}
+
+template <std::size_t Width>
+bound_t child_bounds(wide_bvh_node_t<Width> const &node, std::size_t i) {
+  return bound_from_diagonal_points(
+      {node.min_x[i], node.min_y[i], node.min_z[i]},
+      {node.max_x[i], node.max_y[i], node.max_z[i]});
+}
+
+// Postcondition:
+//   - returns if every node of bvh is reached once from root, has 2 to Width
+//     children (root of a single leaf may have 1), bounds of every child
+//     contain everything below it, and leaves hold every object once
+template <typename Object, std::size_t Width>
+bool well_formed(wide_bvh_t<Object, Width> const &bvh) {
+  auto const &nodes = bvh.nodes();
+  auto const &objects = bvh.objects();
+  if (nodes.empty())
+    return objects.empty();
+  std::vector<int> node_visits(nodes.size());
+  std::vector<int> object_visits(objects.size());
+  // Checks subtree of node at index is inside bounds.
+  auto check = [&](auto &self, std::size_t index,
+                   bound_t const &bounds) -> bool {
+    if (index >= nodes.size() || node_visits[index]++ > 0)
+      return false;
+    auto const &node = nodes[index];
+    if (node.num_children > Width ||
+        (node.num_children < 2 && !(index == 0 && node.num_children == 1)))
+      return false;
+    for (std::size_t i = 0; i < node.num_children; ++i) {
+      auto const child = child_bounds(node, i);
+      if (!contains(bounds, child))
+        return false;
+      if (node.count[i] == 0) {
+        if (!self(self, node.child[i], child))
+          return false;
+        continue;
+      }
+      for (auto j = node.child[i]; j < node.child[i] + node.count[i]; ++j) {
+        if (j >= objects.size() || object_visits[j]++ > 0 ||
+            !contains(child, get_bounds(objects[j])))
+          return false;
+      }
+    }
+    return true;
+  };
+  if (!check(check, 0, bvh.bounds()))
+    return false;
+  for (auto visits : node_visits) {
+    if (visits != 1)
+      return false;
+  }
+  for (auto visits : object_visits) {
+    if (visits != 1)
+      return false;
+  }
+  return true;
+}
+
+template <std::size_t Width, typename Object, typename Split>
+void check_wide_bvh(std::vector<Object> const &objects,
+                    std::vector<ray_t> const &rays, Split split) {
+  wide_bvh_t<Object, Width> const bvh(objects, split);
+  CHECK(bvh.objects().size() == objects.size());
+  CHECK(well_formed(bvh));
+  CHECK(count_mismatches(bvh, objects, rays) == 0);
+}
+
+template <typename Object>
+void check_wide_bvhs(std::vector<Object> const &objects,
+                     std::vector<ray_t> const &rays) {
+  check_wide_bvh<4>(objects, rays, median_split{});
+  check_wide_bvh<4>(objects, rays, sah_split{});
+  check_wide_bvh<8>(objects, rays, median_split{});
+  check_wide_bvh<8>(objects, rays, sah_split{});
+}
+} // namespace
+
+TEST_CASE("bvh4 and bvh8 hit same as brute force") {
+  random_t rand{97};
+  auto const rays = random_rays(rand, 2000);
+  for (int n : {0, 1, 2, 3, 5, 9, 17, 100, 1000}) {
+    check_wide_bvhs(random_spheres(rand, n), rays);
+    check_wide_bvhs(random_quads(rand, n), rays);
+  }
+}
+
+TEST_CASE("bvh4 and bvh8 of equal objects hit same as brute force") {
+  random_t rand{101};
+  auto const rays = random_rays(rand, 2000);
+  check_wide_bvhs(std::vector(50, random_sphere(rand, 2)), rays);
+}